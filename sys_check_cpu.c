@@ -22,18 +22,409 @@ int sys_check_cpu_process (char *name, float *usage)
 #include <ctype.h>
 #include <errno.h>
 #include <sys/time.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+#include <linux/genetlink.h>
+#include <linux/taskstats.h>
+#include <linux/io_uring.h>
 
 #include "sys_check_cpu.h"
 
-int g_num_cpus = 0; /* save how many cpu exist at this system */
-proc_load_t g_cur_cpuload; // read /proc/loadavg and store cpu's loadaverage @g_cur_cpuload
-jiffy_counts_t *g_cpu_jif; // read /proc/stat and store cpu's jiffies
-jiffy_counts_t g_cur_jif;// read /proc/stat and store cpu's jiffies
-jiffy_counts_t g_prev_jif;// read /proc/stat and store cpu's jiffies
-cpu_usage_t g_cur_cpu_usage;// caculate cpu's usage accord cpu's jiffies and store here
-char g_line_buf[MAX_BUF_SIZE];//store some read out data here
-unsigned long long g_prev_pid_cpu_stat[PID_STAT_MAX];//read /proc/pid/stat and store here
-unsigned long long g_cur_pid_cpu_stat[PID_STAT_MAX];//read /proc/pid/stat and store here
+/* an io_uring set up with raw syscalls, the rings are mmap()ed from its fd */
+typedef struct proc_ring_t
+{
+	int fd; /* -1 when the batch reader uses pread */
+	unsigned entries; /* submission queue size */
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sq_map;
+	size_t sq_map_size;
+	void *cq_map; /* NULL when the kernel maps both rings at once */
+	size_t cq_map_size;
+	unsigned queued; /* sqes written since the last io_uring_enter */
+	int fixed_buf; /* 1 when the batch buffers are registered, reads use READ_FIXED */
+} proc_ring_t;
+
+/* a /proc/<pid> file kept open by a batch reader */
+typedef struct proc_batch_open_t
+{
+	pid_t pid;
+	int slot; /* file slot: io_uring registered file index or fd[] index */
+} proc_batch_open_t;
+
+/* reads one file of many /proc/<pid> per sweep, see proc_batch_read; the caller serializes it */
+typedef struct proc_batch_t
+{
+	const char *file; /* "stat", "status" ... under every <pid> */
+	int keep; /* 1 keeps files open between sweeps and re-reads them at offset 0 */
+	int buf_size; /* bytes of each request's buffer */
+	int size; /* requests the buffers hold, PROC_BATCH_WINDOW at most */
+	char *buf; /* size * buf_size, one fixed buffer of the ring */
+	int *len; /* bytes read by each request of the round, <0 on error */
+	int *slot; /* file slot of each request, -1 for a one-round file in pread mode */
+	unsigned char *opening; /* 1 if the request opens its file */
+	char (*name)[32]; /* "<pid>/<file>" of requests that open their file */
+	proc_batch_open_t *open; /* files kept open by the previous sweep, sorted by pid */
+	proc_batch_open_t *next; /* files kept open by this sweep */
+	int open_num;
+	int next_num;
+	int *fd; /* descriptor of each keep slot in pread mode, -1 for none */
+	int fd_held; /* keep slots in use in pread mode, taken from g_batch_fd_used */
+	int *free_slot; /* keep slots holding no file of this sweep */
+	int free_num;
+	int slot_keep; /* keep slots, io_uring temporary slots come after them */
+	int temp_used; /* temporary slots taken since the last io_uring_enter */
+	int dir_fd; /* procfs root, openat() base; -1 until the first sweep */
+	unsigned gen; /* g_proc_gen the descriptors belong to */
+	int uring; /* g_proc_uring when the descriptors were set up */
+	int uring_broken; /* io_uring failed once, pread is used for good */
+	int ring_bad; /* the kernel refused a direct open during this round */
+	proc_ring_t ring;
+} proc_batch_t;
+
+/* what a batch reader's io_uring completion belongs to, low 2 bits of user_data */
+enum
+{
+	BATCH_OPEN = 0,
+	BATCH_READ,
+	BATCH_CLOSE
+};
+
+typedef int (*proc_batch_fn)(void *arg, int i, const char *buf, int len);
+
+/* a /proc sweep shared by the scan workers, see proc_scan */
+typedef struct scan_job_t
+{
+	int kind; /* SCAN_INDEX or SCAN_TOP */
+	const pid_t *ids;
+	int num;
+	proc_batch_fn fn; /* runs on every worker at once, it only writes the entry of its index */
+	void *arg;
+	int ret; /* error of any worker */
+} scan_job_t;
+
+/* one thread of the parallel /proc scan, worker 0 is the scan's caller */
+typedef struct scan_worker_t
+{
+	pthread_t tid;
+	unsigned gen; /* last job taken */
+	unsigned long long range; /* chunks left of its share, first in the low 32 bits and end in the high 32;
+	                           * the owner takes from the front and thieves from the back, both by CAS */
+	int steals; /* chunks taken from other shares during the job */
+	int base; /* index in the job's ids[] of the chunk being read */
+	scan_job_t *job;
+	proc_batch_t batch[SCAN_KIND_MAX]; /* the worker's own readers and buffers */
+} scan_worker_t;
+
+/* one process of a whole-system snapshot */
+typedef struct snap_entry_t
+{
+	pid_t pid;
+	int cpu; /* TASK_CPU, cpu it last ran on */
+	unsigned long long start_time; /* START_TIME, tells a reused pid apart */
+	unsigned long long jif; /* UTIME + STIME */
+	char name[16];
+} snap_entry_t;
+
+/* one walk of /proc, entries are looked up by pid through an open addressing hash */
+typedef struct snap_buf_t
+{
+	snap_entry_t *entry;
+	int num; /* used entries */
+	int *slot; /* entry index + 1, 0 is an empty slot */
+	unsigned long long ns; /* proc_clock() half way through the walk's reads, 0 before the first */
+} snap_buf_t;
+
+/* process table snapshots of a context, the 2 buffers are swapped and reused */
+typedef struct snap_t
+{
+	snap_buf_t buf[2];
+	int cur; /* buf[cur] is the latest walk */
+	int size; /* allocated entries of each buffer, at most SNAP_MAX_TASKS */
+	unsigned slot_mask; /* hash slots - 1, slots are 2 * size rounded up to a power of 2 */
+	pid_t *ids; /* pids listed by the last walk */
+	int ids_size; /* allocated entries of ids */
+	snap_entry_t *scan; /* stat of ids[i] parsed by the scan, pid 0 if it was gone */
+	int scan_size; /* allocated entries of scan */
+	proc_batch_t batch; /* reads every <pid>/stat of a serial walk, files stay open */
+} snap_t;
+
+/* threads of the process a context watches, sorted by tid */
+typedef struct thread_cache_t
+{
+	pid_t pid; /* process the cache belongs to, 0 for none */
+	int num; /* used entries */
+	int size; /* allocated entries */
+	unsigned long long ns; /* proc_clock() half way through the previous call's reads */
+	snap_entry_t *entry; /* pid member holds the tid */
+	pid_t *ids; /* tids listed by the last rescan */
+	int ids_size; /* allocated entries of ids */
+} thread_cache_t;
+
+/* how a process's cpu time is read, taken from the context at the start of a measure */
+enum
+{
+	PID_TIME_JIFFY = 0, /* UTIME + STIME of /proc/pid/stat in USER_HZ ticks against CLOCK_MONOTONIC */
+	PID_TIME_SCHEDSTAT, /* /proc/pid/schedstat ns against CLOCK_MONOTONIC */
+	PID_TIME_TASKSTATS /* taskstats cpu_run_real_total ns against CLOCK_MONOTONIC, needs delay accounting */
+};
+
+/* a set of cpu ids, laid out like the kernel's cpumask so sched_getaffinity fills it */
+typedef struct cpu_mask_t
+{
+	unsigned long bits[CPU_TOPO_MAX / (8 * sizeof(unsigned long))];
+} cpu_mask_t;
+
+/* state bits of a core in ctx->cpu_online */
+enum
+{
+	CPU_ONLINE = 1, /* it had a line in the latest /proc/stat read */
+	CPU_SEEN = 2, /* it had a line in some read, its baseline is valid */
+	CPU_WAS_ONLINE = 4 /* it had a line in the read before, only set during a read */
+};
+
+/* all state of one caller, the legacy API works on g_default_ctx */
+struct cpu_ctx_t
+{
+	pthread_mutex_t lock; /* guards every field below, only contended if the context is shared */
+	int stat_fd; /* /proc/stat stays open and is re-read with pread() */
+	int loadavg_fd; /* /proc/loadavg stays open and is re-read with pread() */
+	int psi_fd[PSI_RESOURCE_MAX]; /* <procfs root>/pressure/<resource>, opened by the first sys_check_cpu_ctx_psi */
+	int ts_sock; /* genetlink socket of the taskstats backend */
+	int online_fd; /* CPU_ONLINE_PATH stays open and is re-read with pread() */
+	int cpuset_fd; /* cpuset file of the process's cgroup, found by the first topology check, -2 for none */
+	int num_cpus; /* highest cpu id of /proc/stat + 1, size of the per-core vectors */
+	int precise; /* 1: process usage from schedstat ns and CLOCK_MONOTONIC instead of jiffies */
+	int backend; /* PROC_BACKEND_PROCFS or PROC_BACKEND_TASKSTATS */
+	int ts_family; /* genetlink family id of TASKSTATS */
+	proc_load_t cur_cpuload; /* read /proc/loadavg and store cpu's loadaverage here */
+	jiffy_counts_t cur_jif; /* read /proc/stat and store cpu's jiffies */
+	jiffy_counts_t prev_jif; /* jiffies of the sample before cur_jif */
+	cpu_usage_t cur_cpu_usage; /* caculate cpu's usage accord cpu's jiffies and store here */
+	jiffy_counts_t *cpu_jif; /* per-core jiffies of the last /proc/stat read */
+	jiffy_counts_t *prev_cpu_jif; /* per-core jiffies of the read before */
+	unsigned char *cpu_online; /* CPU_ONLINE | CPU_SEEN of every core id */
+	cpu_topo_t topo; /* cpu sets of the last topology check */
+	cpu_mask_t topo_avail; /* cpus counted in topo.available */
+	unsigned long long topo_ns; /* CLOCK_MONOTONIC of the last topology check, 0 before the first */
+	int topo_stale; /* the cores of /proc/stat changed, check again at once */
+	unsigned topo_src; /* g_proc_gen of the last topology check, a source change checks again at once */
+	snap_t *snap; /* process table snapshots, allocated by the first sys_check_cpu_ctx_top */
+	thread_cache_t threads; /* threads seen by the last sys_check_cpu_ctx_threads */
+	pid_t *sched_tids; /* tids listed by the last parse_schedstat */
+	int sched_tids_size; /* allocated entries of sched_tids */
+	char stat_buf[PROC_STAT_BUF_SIZE]; /* whole /proc/stat is read here */
+};
+
+static const char *g_psi_path[PSI_RESOURCE_MAX] = {
+	"pressure/cpu", "pressure/io", "pressure/memory"
+};
+
+/* where procfs is read from, changed only while no sampler and no proc connector run */
+static char g_proc_root[PROC_ROOT_SIZE] = PROC_ROOT; /* procfs mount point */
+static const proc_backend_t *g_proc_backend = NULL; /* NULL reads the files under g_proc_root */
+static int g_proc_host = 1; /* 1 while procfs is the kernel's own /proc, taskstats and proc connector pids match it then */
+static unsigned g_proc_gen = 0; /* bumped on every source change, batch readers drop their descriptors then */
+static unsigned long long g_psi_probe = 0; /* g_proc_gen << 2 | 2 once <root>/pressure was looked for, | 1 if present */
+static int g_proc_uring = 0; /* 1 reads batch sweeps through io_uring, see sys_check_cpu_set_uring */
+static int g_batch_fd_used = 0; /* descriptors kept open by all batch readers in pread mode */
+
+/* parallel /proc scan pool, g_scan_lock guards the job hand-off */
+static pthread_mutex_t g_scan_run = PTHREAD_MUTEX_INITIALIZER; /* held by a pooled scan and while the pool changes */
+static pthread_mutex_t g_scan_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_scan_cond = PTHREAD_COND_INITIALIZER; /* workers wait for a job */
+static pthread_cond_t g_scan_done = PTHREAD_COND_INITIALIZER; /* the caller waits for the workers */
+static scan_worker_t *g_scan_worker; /* g_scan_workers entries, NULL while scans are serial */
+static int g_scan_workers = 1; /* threads of a scan, the caller included */
+static scan_job_t *g_scan_job; /* job being scanned */
+static unsigned g_scan_gen = 0; /* bumped per job, workers wake on it */
+static int g_scan_active = 0; /* pool threads not done with the job */
+static int g_scan_quit = 0; /* ask the pool threads to quit */
+static scan_stat_t g_scan_stat[SCAN_KIND_MAX]; /* last sweep of each kind */
+
+/* descriptors start closed as in sys_check_cpu_ctx_create, every other field is 0 */
+static cpu_ctx_t g_default_ctx =
+{
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.stat_fd = -1,
+	.loadavg_fd = -1,
+	.psi_fd = { -1, -1, -1 },
+	.ts_sock = -1,
+	.online_fd = -1,
+	.cpuset_fd = -1
+};
+
+/* one watched cgroup, cpu.stat and cpu.max stay open and are re-read with pread() */
+struct cgroup_mon_t
+{
+	pthread_mutex_t lock; /* guards every field below */
+	int stat_fd; /* cpu.stat */
+	int max_fd; /* cpu.max, -1 in the root cgroup which has none */
+	cgroup_stat_t prev; /* read of the previous sys_check_cpu_cgroup_usage, or of open */
+	unsigned long long prev_ns; /* CLOCK_MONOTONIC of prev */
+	char dir[CGROUP_PATH_SIZE];
+};
+
+/* one file of a recorded snapshot, name and data point into the mapped trace */
+typedef struct replay_file_t
+{
+	const char *name; /* not '\0' terminated */
+	int name_len;
+	const char *data;
+	int len;
+} replay_file_t;
+
+/* one recorded snapshot, its files are sorted by name */
+typedef struct replay_snap_t
+{
+	unsigned long long ns; /* CLOCK_MONOTONIC of the recording */
+	int first; /* first file in proc_replay_t file */
+	int num; /* files of the snapshot */
+} replay_snap_t;
+
+/* a recorded trace mapped read-only, the backend serves snap[cur] */
+struct proc_replay_t
+{
+	char *map;
+	size_t map_size;
+	replay_file_t *file;
+	int file_num;
+	replay_snap_t *snap;
+	int snap_num;
+	int cur; /* snapshot served now, stepped with atomics while readers run */
+	proc_backend_t backend;
+};
+
+/* background sampler state, it samples g_default_ctx */
+static pthread_mutex_t g_sampler_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_sampler_cond;
+static pthread_t g_sampler_tid;
+static int g_sampler_running = 0; /* 1 while the sampler thread is alive */
+static int g_sampler_stop = 0; /* ask the sampler thread to quit */
+static int g_sampler_period = SAMPLER_DEFAULT_PERIOD; /* time between 2 samples (unit: microsecond) */
+
+/* sample history written by the sampler thread only, readers never lock:
+ * a slot is valid when its seq is even and unchanged across the copy */
+typedef struct history_slot_t
+{
+	unsigned seq; /* odd while the sampler rewrites the slot */
+	cpu_sample_t sample;
+} history_slot_t;
+
+static history_slot_t *g_history; /* preallocated by sys_check_cpu_history_enable */
+static unsigned g_history_mask = 0; /* slots - 1, slots is a power of 2 */
+static unsigned long long g_history_head = 0; /* samples ever written, next slot is head & mask */
+
+/* threshold rules, evaluated by the sampler thread on every sample; guarded by g_alert_lock */
+typedef struct alert_slot_t
+{
+	alert_rule_t rule; /* rule.name holds the base name */
+	alert_cb_t cb; /* NULL queues the events for sys_check_cpu_alert_read */
+	void *arg;
+	int used; /* 0 for a free slot */
+	int fired; /* 1 while the rule is in its fired state */
+	unsigned long long since; /* when the pending edge's condition started to hold, 0 for none (unit:nanosecond) */
+} alert_slot_t;
+
+/* cpu time of a process at the previous tick, sorted by pid */
+typedef struct alert_pid_t
+{
+	pid_t pid;
+	int name_idx;
+	unsigned long long time; /* jiffies or nanoseconds, see pid_time_mode */
+} alert_pid_t;
+
+/* an event with its callback, handed out after g_alert_lock is dropped */
+typedef struct alert_fire_t
+{
+	alert_cb_t cb;
+	void *arg;
+	alert_event_t event;
+} alert_fire_t;
+
+static pthread_mutex_t g_alert_lock = PTHREAD_MUTEX_INITIALIZER;
+static alert_slot_t *g_alert; /* rule slots, the id of a rule is its slot index */
+static int g_alert_size = 0; /* allocated slots of g_alert */
+static int g_alert_num = 0; /* used slots, read by the sampler without the lock */
+static int g_alert_stale = 0; /* the last rule was removed, process baselines must be taken again */
+/* only the sampler thread touches the process state and buffers below, without g_alert_lock */
+static alert_pid_t *g_alert_pid; /* processes of the previous tick */
+static alert_pid_t *g_alert_pid_cur; /* processes of this tick, swapped with g_alert_pid */
+static int g_alert_pid_num = 0; /* used entries of g_alert_pid */
+static int g_alert_primed = 0; /* g_alert_pid and g_alert_clock hold a previous tick */
+static int g_alert_mode = -1; /* pid_time_mode of the previous tick */
+static unsigned long long g_alert_clock = 0; /* proc_clock() stamp of the previous tick's reads */
+static alert_fire_t *g_alert_fire; /* callback events of one tick */
+static const char **g_alert_names; /* distinct process names of one tick, they point into g_alert_name_buf */
+static char *g_alert_name_buf; /* copies of the names, sizeof(rule.name) each */
+static float *g_alert_usage; /* usage of each of g_alert_names */
+static int g_alert_buf_size = 0; /* allocated entries of the buffers above */
+static alert_event_t g_alert_queue[ALERT_QUEUE_SIZE]; /* events of rules without callback */
+static unsigned long long g_alert_qhead = 0; /* events ever queued */
+static unsigned long long g_alert_qtail = 0; /* events ever taken or dropped */
+static int g_alert_efd = -1; /* eventfd created by sys_check_cpu_alert_fd */
+
+/* name->pid index, sorted by pid, refreshed incrementally from /proc; guarded by g_pid_index_lock.
+ * It is a cache of /proc, so all contexts share it. */
+typedef struct pid_index_entry_t
+{
+	pid_t pid;
+	int pid_alive; /* 0 once a /proc read of this pid failed */
+	int verified; /* stat was read on 2 refreshes, so it is past fork()/exec() */
+	unsigned long long start_time; /* START_TIME, a reused pid has another one; 0 if the name came from an event */
+	int next; /* next entry in the same name hash bucket, -1 ends the chain */
+	char name[64];
+} pid_index_entry_t;
+
+static pthread_mutex_t g_pid_index_lock = PTHREAD_MUTEX_INITIALIZER;
+static pid_index_entry_t *g_pid_index; /* current index */
+static int g_pid_index_num = 0; /* used entries of g_pid_index */
+static int g_pid_index_size = 0; /* allocated entries of g_pid_index */
+static pid_index_entry_t *g_pid_spare; /* the other buffer, refresh merges into it then swaps */
+static int g_pid_spare_size = 0;
+static int *g_pid_bucket; /* name hash, first entry of each chain */
+static unsigned g_pid_bucket_num = 0;
+static pid_t *g_pid_scan; /* pid directories found by the last proc_list */
+static int g_pid_scan_size = 0; /* allocated entries of g_pid_scan */
+static pid_t *g_pid_need; /* pids whose name the refresh reads, sorted */
+static int *g_pid_need_idx; /* entry of the merged index each of g_pid_need fills */
+static int g_pid_need_size = 0; /* allocated entries of g_pid_need and g_pid_need_idx */
+static proc_batch_t g_pid_batch; /* reads <pid>/stat of a refresh, set up by the first one */
+static int g_procev_live = 0; /* 1 while proc connector events keep the index current, lookups skip /proc then */
+
+/* one index change decoded from a proc connector event */
+typedef struct procev_change_t
+{
+	pid_t pid;
+	int seq; /* arrival order, the last change of a pid wins */
+	int alive; /* 0 for an exit */
+	char name[16];
+} procev_change_t;
+
+/* process event engine state, guarded by g_procev_lock */
+static pthread_mutex_t g_procev_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t g_procev_tid;
+static int g_procev_running = 0; /* 1 while the event thread is alive */
+static int g_procev_sock = -1; /* NETLINK_CONNECTOR socket joined to CN_IDX_PROC */
+static int g_procev_pipe[2] = { -1, -1 }; /* stop wakes the event thread through it */
 
 FILE* FAST_FUNC xfopen_for_read(const char *path)
 {
@@ -91,518 +482,7118 @@ void* FAST_FUNC xrealloc_vector_helper(void *vector, unsigned sizeof_and_shift,
 	xrealloc_vector_helper((vector), (sizeof((vector)[0]) << 8) + (shift), (idx))
 
 /*************************************************
-Function: parse_loadavg
-Description: parse /proc/loadavg file and put data into float cpuloadavg[CPU_LOADAVG_MAX]
-Calls: 
-	FILE* FAST_FUNC xfopen_for_read(const char *path)
-Input: float cpuloadavg[CPU_LOADAVG_MAX]  used to save current cpu's loadaverage data
-Output: current cpu's loadaverage data
+Function: pread_proc_file
+Description: read a whole /proc file from offset 0 through a descriptor that
+	stays open between calls, so a sample costs one pread() and no FILE
+Input: 
+	int *fd---persistent descriptor, opened on first use (-1 means not opened yet)
+	const char *path---file to open
+	int size---size of buf
+Output: char *buf---file content, always '\0' terminated
+Return: 
+	>=0 bytes read
+	-1  function run error
 *************************************************/
-static int parse_loadavg(float cpuloadavg[CPU_LOADAVG_MAX])
+static int pread_proc_file(int *fd, const char *path, char *buf, int size)
 {
-	char buf[60];
-	FILE *f;
-	int i = 0;
+	ssize_t n = -1;
+	int retry;
 
-	memset(cpuloadavg, 0, sizeof(cpuloadavg[0]) * CPU_LOADAVG_MAX);
-	if (NULL == (f = fopen("/proc/loadavg","r")))
+	for (retry = 0; retry < 2 && n < 0; retry++)
 	{
-		printf("can't open /proc/loadavg because:%s\n", strerror(errno));
+		if (*fd < 0)
+		{
+			*fd = open(path, O_RDONLY | O_CLOEXEC);
+			if (*fd < 0)
+			{
+				printf("can't open %s because:%s\n", path, strerror(errno));
+				return -1;
+			}
+		}
+		n = pread(*fd, buf, size - 1, 0);
+		if (n < 0)
+		{
+			/* stale descriptor, open it again once */
+			close(*fd);
+			*fd = -1;
+		}
+	}
+	if (n < 0)
+		return -1;
+	buf[n] = '\0';
+	return (int)n;
+}
+
+/*************************************************
+Function: read_small_file
+Description: open, read and close a short /proc/<pid> file without stdio
+Input: 
+	const char *path---file to read
+	int size---size of buf
+Output: char *buf---file content, always '\0' terminated
+Return: 
+	>=0 bytes read
+	-1  file is gone
+*************************************************/
+static int read_small_file(const char *path, char *buf, int size)
+{
+	int fd;
+	ssize_t n;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+	n = read(fd, buf, size - 1);
+	close(fd);
+	if (n < 0)
 		return -1;
+	buf[n] = '\0';
+	return (int)n;
+}
+
+/*************************************************
+Function: proc_read
+Description: read a procfs file by its name under the procfs root, from the
+	backend when one is set
+Calls: 
+	static int pread_proc_file(int *fd, const char *path, char *buf, int size)
+	static int read_small_file(const char *path, char *buf, int size)
+Input: 
+	int *fd---persistent descriptor like pread_proc_file's, NULL for a one-shot read
+	const char *name---"stat", "123/status" ...
+	int size---size of buf
+Output: char *buf---file content, always '\0' terminated
+Return: 
+	>=0 bytes read
+	-1  file is missing or gone
+*************************************************/
+static int proc_read(int *fd, const char *name, char *buf, int size)
+{
+	char path[PROC_ROOT_SIZE + CGROUP_PATH_SIZE];
+
+	if (g_proc_backend != NULL)
+		return g_proc_backend->read(g_proc_backend->priv, name, buf, size);
+	snprintf(path, sizeof(path), "%s/%s", g_proc_root, name);
+	if (fd != NULL)
+		return pread_proc_file(fd, path, buf, size);
+	return read_small_file(path, buf, size);
+}
+
+/*************************************************
+Function: proc_ids_grow
+Description: grow a pid array of proc_list to hold want entries
+Input: 
+	pid_t **ids
+	int *size---allocated entries, updated
+	int want
+Output: 
+Return: 
+	0   function run success
+	-ENOMEM out of memory
+*************************************************/
+static int proc_ids_grow(pid_t **ids, int *size, int want)
+{
+	int n = *size ? *size : 256;
+	pid_t *grown;
+
+	while (n < want)
+		n *= 2;
+	grown = realloc(*ids, sizeof(grown[0]) * n);
+	if (grown == NULL)
+		return -ENOMEM;
+	*ids = grown;
+	*size = n;
+	return 0;
+}
+
+/*************************************************
+Function: proc_list
+Description: list the numeric entries of a procfs directory, pids of the root
+	or tids of "123/task", in no particular order
+Calls: 
+	static int proc_ids_grow(pid_t **ids, int *size, int want)
+Input: 
+	const char *dir---"" for the root
+	pid_t **ids---grown with realloc as needed, may point to NULL
+	int *size---allocated entries of *ids, updated
+Output: 
+Return: 
+	>=0 entries found
+	-ENOENT directory is missing or gone
+	-ENOMEM out of memory
+*************************************************/
+static int proc_list(const char *dir, pid_t **ids, int *size)
+{
+	char path[PROC_ROOT_SIZE + 64];
+	DIR *d;
+	struct dirent *next;
+	int num = 0;
+
+	if (g_proc_backend != NULL)
+		return g_proc_backend->list(g_proc_backend->priv, dir, ids, size);
+	snprintf(path, sizeof(path), "%s/%s", g_proc_root, dir);
+	d = opendir(path);
+	if (NULL == d)
+		return -ENOENT;
+	while ((next = readdir(d)) != NULL)
+	{
+		/* skip non-number */
+		if (!isdigit(*next->d_name))
+			continue;
+		if (num >= *size && proc_ids_grow(ids, size, num + 1) < 0)
+		{
+			closedir(d);
+			return -ENOMEM;
+		}
+		(*ids)[num++] = strtol(next->d_name, NULL, 10);
 	}
+	closedir(d);
+	return num;
+}
+
+/*************************************************
+Function: ring_free
+Description: unmap the rings of an io_uring and close it, its registered
+	files and buffers go with it
+Input: proc_ring_t *ring---may be half set up
+Output: 
+*************************************************/
+static void ring_free(proc_ring_t *ring)
+{
+	if (ring->sqes != NULL)
+		munmap(ring->sqes, ring->entries * sizeof(ring->sqes[0]));
+	if (ring->cq_map != NULL)
+		munmap(ring->cq_map, ring->cq_map_size);
+	if (ring->sq_map != NULL)
+		munmap(ring->sq_map, ring->sq_map_size);
+	if (ring->fd >= 0)
+		close(ring->fd);
+	memset(ring, 0, sizeof(*ring));
+	ring->fd = -1;
+}
+
+/*************************************************
+Function: ring_setup
+Description: set up an io_uring with raw syscalls, no liburing is needed, and
+	map its rings; the kernel must support every opcode a batch reader submits
+Calls: 
+	static void ring_free(proc_ring_t *ring)
+Input: unsigned entries---submission queue size
+Output: proc_ring_t *ring
+Return:
+	0   function run success
+	-1  io_uring is missing, disabled or too old
+*************************************************/
+static int ring_setup(proc_ring_t *ring, unsigned entries)
+{
+	static const int ops[] = { IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_READ_FIXED, IORING_OP_CLOSE };
+	struct io_uring_params p;
+	struct io_uring_probe *probe;
+	char *sq;
+	char *cq;
+	unsigned i;
+	int ok;
 
-	while (fgets(buf, sizeof(buf), f) != NULL) 
+	memset(ring, 0, sizeof(*ring));
+	memset(&p, 0, sizeof(p));
+	ring->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+	if (ring->fd < 0)
+	{
+		ring->fd = -1;
+		return -1;
+	}
+	ring->entries = p.sq_entries;
+	ring->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if ((p.features & IORING_FEAT_SINGLE_MMAP) && ring->cq_map_size > ring->sq_map_size)
+		ring->sq_map_size = ring->cq_map_size;
+	sq = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (sq == MAP_FAILED)
+	{
+		ring_free(ring);
+		return -1;
+	}
+	ring->sq_map = sq;
+	cq = sq;
+	if (!(p.features & IORING_FEAT_SINGLE_MMAP))
 	{
-		//printf("buf=%s\n",buf);//for debug
-		char *tmp = buf;
-		char *p[CPU_LOADAVG_MAX];
-		while ((p[i] = strtok(tmp, " ")) != NULL) 
+		cq = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		if (cq == MAP_FAILED)
 		{
-			//printf("p[%d]=%s\n", i, p[i]); //for debug
-			cpuloadavg[i] = atof(p[i]);
-			
-			//printf("cpuloadavg[%d]=%.2f\n", i, cpuloadavg[i]);//for debug
-			i++;
-			tmp = NULL;
-		}		
+			ring_free(ring);
+			return -1;
+		}
+		ring->cq_map = cq;
+	}
+	ring->sqes = mmap(NULL, p.sq_entries * sizeof(ring->sqes[0]), PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+	{
+		ring->sqes = NULL;
+		ring_free(ring);
+		return -1;
+	}
+	ring->sq_head = (unsigned *)(sq + p.sq_off.head);
+	ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+	ring->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+	ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+	ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+	ring->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+	/* sqe i always sits in slot i, the index array never changes */
+	for (i = 0; i < p.sq_entries; i++)
+		((unsigned *)(sq + p.sq_off.array))[i] = i;
+
+	probe = calloc(1, sizeof(*probe) + IORING_OP_LAST * sizeof(probe->ops[0]));
+	ok = probe != NULL
+		&& syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) == 0;
+	for (i = 0; ok && i < sizeof(ops) / sizeof(ops[0]); i++)
+		ok = ops[i] < probe->ops_len && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+	free(probe);
+	if (!ok)
+	{
+		ring_free(ring);
+		return -1;
 	}
-	memset(&g_cur_cpuload, 0, sizeof(g_cur_cpuload));
-	g_cur_cpuload.cpu_load_1min = cpuloadavg[CPU_LOADAVG_1MINS];
-	g_cur_cpuload.cpu_load_5min = cpuloadavg[CPU_LOADAVG_5MINS];
-	g_cur_cpuload.cpu_load_15min = cpuloadavg[CPU_LOADAVG_15MINS];
-	fclose(f);
 	return 0;
 }
 
+/* next free sqe, zeroed; the caller made sure the queue has room */
+static struct io_uring_sqe *ring_sqe(proc_ring_t *ring)
+{
+	struct io_uring_sqe *sqe = &ring->sqes[(*ring->sq_tail + ring->queued) & *ring->sq_mask];
+
+	memset(sqe, 0, sizeof(*sqe));
+	ring->queued++;
+	return sqe;
+}
+
 /*************************************************
-Function: read_cpu_jiffy
-Description: parse /proc/stat file and put data into jiffy_counts_t struct
-Input: jiffy_counts_t *p_jif used to save current cpu's jiffies data
-Output: current cpu's jiffies data
+Function: batch_fd_limit
+Description: descriptors all batch readers together may keep open between
+	sweeps, PROC_BATCH_MAX_OPEN and a quarter of RLIMIT_NOFILE at most
+Input: 
+Output: 
+Return: the limit
 *************************************************/
-static int read_cpu_jiffy(FILE *fp, jiffy_counts_t *p_jif)
+static int batch_fd_limit(void)
 {
-	static const char s_fmt[] = "cpu %llu %llu %llu %llu %llu %llu %llu %llu";
+	struct rlimit rl;
+	int n = PROC_BATCH_MAX_OPEN;
 
-	int ret;
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur / 4 < (rlim_t)n)
+		n = (int)(rl.rlim_cur / 4);
+	return n;
+}
+
+/* take one kept descriptor of the shared budget, 0 when it is used up */
+static int batch_fd_take(int limit)
+{
+	int used = __atomic_load_n(&g_batch_fd_used, __ATOMIC_RELAXED);
+
+	do
+	{
+		if (used >= limit)
+			return 0;
+	} while (!__atomic_compare_exchange_n(&g_batch_fd_used, &used, used + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	return 1;
+}
+
+/*************************************************
+Function: proc_batch_init
+Description: set up a batch reader, nothing is opened or allocated before its first sweep
+Input: 
+	const char *file---file read under every /proc/<pid>, must stay valid
+	int buf_size---room for one file's content, '\0' included
+	int keep---1 keeps the files open between sweeps
+Output: proc_batch_t *b
+*************************************************/
+static void proc_batch_init(proc_batch_t *b, const char *file, int buf_size, int keep)
+{
+	memset(b, 0, sizeof(*b));
+	b->file = file;
+	b->buf_size = buf_size;
+	b->keep = keep;
+	b->dir_fd = -1;
+	b->ring.fd = -1;
+}
+
+/*************************************************
+Function: proc_batch_reset
+Description: close every descriptor of a batch reader, the buffers stay
+Calls: 
+	static void ring_free(proc_ring_t *ring)
+Input: proc_batch_t *b
+Output: 
+*************************************************/
+static void proc_batch_reset(proc_batch_t *b)
+{
+	int i;
+
+	for (i = 0; b->fd != NULL && i < b->slot_keep; i++)
+	{
+		if (b->fd[i] >= 0)
+			close(b->fd[i]);
+	}
+	__atomic_sub_fetch(&g_batch_fd_used, b->fd_held, __ATOMIC_RELAXED);
+	b->fd_held = 0;
+	ring_free(&b->ring);
+	if (b->dir_fd >= 0)
+		close(b->dir_fd);
+	b->dir_fd = -1;
+	free(b->fd);
+	free(b->free_slot);
+	free(b->open);
+	free(b->next);
+	b->fd = NULL;
+	b->free_slot = NULL;
+	b->open = NULL;
+	b->next = NULL;
+	b->open_num = 0;
+	b->next_num = 0;
+	b->free_num = 0;
+	b->slot_keep = 0;
+	b->temp_used = 0;
+	b->ring_bad = 0;
+}
+
+/*************************************************
+Function: proc_batch_free
+Description: close and free everything of a batch reader
+Calls: 
+	static void proc_batch_reset(proc_batch_t *b)
+Input: proc_batch_t *b
+Output: 
+*************************************************/
+static void proc_batch_free(proc_batch_t *b)
+{
+	proc_batch_reset(b);
+	free(b->buf);
+	free(b->len);
+	free(b->slot);
+	free(b->opening);
+	free(b->name);
+	b->buf = NULL;
+	b->len = NULL;
+	b->slot = NULL;
+	b->opening = NULL;
+	b->name = NULL;
+	b->size = 0;
+}
+
+/* register the request buffers as the ring's fixed buffer, plain READ is used if it fails */
+static void proc_batch_register_buf(proc_batch_t *b)
+{
+	struct iovec iov;
+
+	if (b->ring.fd < 0 || b->buf == NULL)
+		return;
+	if (b->ring.fixed_buf)
+		syscall(__NR_io_uring_register, b->ring.fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+	iov.iov_base = b->buf;
+	iov.iov_len = (size_t)b->size * b->buf_size;
+	b->ring.fixed_buf = syscall(__NR_io_uring_register, b->ring.fd, IORING_REGISTER_BUFFERS, &iov, 1) == 0;
+}
+
+/*************************************************
+Function: proc_batch_start
+Description: (re)open the procfs root of a batch reader and set up its
+	io_uring with a sparse registered file table: slot_keep slots for kept
+	files, PROC_BATCH_TEMP for files read once. Without io_uring the kept
+	files are plain descriptors, each in-use slot then takes one of the
+	budget all readers share, see batch_fd_take
+Calls: 
+	static void proc_batch_reset(proc_batch_t *b)
+	static int batch_fd_limit(void)
+	static int ring_setup(proc_ring_t *ring, unsigned entries)
+Input: proc_batch_t *b
+Output: 
+Return:
+	0   function run success
+	-ENOENT  procfs root is missing
+	-ENOMEM  out of memory
+*************************************************/
+static int proc_batch_start(proc_batch_t *b)
+{
+	int *files;
+	int n = 0;
+	int i;
+
+	proc_batch_reset(b);
+	b->gen = g_proc_gen;
+	b->uring = __atomic_load_n(&g_proc_uring, __ATOMIC_RELAXED);
+	b->dir_fd = open(g_proc_root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (b->dir_fd < 0)
+		return -ENOENT;
+	if (b->keep)
+	{
+		n = batch_fd_limit();
+		b->fd = malloc(sizeof(b->fd[0]) * n);
+		b->free_slot = malloc(sizeof(b->free_slot[0]) * n);
+		b->open = malloc(sizeof(b->open[0]) * n);
+		b->next = malloc(sizeof(b->next[0]) * n);
+		if (b->fd == NULL || b->free_slot == NULL || b->open == NULL || b->next == NULL)
+		{
+			proc_batch_reset(b);
+			return -ENOMEM;
+		}
+		for (i = 0; i < n; i++)
+		{
+			b->fd[i] = -1;
+			b->free_slot[i] = n - 1 - i; /* low slots are taken first */
+		}
+	}
+	b->slot_keep = n;
+	b->free_num = n;
 
-	if (!fgets(g_line_buf, MAX_BUF_SIZE, fp) || g_line_buf[0] != 'c' /* not "cpu" */)
+	if (!b->uring || b->uring_broken || ring_setup(&b->ring, PROC_BATCH_RING) < 0)
 		return 0;
-	ret = sscanf(g_line_buf, s_fmt,
-			&p_jif->usr, &p_jif->nic, &p_jif->sys, &p_jif->idle,
-			&p_jif->iowait, &p_jif->irq, &p_jif->softirq,
-			&p_jif->steal);
-	if (ret >= 4) 
+	files = malloc(sizeof(files[0]) * (n + PROC_BATCH_TEMP));
+	if (files != NULL)
 	{
-		p_jif->total = p_jif->usr + p_jif->nic + p_jif->sys + p_jif->idle
-			+ p_jif->iowait + p_jif->irq + p_jif->softirq + p_jif->steal;
-		p_jif->busy = p_jif->total - p_jif->idle - p_jif->iowait;
+		for (i = 0; i < n + PROC_BATCH_TEMP; i++)
+			files[i] = -1;
 	}
-	
-/*printf("usr(%llu) nic(%llu) sys(%llu) idle(%llu) iowait(%llu) irq(%llu) 
-softirq(%llu) steal(%llu) total(%llu) busy(%llu)\n",
-p_jif->usr,p_jif->nic,p_jif->sys,p_jif->idle,p_jif->iowait,p_jif->irq,
-p_jif->softirq,p_jif->steal, p_jif->total, p_jif->busy);*/
-	return ret;
+	if (files == NULL
+		|| syscall(__NR_io_uring_register, b->ring.fd, IORING_REGISTER_FILES, files, n + PROC_BATCH_TEMP) < 0)
+		ring_free(&b->ring);
+	free(files);
+	proc_batch_register_buf(b);
+	return 0;
 }
 
 /*************************************************
-Function: get_jiffy_counts
-Description: get /proc/stat information and store @jiffy_counts_t
+Function: proc_batch_grow
+Description: make room for want requests per round, PROC_BATCH_WINDOW at most
 Calls: 
-	FILE* FAST_FUNC xfopen_for_read(const char *path)
-Input: jiffy_counts_t *jif used to save current /proc/stat data
-Output: current cpu's jiffies data
+	static void proc_batch_register_buf(proc_batch_t *b)
+Input: 
+	proc_batch_t *b
+	int want
+Output: 
+Return:
+	0   function run success
+	-ENOMEM  out of memory, the old buffers stay
 *************************************************/
-static int get_jiffy_counts(jiffy_counts_t *jif)
+static int proc_batch_grow(proc_batch_t *b, int want)
 {
-	FILE *fp = xfopen_for_read("/proc/stat");
-	if (fp == NULL)
-		return -1;
+	char *buf;
+	int *len;
+	int *slot;
+	unsigned char *opening;
+	char (*name)[32];
 
-	if (read_cpu_jiffy(fp, jif) < 4)
+	if (want > PROC_BATCH_WINDOW)
+		want = PROC_BATCH_WINDOW;
+	if (want <= b->size)
+		return 0;
+	/* the kernel pins the registered buffer, let it go before it moves */
+	if (b->ring.fixed_buf)
+		syscall(__NR_io_uring_register, b->ring.fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+	b->ring.fixed_buf = 0;
+	buf = realloc(b->buf, (size_t)want * b->buf_size);
+	if (buf == NULL)
 	{
-		printf("can't read '%s'", "/proc/stat");
-		fclose(fp);
-		return -1;
+		proc_batch_register_buf(b);
+		return -ENOMEM;
+	}
+	b->buf = buf;
+	len = realloc(b->len, sizeof(len[0]) * want);
+	if (len == NULL)
+		return -ENOMEM;
+	b->len = len;
+	slot = realloc(b->slot, sizeof(slot[0]) * want);
+	if (slot == NULL)
+		return -ENOMEM;
+	b->slot = slot;
+	opening = realloc(b->opening, sizeof(opening[0]) * want);
+	if (opening == NULL)
+		return -ENOMEM;
+	b->opening = opening;
+	name = realloc(b->name, sizeof(name[0]) * want);
+	if (name == NULL)
+		return -ENOMEM;
+	b->name = name;
+	b->size = want;
+	proc_batch_register_buf(b);
+	return 0;
+}
+
+/* a kept file is no longer wanted; with io_uring it stays in its slot until the next open replaces it */
+static void proc_batch_drop(proc_batch_t *b, int slot)
+{
+	if (b->ring.fd < 0)
+	{
+		if (b->fd[slot] >= 0)
+			close(b->fd[slot]);
+		b->fd[slot] = -1;
+		b->fd_held--;
+		__atomic_sub_fetch(&g_batch_fd_used, 1, __ATOMIC_RELAXED);
+	}
+	b->free_slot[b->free_num++] = slot;
+}
+
+/*************************************************
+Function: proc_batch_assign
+Description: match the pids of a round with the files kept open by the
+	previous sweep, both sorted by pid; kept files of vanished pids are
+	dropped and new pids get a free keep slot or, when none is left or
+	the shared descriptor budget of pread mode is used up, a file of
+	their own for this round
+Calls: 
+	static void proc_batch_drop(proc_batch_t *b, int slot)
+	static int batch_fd_take(int limit)
+Input: 
+	proc_batch_t *b
+	const pid_t ids[]---pids of the round, sorted
+	int n---how many pids in ids[]
+	int j---first entry of b->open not matched yet
+Output: 
+Return: the new j
+*************************************************/
+static int proc_batch_assign(proc_batch_t *b, const pid_t ids[], int n, int j)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		while (j < b->open_num && b->open[j].pid < ids[i])
+			proc_batch_drop(b, b->open[j++].slot);
+		b->len[i] = -EIO;
+		if (j < b->open_num && b->open[j].pid == ids[i])
+		{
+			b->slot[i] = b->open[j++].slot;
+			b->opening[i] = 0;
+			continue;
+		}
+		b->opening[i] = 1;
+		snprintf(b->name[i], sizeof(b->name[i]), "%u/%s", ids[i], b->file);
+		b->slot[i] = -1;
+		if (b->free_num == 0)
+			continue;
+		if (b->ring.fd < 0)
+		{
+			if (!batch_fd_take(b->slot_keep))
+				continue;
+			b->fd_held++;
+		}
+		b->slot[i] = b->free_slot[--b->free_num];
+	}
+	return j;
+}
+
+/* handle one completion, user_data is request << 2 | BATCH_* */
+static void proc_batch_complete(proc_batch_t *b, unsigned long long data, int res)
+{
+	int i = (int)(data >> 2);
+
+	switch (data & 3)
+	{
+		case BATCH_OPEN:
+			if (res == -EINVAL)
+				b->ring_bad = 1; /* kernel older than 5.15, no direct descriptors */
+			if (res < 0)
+				b->len[i] = res;
+			break;
+		case BATCH_READ:
+			if (res != -ECANCELED)
+				b->len[i] = res;
+			break;
+		default:
+			break;
 	}
-		
+}
+
+/*************************************************
+Function: proc_batch_flush
+Description: submit the queued sqes with one io_uring_enter and wait for all of them
+Calls: 
+	static void proc_batch_complete(proc_batch_t *b, unsigned long long data, int res)
+Input: proc_batch_t *b
+Output: 
+Return:
+	0   function run success
+	-1  io_uring_enter failed, the ring can't be trusted any more
+*************************************************/
+static int proc_batch_flush(proc_batch_t *b)
+{
+	proc_ring_t *ring = &b->ring;
+	unsigned submit = ring->queued;
+	unsigned done = 0;
+	unsigned head;
+	unsigned tail;
+	long ret;
+
+	if (ring->queued == 0)
+		return 0;
+	__atomic_store_n(ring->sq_tail, *ring->sq_tail + ring->queued, __ATOMIC_RELEASE);
+	while (done < ring->queued)
+	{
+		ret = syscall(__NR_io_uring_enter, ring->fd, submit, ring->queued - done, IORING_ENTER_GETEVENTS, NULL, 0);
+		if (ret < 0 && errno != EINTR)
+			return -1;
+		if (ret > 0)
+			submit -= (unsigned)ret;
+		head = *ring->cq_head;
+		tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+		if (ret == 0 && submit > 0 && head == tail)
+			return -1; /* nothing submitted and nothing to wait for */
+		for (; head != tail; head++, done++)
+		{
+			struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+
+			proc_batch_complete(b, cqe->user_data, cqe->res);
+		}
+		__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+	}
+	ring->queued = 0;
+	b->temp_used = 0;
+	return 0;
+}
+
+/*************************************************
+Function: proc_batch_ring
+Description: read a round through io_uring: a kept file is one READ_FIXED
+	on its registered slot, a new one is OPENAT straight into its slot
+	linked to the read, a file of this round only also links a CLOSE.
+	PROC_BATCH_RING sqes go per io_uring_enter
+Calls: 
+	static struct io_uring_sqe *ring_sqe(proc_ring_t *ring)
+	static int proc_batch_flush(proc_batch_t *b)
+Input: 
+	proc_batch_t *b
+	int n---requests of the round, set up by proc_batch_assign
+Output: b->len[]
+Return:
+	0   function run success
+	-1  io_uring failed, the round must be read again with pread
+*************************************************/
+static int proc_batch_ring(proc_batch_t *b, int n)
+{
+	proc_ring_t *ring = &b->ring;
+	struct io_uring_sqe *sqe;
+	unsigned need;
+	int temp;
+	int slot;
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		temp = b->slot[i] < 0;
+		need = b->opening[i] ? (temp ? 3 : 2) : 1;
+		if ((ring->queued + need > ring->entries || (temp && b->temp_used == PROC_BATCH_TEMP))
+			&& proc_batch_flush(b) < 0)
+			return -1;
+		slot = temp ? b->slot_keep + b->temp_used++ : b->slot[i];
+		if (b->opening[i])
+		{
+			sqe = ring_sqe(ring);
+			sqe->opcode = IORING_OP_OPENAT;
+			sqe->fd = b->dir_fd;
+			sqe->addr = (unsigned long)b->name[i];
+			sqe->open_flags = O_RDONLY;
+			sqe->file_index = slot + 1;
+			sqe->flags = IOSQE_IO_LINK;
+			sqe->user_data = ((unsigned long long)i << 2) | BATCH_OPEN;
+		}
+		sqe = ring_sqe(ring);
+		sqe->opcode = ring->fixed_buf ? IORING_OP_READ_FIXED : IORING_OP_READ;
+		sqe->fd = slot;
+		sqe->flags = IOSQE_FIXED_FILE | (temp ? IOSQE_IO_HARDLINK : 0);
+		sqe->addr = (unsigned long)(b->buf + (size_t)i * b->buf_size);
+		sqe->len = b->buf_size - 1;
+		sqe->user_data = ((unsigned long long)i << 2) | BATCH_READ;
+		if (temp)
+		{
+			/* hard link: the slot is closed even when the read fails */
+			sqe = ring_sqe(ring);
+			sqe->opcode = IORING_OP_CLOSE;
+			sqe->file_index = slot + 1;
+			sqe->user_data = BATCH_CLOSE;
+		}
+	}
+	if (proc_batch_flush(b) < 0)
+		return -1;
+	return b->ring_bad ? -1 : 0;
+}
+
+/*************************************************
+Function: proc_batch_retry
+Description: read a kept file that failed in an io_uring round once more by
+	name, its process may have exited and the pid come back. The slot is
+	given up, the next sweep opens the file into a new one
+Calls: 
+	static void proc_batch_drop(proc_batch_t *b, int slot)
+Input: 
+	proc_batch_t *b
+	const pid_t ids[]---pids of the round
+	int n---requests of the round
+Output: b->len[]
+*************************************************/
+static void proc_batch_retry(proc_batch_t *b, const pid_t ids[], int n)
+{
+	int fd;
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		if (b->opening[i] || b->slot[i] < 0 || b->len[i] >= 0)
+			continue;
+		proc_batch_drop(b, b->slot[i]);
+		b->slot[i] = -1;
+		snprintf(b->name[i], sizeof(b->name[i]), "%u/%s", ids[i], b->file);
+		fd = openat(b->dir_fd, b->name[i], O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			continue;
+		b->len[i] = (int)pread(fd, b->buf + (size_t)i * b->buf_size, b->buf_size - 1, 0);
+		close(fd);
+	}
+}
+
+/*************************************************
+Function: proc_batch_pread
+Description: read a round without io_uring, a kept file is one pread and
+	is opened again once if it went stale, like pread_proc_file
+Input: 
+	proc_batch_t *b
+	const pid_t ids[]---pids of the round
+	int n---requests of the round, set up by proc_batch_assign
+Output: b->len[]
+*************************************************/
+static void proc_batch_pread(proc_batch_t *b, const pid_t ids[], int n)
+{
+	char *buf;
+	int *fd;
+	int tmp;
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		buf = b->buf + (size_t)i * b->buf_size;
+		if (b->slot[i] < 0)
+		{
+			tmp = openat(b->dir_fd, b->name[i], O_RDONLY | O_CLOEXEC);
+			if (tmp < 0)
+				continue;
+			b->len[i] = (int)pread(tmp, buf, b->buf_size - 1, 0);
+			close(tmp);
+			continue;
+		}
+		fd = &b->fd[b->slot[i]];
+		if (!b->opening[i])
+		{
+			b->len[i] = (int)pread(*fd, buf, b->buf_size - 1, 0);
+			if (b->len[i] >= 0)
+				continue;
+			/* stale descriptor, the pid may be another process now */
+			close(*fd);
+			snprintf(b->name[i], sizeof(b->name[i]), "%u/%s", ids[i], b->file);
+		}
+		*fd = openat(b->dir_fd, b->name[i], O_RDONLY | O_CLOEXEC);
+		if (*fd >= 0)
+			b->len[i] = (int)pread(*fd, buf, b->buf_size - 1, 0);
+	}
+}
+
+/*************************************************
+Function: proc_batch_settle
+Description: finish a round: terminate the contents, carry the kept files
+	that were read into the sweep's open list and drop the ones that failed
+Calls: 
+	static void proc_batch_drop(proc_batch_t *b, int slot)
+Input: 
+	proc_batch_t *b
+	const pid_t ids[]---pids of the round
+	int n---requests of the round
+Output: 
+*************************************************/
+static void proc_batch_settle(proc_batch_t *b, const pid_t ids[], int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		if (b->len[i] >= 0)
+			b->buf[(size_t)i * b->buf_size + b->len[i]] = '\0';
+		if (b->slot[i] < 0)
+			continue;
+		if (b->len[i] < 0)
+		{
+			proc_batch_drop(b, b->slot[i]);
+			continue;
+		}
+		b->next[b->next_num].pid = ids[i];
+		b->next[b->next_num++].slot = b->slot[i];
+	}
+}
+
+/*************************************************
+Function: proc_batch_read
+Description: read <pid>/<file> of every pid in ids[] and hand each content to
+	fn in order. Rounds of PROC_BATCH_WINDOW files go to io_uring in one
+	submission, PROC_BATCH_RING sqes per io_uring_enter, so a warm sweep of
+	kept files costs a few syscalls instead of one per file. Without
+	io_uring (the default), or if it fails, the files are read with pread.
+	A kept file that fails is opened again before its pid counts as gone.
+	A backend set
+	with sys_check_cpu_set_proc_backend is read file by file
+Calls: 
+	static int proc_batch_start(proc_batch_t *b)
+	static int proc_batch_grow(proc_batch_t *b, int want)
+	static int proc_batch_assign(proc_batch_t *b, const pid_t ids[], int n, int j)
+	static int proc_batch_ring(proc_batch_t *b, int n)
+	static void proc_batch_pread(proc_batch_t *b, const pid_t ids[], int n)
+	static void proc_batch_retry(proc_batch_t *b, const pid_t ids[], int n)
+	static void proc_batch_settle(proc_batch_t *b, const pid_t ids[], int n)
+	static int proc_read(int *fd, const char *name, char *buf, int size)
+Input: 
+	proc_batch_t *b
+	const pid_t ids[]---pids to read, sorted
+	int num---how many pids in ids[]
+	proc_batch_fn fn---gets the index in ids[] and the '\0' terminated
+	 content, NULL and len < 0 if the file is gone; nonzero stops the sweep
+	void *arg---passed to fn
+Output: 
+Return:
+	0   function run success
+	<0  function run error
+*************************************************/
+static int proc_batch_read(proc_batch_t *b, const pid_t ids[], int num, proc_batch_fn fn, void *arg)
+{
+	char name[32];
+	proc_batch_open_t *t;
+	int base = 0;
+	int stop = 0;
+	int ret;
+	int n;
+	int i;
+	int j = 0;
+
+	if (proc_batch_grow(b, num) < 0 || (b->size == 0 && proc_batch_grow(b, 1) < 0))
+		return -ENOMEM;
+	if (g_proc_backend != NULL)
+	{
+		for (i = 0; i < num && !stop; i++)
+		{
+			snprintf(name, sizeof(name), "%u/%s", ids[i], b->file);
+			n = proc_read(NULL, name, b->buf, b->buf_size);
+			stop = fn(arg, i, n < 0 ? NULL : b->buf, n);
+		}
+		return 0;
+	}
+	if (b->dir_fd < 0 || b->gen != g_proc_gen || b->uring != __atomic_load_n(&g_proc_uring, __ATOMIC_RELAXED))
+	{
+		ret = proc_batch_start(b);
+		if (ret < 0)
+			return ret;
+	}
+
+	b->next_num = 0;
+	for (base = 0; base < num && !stop; base += n)
+	{
+		n = num - base < b->size ? num - base : b->size;
+		j = proc_batch_assign(b, ids + base, n, j);
+		if (b->ring.fd >= 0 && proc_batch_ring(b, n) < 0)
+		{
+			/* io_uring is unusable here, go on with pread for good */
+			printf("io_uring batch read failed, using pread\n");
+			b->uring_broken = 1;
+			ret = proc_batch_start(b);
+			if (ret < 0)
+				return ret;
+			j = proc_batch_assign(b, ids + base, n, 0);
+		}
+		if (b->ring.fd < 0)
+			proc_batch_pread(b, ids + base, n);
+		else
+			proc_batch_retry(b, ids + base, n);
+		proc_batch_settle(b, ids + base, n);
+		for (i = 0; i < n && !stop; i++)
+			stop = fn(arg, base + i, b->len[i] < 0 ? NULL : b->buf + (size_t)i * b->buf_size, b->len[i]);
+	}
+
+	/* kept files past the last pid are gone, unless the sweep stopped before them */
+	for (; j < b->open_num; j++)
+	{
+		if (base < num)
+			b->next[b->next_num++] = b->open[j];
+		else
+			proc_batch_drop(b, b->open[j].slot);
+	}
+	t = b->open;
+	b->open = b->next;
+	b->next = t;
+	b->open_num = b->next_num;
+	b->next_num = 0;
+	return 0;
+}
+
+static const char *skip_blank(const char *p)
+{
+	while (*p == ' ' || *p == '\t')
+		p++;
+	return p;
+}
+
+/*************************************************
+Function: parse_ull
+Description: parse a decimal integer (optionally negative) at *pp, no locale, no errno
+Input: const char **pp---parse position, moved past the number
+Output: unsigned long long *val---parsed value, negative numbers wrap like a cast
+Return: 
+	1   a number was parsed
+	0   no digit at *pp
+*************************************************/
+static int parse_ull(const char **pp, unsigned long long *val)
+{
+	const char *p = skip_blank(*pp);
+	unsigned long long v = 0;
+	int neg = 0;
+
+	if (*p == '-')
+	{
+		neg = 1;
+		p++;
+	}
+	if ((unsigned)(*p - '0') > 9)
+		return 0;
+	while ((unsigned)(*p - '0') <= 9)
+		v = v * 10 + (unsigned)(*p++ - '0');
+	*val = neg ? (unsigned long long)(-(long long)v) : v;
+	*pp = p;
+	return 1;
+}
+
+/*************************************************
+Function: parse_fixed
+Description: parse a "12.34" style number as /proc/loadavg prints it
+Input: const char **pp---parse position, moved past the number
+Output: float *val---parsed value
+Return: 
+	1   a number was parsed
+	0   no digit at *pp
+*************************************************/
+static int parse_fixed(const char **pp, float *val)
+{
+	unsigned long long ipart;
+	unsigned long long fpart = 0;
+	unsigned long long scale = 1;
+	const char *p = *pp;
+
+	if (!parse_ull(&p, &ipart))
+		return 0;
+	if (*p == '.')
+	{
+		p++;
+		while ((unsigned)(*p - '0') <= 9)
+		{
+			fpart = fpart * 10 + (unsigned)(*p++ - '0');
+			scale *= 10;
+		}
+	}
+	*val = (float)ipart + (float)fpart / (float)scale;
+	*pp = p;
+	return 1;
+}
+
+/*************************************************
+Function: parse_loadavg_buf
+Description: parse the content of /proc/loadavg into float cpuloadavg[CPU_LOADAVG_MAX]
+	and ctx->cur_cpuload. caller holds ctx->lock
+Input: 
+	cpu_ctx_t *ctx---context the result is stored in
+	const char *buf---"0.52 0.58 0.59 1/234 5678"
+Output: float cpuloadavg[CPU_LOADAVG_MAX]
+Return: 
+	0   function run success
+	-1  content is malformed
+*************************************************/
+static int parse_loadavg_buf(cpu_ctx_t *ctx, const char *buf, float cpuloadavg[CPU_LOADAVG_MAX])
+{
+	const char *p = buf;
+	unsigned long long val;
+	int i;
+
+	memset(cpuloadavg, 0, sizeof(cpuloadavg[0]) * CPU_LOADAVG_MAX);
+	for (i = CPU_LOADAVG_1MINS; i <= CPU_LOADAVG_15MINS; i++)
+	{
+		if (!parse_fixed(&p, &cpuloadavg[i]))
+			return -1;
+	}
+	memset(&ctx->cur_cpuload, 0, sizeof(ctx->cur_cpuload));
+	if (parse_ull(&p, &val))
+	{
+		cpuloadavg[CPU_LOADAVG_RESERVED1] = (float)val;
+		ctx->cur_cpuload.running = (unsigned)val;
+		if (*p == '/')
+			p++;
+		if (parse_ull(&p, &val))
+		{
+			ctx->cur_cpuload.total_tasks = (unsigned)val;
+			if (parse_ull(&p, &val))
+				ctx->cur_cpuload.last_pid = (unsigned)val;
+		}
+		cpuloadavg[CPU_LOADAVG_RESERVED2] = (float)val;
+	}
+
+	ctx->cur_cpuload.cpu_load_1min = cpuloadavg[CPU_LOADAVG_1MINS];
+	ctx->cur_cpuload.cpu_load_5min = cpuloadavg[CPU_LOADAVG_5MINS];
+	ctx->cur_cpuload.cpu_load_15min = cpuloadavg[CPU_LOADAVG_15MINS];
+	return 0;
+}
+
+/*************************************************
+Function: parse_loadavg
+Description: parse /proc/loadavg file and put data into float cpuloadavg[CPU_LOADAVG_MAX]
+	caller holds ctx->lock
+Calls: 
+	static int proc_read(int *fd, const char *name, char *buf, int size)
+	static int parse_loadavg_buf(cpu_ctx_t *ctx, const char *buf, float cpuloadavg[CPU_LOADAVG_MAX])
+Input: 
+	cpu_ctx_t *ctx---context owning the descriptor
+	float cpuloadavg[CPU_LOADAVG_MAX]  used to save current cpu's loadaverage data
+Output: current cpu's loadaverage data, also in ctx->cur_cpuload
+*************************************************/
+static int parse_loadavg(cpu_ctx_t *ctx, float cpuloadavg[CPU_LOADAVG_MAX])
+{
+	char buf[128];
+
+	if (proc_read(&ctx->loadavg_fd, "loadavg", buf, sizeof(buf)) < 0)
+	{
+		memset(cpuloadavg, 0, sizeof(cpuloadavg[0]) * CPU_LOADAVG_MAX);
+		return -1;
+	}
+	return parse_loadavg_buf(ctx, buf, cpuloadavg);
+}
+
+/*************************************************
+Function: read_cpu_jiffy
+Description: parse one "cpu"/"cpuN" line of /proc/stat and put data into jiffy_counts_t struct
+Input: 
+	const char **pp---parse position, moved to the start of the next line
+	jiffy_counts_t *p_jif used to save current cpu's jiffies data
+Output: current cpu's jiffies data
+Return: how many jiffy fields were parsed, 0 if the line is not a cpu line
+*************************************************/
+static int read_cpu_jiffy(const char **pp, jiffy_counts_t *p_jif)
+{
+	unsigned long long *field[10];
+	const char *p = *pp;
+	int ret = 0;
+
+	if (p[0] != 'c' || p[1] != 'p' || p[2] != 'u' /* not "cpu" */)
+		return 0;
+	p += 3;
+	while ((unsigned)(*p - '0') <= 9) /* skip the N of "cpuN" */
+		p++;
+
+	field[0] = &p_jif->usr;
+	field[1] = &p_jif->nic;
+	field[2] = &p_jif->sys;
+	field[3] = &p_jif->idle;
+	field[4] = &p_jif->iowait;
+	field[5] = &p_jif->irq;
+	field[6] = &p_jif->softirq;
+	field[7] = &p_jif->steal;
+	field[8] = &p_jif->guest; /* already counted in usr */
+	field[9] = &p_jif->guest_nice; /* already counted in nic */
+	while (ret < 10 && parse_ull(&p, field[ret]))
+		ret++;
+	if (ret >= 4) 
+	{
+		p_jif->total = p_jif->usr + p_jif->nic + p_jif->sys + p_jif->idle
+			+ p_jif->iowait + p_jif->irq + p_jif->softirq + p_jif->steal;
+		p_jif->busy = p_jif->total - p_jif->idle - p_jif->iowait;
+	}
+
+	p = strchr(p, '\n');
+	*pp = p ? p + 1 : *pp + strlen(*pp);
+	
+/*printf("usr(%llu) nic(%llu) sys(%llu) idle(%llu) iowait(%llu) irq(%llu) 
+softirq(%llu) steal(%llu) total(%llu) busy(%llu)\n",
+p_jif->usr,p_jif->nic,p_jif->sys,p_jif->idle,p_jif->iowait,p_jif->irq,
+p_jif->softirq,p_jif->steal, p_jif->total, p_jif->busy);*/
+	return ret;
+}
+
+/*************************************************
+Function: get_jiffy_counts
+Description: get /proc/stat information and store @jiffy_counts_t,
+	only the first line is parsed so a small stack buffer is enough.
+	caller holds ctx->lock
+Calls: 
+	static int proc_read(int *fd, const char *name, char *buf, int size)
+	static int read_cpu_jiffy(const char **pp, jiffy_counts_t *p_jif)
+Input: 
+	cpu_ctx_t *ctx---context owning the descriptor
+	jiffy_counts_t *jif used to save current /proc/stat data
+Output: current cpu's jiffies data
+*************************************************/
+static int get_jiffy_counts(cpu_ctx_t *ctx, jiffy_counts_t *jif)
+{
+	char buf[MAX_BUF_SIZE];
+	const char *p = buf;
+
+	memset(jif, 0, sizeof(*jif));
+	if (proc_read(&ctx->stat_fd, "stat", buf, sizeof(buf)) < 0
+		|| read_cpu_jiffy(&p, jif) < 4)
+	{
+		printf("can't read '%s/stat'", g_proc_root);
+		return -1;
+	}
+	return 0;
+}
+
+/*************************************************
+Function: get_jiffy_counts_percpu
+Description: read /proc/stat once, store the "cpu" line @jiffy_counts_t and
+	every "cpuN" line @ctx->cpu_jif[N], the previous per-core values move to ctx->prev_cpu_jif.
+	Only online cores have a line: an offline core keeps its last jiffies as
+	both values so it reads idle of nothing and picks up from its baseline
+	when it comes back, a hot-added core starts its baseline at the read.
+	A change of the online cores marks the topology stale.
+	caller holds ctx->lock
+Calls: 
+	static int proc_read(int *fd, const char *name, char *buf, int size)
+	static int read_cpu_jiffy(const char **pp, jiffy_counts_t *p_jif)
+Input: 
+	cpu_ctx_t *ctx---context owning the descriptor, buffer and per-core vectors
+	jiffy_counts_t *jif used to save current /proc/stat data
+Output: current cpu's jiffies data, per-core jiffies in ctx->cpu_jif[0..ctx->num_cpus-1]
+Return: 
+	0   function run success
+	-1  function run error
+*************************************************/
+static int get_jiffy_counts_percpu(cpu_ctx_t *ctx, jiffy_counts_t *jif)
+{
+	const char *p = ctx->stat_buf;
+	const char *q;
+	jiffy_counts_t line;
+	unsigned long long id;
+	int first = ctx->num_cpus == 0;
+	int n;
+
+	memset(jif, 0, sizeof(*jif));
+	if (proc_read(&ctx->stat_fd, "stat", ctx->stat_buf, PROC_STAT_BUF_SIZE) < 0
+		|| read_cpu_jiffy(&p, jif) < 4)
+	{
+		printf("can't read '%s/stat'", g_proc_root);
+		return -1;
+	}
+
+	for (n = 0; n < ctx->num_cpus; n++)
+		ctx->cpu_online[n] = (ctx->cpu_online[n] & CPU_ONLINE) ? CPU_SEEN | CPU_WAS_ONLINE
+			: ctx->cpu_online[n] & CPU_SEEN;
+	while (1)
+	{
+		memset(&line, 0, sizeof(line));
+		q = p + 3;
+		if (read_cpu_jiffy(&p, &line) < 4)
+			break;
+		if (!parse_ull(&q, &id) || id >= CPU_TOPO_MAX)
+			continue;
+		while (ctx->num_cpus <= (int)id)
+		{
+			/* vectors grow one consecutive idx at a time, new cores start zeroed and never seen */
+			ctx->cpu_jif = xrealloc_vector(ctx->cpu_jif, 1, ctx->num_cpus);
+			ctx->prev_cpu_jif = xrealloc_vector(ctx->prev_cpu_jif, 1, ctx->num_cpus);
+			ctx->cpu_online = xrealloc_vector(ctx->cpu_online, 1, ctx->num_cpus);
+			ctx->num_cpus++;
+		}
+		if (!first && !(ctx->cpu_online[id] & CPU_SEEN))
+			ctx->cpu_jif[id] = line; /* hot-added, no since-boot average */
+		ctx->prev_cpu_jif[id] = ctx->cpu_jif[id];
+		ctx->cpu_jif[id] = line;
+		ctx->cpu_online[id] |= CPU_ONLINE | CPU_SEEN;
+	}
+	for (n = 0; n < ctx->num_cpus; n++)
+	{
+		if (!(ctx->cpu_online[n] & CPU_ONLINE))
+			ctx->prev_cpu_jif[n] = ctx->cpu_jif[n];
+		if (!(ctx->cpu_online[n] & CPU_ONLINE) != !(ctx->cpu_online[n] & CPU_WAS_ONLINE))
+			ctx->topo_stale = 1;
+		ctx->cpu_online[n] &= CPU_ONLINE | CPU_SEEN;
+	}
+	return 0;
+}
+
+/*************************************************
+Function: calc_cpu_usage
+Description: accord 2 /proc/stat samples to calculate cpu's usage
+Input: 
+	const jiffy_counts_t *local_pjif---newer sample
+	const jiffy_counts_t *local_prev_pjif---older sample
+Output: cpu_usage_t *usage---usage precent of every field
+*************************************************/
+static void calc_cpu_usage(const jiffy_counts_t *local_pjif, const jiffy_counts_t *local_prev_pjif, cpu_usage_t *usage)
+{
+	double total_diff;
+
+	/* 64-bit deltas and floating point percent, nothing is rounded to whole percent */
+# define  CALC_TOTAL_DIFF do { \
+	total_diff = (double)(local_pjif->total - local_prev_pjif->total); \
+	if (total_diff == 0) total_diff = 1; \
+} while (0)
+
+#  define CALC_STAT(xxx) float xxx = (float)(100.0 * (double)(local_pjif->xxx - local_prev_pjif->xxx) / total_diff)
+#  define SHOW_STAT(xxx) xxx
+#  define FMT "%6.2f%% "
+
+	{
+		CALC_TOTAL_DIFF;
+
+		//printf("total_diff(%u)\n", total_diff);
+		{
+			CALC_STAT(usr);
+			CALC_STAT(sys);
+			CALC_STAT(nic);
+			CALC_STAT(idle);
+			CALC_STAT(iowait);
+			CALC_STAT(irq);
+			CALC_STAT(softirq);
+			CALC_STAT(steal);
+			CALC_STAT(guest);
+			CALC_STAT(guest_nice);
+			CALC_STAT(busy);
+			
+			usage->cpu_us = usr;
+			usage->cpu_sy = sys;
+			usage->cpu_ni = nic;
+			usage->cpu_id = idle;
+			usage->cpu_wa = iowait;
+			usage->cpu_hi = irq;
+			usage->cpu_si = softirq;
+			usage->cpu_st = steal;
+			usage->cpu_gu = guest;
+			usage->cpu_gn = guest_nice;
+			usage->cpu_total = busy;
+
+			/*printf(
+				"CPU:"FMT"usr"FMT"sys"FMT"nic"FMT"idle"FMT"io"FMT"irq"FMT"sirq\n",
+				SHOW_STAT(usr), SHOW_STAT(sys), SHOW_STAT(nic), SHOW_STAT(idle),
+				SHOW_STAT(iowait), SHOW_STAT(irq), SHOW_STAT(softirq)
+			);*/
+		}
+	}
+# undef CALC_TOTAL_DIFF
+# undef SHOW_STAT
+# undef CALC_STAT
+# undef FMT
+}
+
+/*************************************************
+Function: display_cpus
+Description: accord /proc/stat to calculate cpu's usage
+Calls: 
+	static void calc_cpu_usage(const jiffy_counts_t *local_pjif, const jiffy_counts_t *local_prev_pjif, cpu_usage_t *usage)
+Input: cpu_ctx_t *ctx
+Output: ctx->cur_cpu_usage
+*************************************************/
+static void display_cpus(cpu_ctx_t *ctx)
+{
+	calc_cpu_usage(&ctx->cur_jif, &ctx->prev_jif, &ctx->cur_cpu_usage);
+}
+
+/*************************************************
+Function: ctx_sample
+Description: read /proc/stat once and shift ctx->cur_jif into ctx->prev_jif,
+	ctx->cur_cpu_usage then holds the usage between the last 2 samples.
+	caller holds ctx->lock
+Calls: 
+	static int get_jiffy_counts_percpu(cpu_ctx_t *ctx, jiffy_counts_t *jif)
+	static void display_cpus(cpu_ctx_t *ctx)
+Input: cpu_ctx_t *ctx
+Output: 
+Return: 
+	0   function run success
+	-1  function run error
+*************************************************/
+static int ctx_sample(cpu_ctx_t *ctx)
+{
+	jiffy_counts_t jif;
+
+	if (get_jiffy_counts_percpu(ctx, &jif) < 0)
+		return -1;
+	ctx->prev_jif = ctx->cur_jif;
+	ctx->cur_jif = jif;
+	display_cpus(ctx);
+	return 0;
+}
+
+static unsigned long long monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* the procfs source's clock, a replayed trace runs on its own timestamps */
+static unsigned long long proc_clock(void)
+{
+	if (g_proc_backend != NULL && g_proc_backend->clock != NULL)
+		return g_proc_backend->clock(g_proc_backend->priv);
+	return monotonic_ns();
+}
+
+/* CLOCK_BOOTTIME, a replayed trace has only its own clock */
+static unsigned long long boottime_ns(void)
+{
+	struct timespec ts;
+
+	if (g_proc_backend != NULL && g_proc_backend->clock != NULL)
+		return g_proc_backend->clock(g_proc_backend->priv);
+	clock_gettime(CLOCK_BOOTTIME, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*************************************************
+Function: sample_stamp
+Description: tag a sample whose reads started at begin, a sweep of many
+	files is dated half way through so the reads before and after the
+	stamp balance out
+Calls: 
+	static unsigned long long proc_clock(void)
+	static unsigned long long boottime_ns(void)
+Input: unsigned long long begin---proc_clock() before the first read
+Output: sample_time_t *st
+*************************************************/
+static void sample_stamp(sample_time_t *st, unsigned long long begin)
+{
+	unsigned long long end = proc_clock();
+
+	st->scan_ns = end > begin ? end - begin : 0;
+	st->mono_ns = begin + st->scan_ns / 2;
+	st->boot_ns = boottime_ns() - st->scan_ns / 2;
+}
+
+/* sleep between 2 samples, a replayed trace steps forward instead */
+static void proc_wait(int usec)
+{
+	if (g_proc_backend != NULL && g_proc_backend->wait != NULL)
+		g_proc_backend->wait(g_proc_backend->priv, usec);
+	else
+		usleep(usec);
+}
+
+static int cpu_mask_test(const cpu_mask_t *m, int cpu)
+{
+	return (m->bits[cpu / (8 * sizeof(m->bits[0]))] >> (cpu % (8 * sizeof(m->bits[0])))) & 1;
+}
+
+static int cpu_mask_count(const cpu_mask_t *m)
+{
+	int n = 0;
+	int i;
+
+	for (i = 0; i < CPU_TOPO_MAX; i++)
+		n += cpu_mask_test(m, i);
+	return n;
+}
+
+/*************************************************
+Function: parse_cpu_list
+Description: parse a kernel cpu list such as "0-3,8,10-11"
+Calls: 
+	static int parse_ull(const char **pp, unsigned long long *val)
+Input: const char *p
+Output: cpu_mask_t *m---cleared first, ids past CPU_TOPO_MAX are left out
+Return: how many cpus the list holds, 0 for an empty or bad list
+*************************************************/
+static int parse_cpu_list(const char *p, cpu_mask_t *m)
+{
+	unsigned long long lo;
+	unsigned long long hi;
+
+	memset(m, 0, sizeof(*m));
+	while (parse_ull(&p, &lo))
+	{
+		hi = lo;
+		/* parse_ull would take "-3" as a negative number */
+		if (*p == '-')
+		{
+			p++;
+			if (!parse_ull(&p, &hi) || hi < lo)
+				return 0;
+		}
+		for (; lo <= hi && lo < CPU_TOPO_MAX; lo++)
+			m->bits[lo / (8 * sizeof(m->bits[0]))] |= 1UL << (lo % (8 * sizeof(m->bits[0])));
+		if (*p != ',')
+			break;
+		p++;
+	}
+	return cpu_mask_count(m);
+}
+
+/* whether a v1 "cpu,cpuacct" style controller list names controller */
+static int cgroup_has_controller(const char *list, const char *controller)
+{
+	int len = (int)strlen(controller);
+	const char *p;
+
+	for (p = list; (p = strstr(p, controller)) != NULL; p += len)
+		if ((p == list || p[-1] == ',') && (p[len] == '\0' || p[len] == ','))
+			return 1;
+	return 0;
+}
+
+/*************************************************
+Function: cgroup_path
+Description: the cgroup directory of a process, relative to its hierarchy's root
+Calls: 
+	static int proc_read(int *fd, const char *name, char *buf, int size)
+	static int cgroup_has_controller(const char *list, const char *controller)
+Input: 
+	pid_t pid---0 for the calling process
+	const char *controller---NULL for the cgroup v2 "0::" line, else a v1 controller
+	int size---size of path
+Output: char *path---"/system.slice/foo.service" ...
+Return: 
+	0   function run success
+	-1  the pid is gone or not in such a hierarchy
+*************************************************/
+static int cgroup_path(pid_t pid, const char *controller, char *path, int size)
+{
+	char buf[MAX_BUF_SIZE];
+	char name[32];
+	char *p;
+	char *end;
+	char *list;
+	char *sep;
+
+	if (pid == 0)
+		snprintf(name, sizeof(name), "self/cgroup");
+	else
+		snprintf(name, sizeof(name), "%u/cgroup", pid);
+	if (proc_read(NULL, name, buf, sizeof(buf)) < 0)
+		return -1;
+	/* "<id>:<controller,...>:<path>" lines, the unified hierarchy is "0::<path>" */
+	for (p = buf; p != NULL && *p != '\0'; p = end)
+	{
+		end = strchr(p, '\n');
+		if (end != NULL)
+			*end++ = '\0';
+		list = strchr(p, ':');
+		sep = list != NULL ? strchr(list + 1, ':') : NULL;
+		if (sep == NULL)
+			continue;
+		*sep = '\0';
+		if (controller == NULL ? strcmp(p, "0:") == 0 : cgroup_has_controller(list + 1, controller))
+			return snprintf(path, size, "%s", sep + 1) >= size ? -1 : 0;
+	}
+	return -1;
+}
+
+/*************************************************
+Function: topo_open_cpuset
+Description: open the cpuset file of the calling process's cgroup, v2
+	cpuset.cpus.effective or else v1 cpuset.effective_cpus. A cgroup
+	without the cpuset controller runs on its nearest ancestor's cpus.
+	caller holds ctx->lock
+Calls: 
+	static int cgroup_path(pid_t pid, const char *controller, char *path, int size)
+Input: cpu_ctx_t *ctx
+Output: ctx->cpuset_fd----2 when no hierarchy has one
+*************************************************/
+static void topo_open_cpuset(cpu_ctx_t *ctx)
+{
+	char rel[CGROUP_PATH_SIZE];
+	char path[CGROUP_PATH_SIZE + 64];
+	char *cut;
+	int v1;
+
+	ctx->cpuset_fd = -2;
+	for (v1 = 0; v1 < 2 && ctx->cpuset_fd < 0; v1++)
+	{
+		if (cgroup_path(0, v1 ? "cpuset" : NULL, rel, sizeof(rel)) < 0)
+			continue;
+		while (ctx->cpuset_fd < 0)
+		{
+			snprintf(path, sizeof(path), "%s%s%s/%s", CGROUP_ROOT, v1 ? "/cpuset" : "",
+				strcmp(rel, "/") == 0 ? "" : rel, v1 ? "cpuset.effective_cpus" : "cpuset.cpus.effective");
+			ctx->cpuset_fd = open(path, O_RDONLY | O_CLOEXEC);
+			cut = strrchr(rel, '/');
+			if (ctx->cpuset_fd >= 0 || cut == NULL || strcmp(rel, "/") == 0)
+				break;
+			if (cut == rel)
+				cut++; /* the root keeps its '/' */
+			*cut = '\0';
+		}
+		if (ctx->cpuset_fd < 0)
+			ctx->cpuset_fd = -2;
+	}
+}
+
+/*************************************************
+Function: topo_refresh
+Description: check which cpus the context may use, at most once per
+	CPU_TOPO_RECHECK unless /proc/stat showed a core come or go or the
+	procfs source changed. A check costs a pread of the online list, a
+	sched_getaffinity and a pread of the cpuset file. The affinity is the
+	process's (its main thread's), not the calling thread's, so a sampler
+	pinned to one core still sees the cpus of the whole process.
+	ctx->topo.gen is bumped if anything changed. A procfs that is not the
+	host's gives its /proc/stat cores as the online set and no affinity or
+	cpuset. caller holds ctx->lock
+Calls: 
+	static int get_jiffy_counts_percpu(cpu_ctx_t *ctx, jiffy_counts_t *jif)
+	static int parse_cpu_list(const char *p, cpu_mask_t *m)
+	static void topo_open_cpuset(cpu_ctx_t *ctx)
+Input: cpu_ctx_t *ctx
+Output: ctx->topo, ctx->topo_avail
+Return: 
+	0   function run success
+	-1  function run error, no online cpu could be found
+*************************************************/
+static int topo_refresh(cpu_ctx_t *ctx)
+{
+	char buf[MAX_BUF_SIZE];
+	cpu_mask_t online;
+	cpu_mask_t affinity;
+	cpu_mask_t cpuset;
+	cpu_mask_t avail;
+	cpu_topo_t topo;
+	jiffy_counts_t jif;
+	unsigned long long now = monotonic_ns();
+	ssize_t n;
+	int i;
+
+	if (ctx->topo_ns != 0 && !ctx->topo_stale && ctx->topo_src == g_proc_gen && now - ctx->topo_ns < (unsigned long long)CPU_TOPO_RECHECK * 1000)
+		return 0;
+
+	memset(&topo, 0, sizeof(topo));
+	memset(&online, 0, sizeof(online));
+	if (g_proc_host && pread_proc_file(&ctx->online_fd, CPU_ONLINE_PATH, buf, sizeof(buf)) > 0)
+		topo.online = parse_cpu_list(buf, &online);
+	if (topo.online == 0)
+	{
+		if (ctx->num_cpus == 0 && get_jiffy_counts_percpu(ctx, &jif) < 0)
+			return -1;
+		for (i = 0; i < ctx->num_cpus; i++)
+			if (ctx->cpu_online[i] & CPU_ONLINE)
+				online.bits[i / (8 * sizeof(online.bits[0]))] |= 1UL << (i % (8 * sizeof(online.bits[0])));
+		topo.online = cpu_mask_count(&online);
+		if (topo.online == 0)
+			return -1;
+	}
+
+	affinity = online;
+	cpuset = online;
+	if (g_proc_host)
+	{
+		memset(&affinity, 0, sizeof(affinity));
+		if (syscall(SYS_sched_getaffinity, getpid(), sizeof(affinity.bits), affinity.bits) < 0)
+			affinity = online;
+		if (ctx->cpuset_fd == -1)
+			topo_open_cpuset(ctx);
+		n = ctx->cpuset_fd >= 0 ? pread(ctx->cpuset_fd, buf, sizeof(buf) - 1, 0) : -1;
+		if (n > 0)
+			buf[n] = '\0';
+		/* an empty effective list means the cgroup has no cpus of its own yet */
+		if (n <= 0 || parse_cpu_list(buf, &cpuset) == 0)
+			cpuset = online;
+	}
+
+	for (i = 0; i < (int)(sizeof(avail.bits) / sizeof(avail.bits[0])); i++)
+		avail.bits[i] = online.bits[i] & affinity.bits[i] & cpuset.bits[i];
+	for (i = CPU_TOPO_MAX - 1; i > 0 && !cpu_mask_test(&online, i); i--)
+		;
+	topo.id_limit = i + 1;
+	topo.affinity = cpu_mask_count(&affinity);
+	topo.cpuset = cpu_mask_count(&cpuset);
+	topo.available = cpu_mask_count(&avail);
+	if (topo.available == 0)
+	{
+		/* the sets don't meet, the online set is the best guess */
+		avail = online;
+		topo.available = topo.online;
+	}
+	topo.gen = ctx->topo.gen;
+	if (memcmp(&topo, &ctx->topo, sizeof(topo)) != 0 || memcmp(&avail, &ctx->topo_avail, sizeof(avail)) != 0)
+		topo.gen++;
+	ctx->topo = topo;
+	ctx->topo_avail = avail;
+	ctx->topo_ns = now;
+	ctx->topo_stale = 0;
+	ctx->topo_src = g_proc_gen;
+	return 0;
+}
+
+/* owner side of a worker's share: the next chunk from its front, -1 when it is empty */
+static int scan_take(scan_worker_t *w)
+{
+	unsigned long long r = __atomic_load_n(&w->range, __ATOMIC_ACQUIRE);
+	unsigned lo;
+	unsigned hi;
+
+	while (1)
+	{
+		lo = (unsigned)r;
+		hi = (unsigned)(r >> 32);
+		if (lo >= hi)
+			return -1;
+		if (__atomic_compare_exchange_n(&w->range, &r, ((unsigned long long)hi << 32) | (lo + 1),
+				0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			return (int)lo;
+	}
+}
+
+/* thief side: the last chunk of the first other worker that has some left, -1 when all are empty */
+static int scan_steal(scan_worker_t *w)
+{
+	scan_worker_t *v;
+	unsigned long long r;
+	unsigned lo;
+	unsigned hi;
+	int i;
+
+	for (i = 1; i < g_scan_workers; i++)
+	{
+		v = &g_scan_worker[(w - g_scan_worker + i) % g_scan_workers];
+		r = __atomic_load_n(&v->range, __ATOMIC_ACQUIRE);
+		while (1)
+		{
+			lo = (unsigned)r;
+			hi = (unsigned)(r >> 32);
+			if (lo >= hi)
+				break;
+			if (__atomic_compare_exchange_n(&v->range, &r, ((unsigned long long)(hi - 1) << 32) | lo,
+					0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			{
+				w->steals++;
+				return (int)(hi - 1);
+			}
+		}
+	}
+	return -1;
+}
+
+/* proc_batch_fn of a worker, gives the job's callback the index in the whole ids[] */
+static int scan_forward(void *arg, int i, const char *buf, int len)
+{
+	scan_worker_t *w = arg;
+
+	return w->job->fn(w->job->arg, w->base + i, buf, len);
+}
+
+/*************************************************
+Function: scan_run
+Description: read chunks of a job until no worker has any left, its own
+	share first, then chunks stolen from the back of the others'
+Calls: 
+	static int scan_take(scan_worker_t *w)
+	static int scan_steal(scan_worker_t *w)
+	static int proc_batch_read(proc_batch_t *b, const pid_t ids[], int num, proc_batch_fn fn, void *arg)
+Input: 
+	scan_worker_t *w
+	scan_job_t *job
+Output: 
+*************************************************/
+static void scan_run(scan_worker_t *w, scan_job_t *job)
+{
+	int chunk;
+	int n;
+	int ret;
+
+	w->job = job;
+	while ((chunk = scan_take(w)) >= 0 || (chunk = scan_steal(w)) >= 0)
+	{
+		w->base = chunk * SCAN_CHUNK;
+		n = job->num - w->base < SCAN_CHUNK ? job->num - w->base : SCAN_CHUNK;
+		ret = proc_batch_read(&w->batch[job->kind], job->ids + w->base, n, scan_forward, w);
+		if (ret < 0)
+			__atomic_store_n(&job->ret, ret, __ATOMIC_RELAXED);
+	}
+}
+
+static void *scan_thread(void *arg)
+{
+	scan_worker_t *w = arg;
+	scan_job_t *job;
+
+	pthread_mutex_lock(&g_scan_lock);
+	while (1)
+	{
+		while (!g_scan_quit && g_scan_gen == w->gen)
+			pthread_cond_wait(&g_scan_cond, &g_scan_lock);
+		if (g_scan_quit)
+			break;
+		w->gen = g_scan_gen;
+		job = g_scan_job;
+		pthread_mutex_unlock(&g_scan_lock);
+		scan_run(w, job);
+		pthread_mutex_lock(&g_scan_lock);
+		if (--g_scan_active == 0)
+			pthread_cond_signal(&g_scan_done);
+	}
+	pthread_mutex_unlock(&g_scan_lock);
+	return NULL;
+}
+
+/*************************************************
+Function: scan_pool_stop
+Description: stop the scan worker threads and free their readers, scans are
+	serial afterwards. Caller holds g_scan_run
+Calls: 
+	static void proc_batch_free(proc_batch_t *b)
+Input: int started---threads that were created, worker 1 up
+Output: 
+*************************************************/
+static void scan_pool_stop(int started)
+{
+	int i;
+	int k;
+
+	if (g_scan_worker == NULL)
+		return;
+	pthread_mutex_lock(&g_scan_lock);
+	g_scan_quit = 1;
+	pthread_cond_broadcast(&g_scan_cond);
+	pthread_mutex_unlock(&g_scan_lock);
+	for (i = 1; i <= started; i++)
+		pthread_join(g_scan_worker[i].tid, NULL);
+	for (i = 0; i < g_scan_workers; i++)
+	{
+		for (k = 0; k < SCAN_KIND_MAX; k++)
+			proc_batch_free(&g_scan_worker[i].batch[k]);
+	}
+	free(g_scan_worker);
+	__atomic_store_n(&g_scan_worker, NULL, __ATOMIC_RELEASE);
+	g_scan_workers = 1;
+	g_scan_quit = 0;
+}
+
+/*************************************************
+Function: scan_pool_start
+Description: start workers - 1 scan threads, the caller of a scan is worker 0.
+	Caller holds g_scan_run and no pool runs
+Calls: 
+	static void proc_batch_init(proc_batch_t *b, const char *file, int buf_size, int keep)
+	static void scan_pool_stop(int started)
+Input: int workers---2 to SCAN_MAX_WORKERS
+Output: 
+Return: 
+	0   function run success
+	-ENOMEM  out of memory
+	-EAGAIN  a thread could not be created
+*************************************************/
+static int scan_pool_start(int workers)
+{
+	scan_worker_t *pool;
+	int i;
+
+	pool = calloc(workers, sizeof(pool[0]));
+	if (pool == NULL)
+		return -ENOMEM;
+	/* serial scans check it without g_scan_run and take the lock from now on */
+	__atomic_store_n(&g_scan_worker, pool, __ATOMIC_RELEASE);
+	g_scan_workers = workers;
+	for (i = 0; i < workers; i++)
+	{
+		/* a worker reads different pids on every scan, keeping files open would not pay */
+		proc_batch_init(&g_scan_worker[i].batch[SCAN_INDEX], "stat", PID_STAT_BUF_SIZE, 0);
+		proc_batch_init(&g_scan_worker[i].batch[SCAN_TOP], "stat", PID_STAT_BUF_SIZE, 0);
+		g_scan_worker[i].gen = g_scan_gen;
+	}
+	for (i = 1; i < workers; i++)
+	{
+		if (pthread_create(&g_scan_worker[i].tid, NULL, scan_thread, &g_scan_worker[i]) != 0)
+		{
+			printf("can't create scan worker %d\n", i);
+			scan_pool_stop(i - 1);
+			return -EAGAIN;
+		}
+	}
+	return 0;
+}
+
+/*************************************************
+Function: proc_scan
+Description: read <pid>/<file> of every pid in ids[], split across the scan
+	workers when there are some: ids[] is cut into chunks of SCAN_CHUNK,
+	each worker gets an even share and steals from the others once its own
+	is done. Every worker reads into its own buffers and calls fn for its
+	pids, so fn must only write the entry of the index it is given.
+	With one worker, or less than 2 chunks, serial reads fn in order;
+	without a pool g_scan_run is not taken, so contexts scan independently.
+	The size and wall time go to g_scan_stat[kind]
+Calls: 
+	static int proc_batch_read(proc_batch_t *b, const pid_t ids[], int num, proc_batch_fn fn, void *arg)
+	static void scan_run(scan_worker_t *w, scan_job_t *job)
+Input: 
+	int kind---SCAN_INDEX or SCAN_TOP, picks the workers' reader
+	proc_batch_t *serial---reader of the serial scan, it may keep files open
+	const pid_t ids[]---pids to read, sorted
+	int num---how many pids in ids[]
+	proc_batch_fn fn
+	void *arg---passed to fn
+Output: 
+Return:
+	0   function run success
+	<0  function run error
+*************************************************/
+static int proc_scan(int kind, proc_batch_t *serial, const pid_t ids[], int num, proc_batch_fn fn, void *arg)
+{
+	scan_job_t job;
+	scan_stat_t stat;
+	int chunks = (num + SCAN_CHUNK - 1) / SCAN_CHUNK;
+	int pooled;
+	int ret;
+	int i;
+
+	memset(&stat, 0, sizeof(stat));
+	stat.start_ns = monotonic_ns();
+	stat.pids = num;
+	stat.workers = 1;
+	pooled = chunks >= 2 && __atomic_load_n(&g_scan_worker, __ATOMIC_ACQUIRE) != NULL;
+	if (pooled)
+	{
+		pthread_mutex_lock(&g_scan_run);
+		/* the pool may have stopped since */
+		pooled = g_scan_worker != NULL;
+		if (!pooled)
+			pthread_mutex_unlock(&g_scan_run);
+	}
+	if (!pooled)
+		ret = proc_batch_read(serial, ids, num, fn, arg);
+	else
+	{
+		job.kind = kind;
+		job.ids = ids;
+		job.num = num;
+		job.fn = fn;
+		job.arg = arg;
+		job.ret = 0;
+		for (i = 0; i < g_scan_workers; i++)
+		{
+			unsigned lo = (unsigned)((long long)chunks * i / g_scan_workers);
+			unsigned hi = (unsigned)((long long)chunks * (i + 1) / g_scan_workers);
+
+			g_scan_worker[i].range = ((unsigned long long)hi << 32) | lo;
+			g_scan_worker[i].steals = 0;
+		}
+		pthread_mutex_lock(&g_scan_lock);
+		g_scan_job = &job;
+		g_scan_gen++;
+		g_scan_active = g_scan_workers - 1;
+		pthread_cond_broadcast(&g_scan_cond);
+		pthread_mutex_unlock(&g_scan_lock);
+
+		scan_run(&g_scan_worker[0], &job);
+
+		pthread_mutex_lock(&g_scan_lock);
+		while (g_scan_active > 0)
+			pthread_cond_wait(&g_scan_done, &g_scan_lock);
+		g_scan_job = NULL;
+		pthread_mutex_unlock(&g_scan_lock);
+		ret = job.ret;
+		stat.workers = g_scan_workers;
+		for (i = 0; i < g_scan_workers; i++)
+			stat.steals += g_scan_worker[i].steals;
+		pthread_mutex_unlock(&g_scan_run);
+	}
+	stat.wall_ns = monotonic_ns() - stat.start_ns;
+
+	pthread_mutex_lock(&g_scan_lock);
+	g_scan_stat[kind] = stat;
+	pthread_mutex_unlock(&g_scan_lock);
+	return ret;
+}
+
+/*************************************************
+Function: history_push
+Description: store one sample in the history ring, only the sampler thread
+	calls it, nothing is allocated here
+Input: const cpu_sample_t *sample
+Output: 
+*************************************************/
+static void history_push(const cpu_sample_t *sample)
+{
+	unsigned long long head = __atomic_load_n(&g_history_head, __ATOMIC_RELAXED);
+	history_slot_t *slot = &g_history[head & g_history_mask];
+	unsigned seq = slot->seq;
+
+	__atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	slot->sample = *sample;
+	__atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+	__atomic_store_n(&g_history_head, head + 1, __ATOMIC_RELEASE);
+}
+
+/*************************************************
+Function: history_read
+Description: copy one slot of the history ring without locking
+Input: unsigned long long idx---sample number, smaller than g_history_head
+Output: cpu_sample_t *sample
+Return: 
+	0   function run success
+	-1  slot was being rewritten, the sample is lost
+*************************************************/
+static int history_read(unsigned long long idx, cpu_sample_t *sample)
+{
+	history_slot_t *slot = &g_history[idx & g_history_mask];
+	unsigned seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+	if (seq & 1)
+		return -1;
+	memcpy(sample, &slot->sample, sizeof(*sample));
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq)
+		return -1;
+	return 0;
+}
+
+/*************************************************
+Function: sampler_thread
+Description: background loop, sample g_default_ctx every g_sampler_period
+	so its cur_cpu_usage always holds the latest delta
+Calls: 
+	static int ctx_sample(cpu_ctx_t *ctx)
+	static void sample_stamp(sample_time_t *st, unsigned long long begin)
+	static int topo_refresh(cpu_ctx_t *ctx)
+Input: unused
+Output: 
+*************************************************/
+static void alert_eval(const cpu_sample_t *sample, int num_cpus);
+
+static void *sampler_thread(void *arg)
+{
+	struct timespec ts;
+	unsigned long long begin;
+
+	(void)arg;
+	pthread_mutex_lock(&g_sampler_lock);
+	while (!g_sampler_stop)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		ts.tv_sec += g_sampler_period / 1000000;
+		ts.tv_nsec += (long)(g_sampler_period % 1000000) * 1000;
+		if (ts.tv_nsec >= 1000000000)
+		{
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+		while (!g_sampler_stop && pthread_cond_timedwait(&g_sampler_cond, &g_sampler_lock, &ts) != ETIMEDOUT)
+			; /* spurious wakeup, keep waiting for the deadline */
+		if (g_sampler_stop)
+			break;
+
+		/* don't hold the sampler lock across file I/O, start/stop must not wait for it */
+		pthread_mutex_unlock(&g_sampler_lock);
+		pthread_mutex_lock(&g_default_ctx.lock);
+		begin = proc_clock();
+		if (ctx_sample(&g_default_ctx) == 0
+			&& (g_history != NULL || __atomic_load_n(&g_alert_num, __ATOMIC_RELAXED) > 0))
+		{
+			float cpuloadavg[CPU_LOADAVG_MAX];
+			cpu_sample_t sample;
+			sample_time_t st;
+			int num_cpus;
+
+			sample_stamp(&st, begin);
+			parse_loadavg(&g_default_ctx, cpuloadavg);
+			sample.ts = st.mono_ns;
+			sample.boot_ts = st.boot_ns;
+			sample.usage = g_default_ctx.cur_cpu_usage;
+			sample.load = g_default_ctx.cur_cpuload;
+			num_cpus = topo_refresh(&g_default_ctx) == 0 ? g_default_ctx.topo.available : g_default_ctx.num_cpus;
+			pthread_mutex_unlock(&g_default_ctx.lock);
+			if (g_history != NULL)
+				history_push(&sample);
+			alert_eval(&sample, num_cpus);
+		}
+		else
+			pthread_mutex_unlock(&g_default_ctx.lock);
+		pthread_mutex_lock(&g_sampler_lock);
+	}
+	pthread_mutex_unlock(&g_sampler_lock);
+	return NULL;
+}
+
+/*************************************************
+Function: sys_check_cpu_sampler_start
+Description: start the background /proc/stat sampler, after that
+	sys_check_cpu_usage answers from the latest delta without sleeping
+Calls: 
+	static int ctx_sample(cpu_ctx_t *ctx)
+Input: int period---time between 2 samples (unit:microsecond),
+	0 means SAMPLER_DEFAULT_PERIOD, must not be smaller than SAMPLER_MIN_PERIOD
+Output: 
+Return:
+	0   function run success
+	-1  function run error
+*************************************************/
+int sys_check_cpu_sampler_start (int period)
+{
+	pthread_condattr_t attr;
+	int ret;
+
+	if (period != 0 && period < SAMPLER_MIN_PERIOD)
+		return -EINVAL;
+
+	pthread_mutex_lock(&g_sampler_lock);
+	if (g_sampler_running)
+	{
+		pthread_mutex_unlock(&g_sampler_lock);
+		return -EBUSY;
+	}
+
+	/* first sample is taken here, until the next one the usage is the average since boot */
+	pthread_mutex_lock(&g_default_ctx.lock);
+	memset(&g_default_ctx.cur_jif, 0, sizeof(g_default_ctx.cur_jif));
+	ret = ctx_sample(&g_default_ctx);
+	pthread_mutex_unlock(&g_default_ctx.lock);
+	if (ret < 0)
+	{
+		pthread_mutex_unlock(&g_sampler_lock);
+		return -1;
+	}
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&g_sampler_cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	g_sampler_period = period ? period : SAMPLER_DEFAULT_PERIOD;
+	g_sampler_stop = 0;
+	if (pthread_create(&g_sampler_tid, NULL, sampler_thread, NULL) != 0)
+	{
+		printf("can't create sampler thread because:%s\n", strerror(errno));
+		pthread_cond_destroy(&g_sampler_cond);
+		pthread_mutex_unlock(&g_sampler_lock);
+		return -1;
+	}
+	g_sampler_running = 1;
+	pthread_mutex_unlock(&g_sampler_lock);
+	return 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_sampler_stop
+Description: stop the background sampler and wait for its thread to exit,
+	sys_check_cpu_usage goes back to the blocking two-read measurement
+Input: 
+Output: 
+Return:
+	0   function run success
+	-1  sampler is not running
+*************************************************/
+int sys_check_cpu_sampler_stop (void)
+{
+	pthread_mutex_lock(&g_sampler_lock);
+	if (!g_sampler_running)
+	{
+		pthread_mutex_unlock(&g_sampler_lock);
+		return -1;
+	}
+	g_sampler_stop = 1;
+	pthread_cond_signal(&g_sampler_cond);
+	pthread_mutex_unlock(&g_sampler_lock);
+
+	pthread_join(g_sampler_tid, NULL);
+
+	pthread_mutex_lock(&g_sampler_lock);
+	pthread_cond_destroy(&g_sampler_cond);
+	g_sampler_running = 0;
+	pthread_mutex_unlock(&g_sampler_lock);
+	return 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_sampler_set_period
+Description: change the background sampler's period, takes effect from the next sample
+Input: int period---time between 2 samples (unit:microsecond), 0 means SAMPLER_DEFAULT_PERIOD
+Output: 
+Return:
+	0   function run success
+	-EINVAL period is smaller than SAMPLER_MIN_PERIOD
+*************************************************/
+int sys_check_cpu_sampler_set_period (int period)
+{
+	if (period != 0 && period < SAMPLER_MIN_PERIOD)
+		return -EINVAL;
+
+	pthread_mutex_lock(&g_sampler_lock);
+	g_sampler_period = period ? period : SAMPLER_DEFAULT_PERIOD;
+	pthread_mutex_unlock(&g_sampler_lock);
+	return 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_history_enable
+Description: preallocate the sample history ring, every sampler tick then
+	stores its usage and load average there; call it while the sampler is stopped
+Input: int capacity---samples kept, rounded up to a power of 2, at most HISTORY_MAX_SIZE
+Output: 
+Return: 
+	0   function run success
+	-EBUSY  sampler is running
+	-EINVAL bad capacity
+	-ENOMEM out of memory
+*************************************************/
+int sys_check_cpu_history_enable (int capacity)
+{
+	unsigned size = 1;
+	history_slot_t *ring;
+
+	if (capacity <= 0 || capacity > HISTORY_MAX_SIZE)
+		return -EINVAL;
+	while (size < (unsigned)capacity)
+		size <<= 1;
+
+	pthread_mutex_lock(&g_sampler_lock);
+	if (g_sampler_running)
+	{
+		pthread_mutex_unlock(&g_sampler_lock);
+		return -EBUSY;
+	}
+	ring = calloc(size, sizeof(ring[0]));
+	if (ring == NULL)
+	{
+		pthread_mutex_unlock(&g_sampler_lock);
+		return -ENOMEM;
+	}
+	free(g_history);
+	g_history = ring;
+	g_history_mask = size - 1;
+	g_history_head = 0;
+	pthread_mutex_unlock(&g_sampler_lock);
+	return 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_history_disable
+Description: free the sample history ring; call it while the sampler is
+	stopped and no query is running
+Input: 
+Output: 
+Return: 
+	0   function run success
+	-EBUSY  sampler is running
+*************************************************/
+int sys_check_cpu_history_disable (void)
+{
+	pthread_mutex_lock(&g_sampler_lock);
+	if (g_sampler_running)
+	{
+		pthread_mutex_unlock(&g_sampler_lock);
+		return -EBUSY;
+	}
+	free(g_history);
+	g_history = NULL;
+	g_history_mask = 0;
+	g_history_head = 0;
+	pthread_mutex_unlock(&g_sampler_lock);
+	return 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_history_latest
+Description: give the newest sample of the history ring
+Calls: 
+	static int history_read(unsigned long long idx, cpu_sample_t *sample)
+Input: 
+Output: cpu_sample_t *sample
+Return: 
+	0   function run success
+	-1  no sample yet
+*************************************************/
+int sys_check_cpu_history_latest (cpu_sample_t *sample)
+{
+	unsigned long long head;
+
+	if (sample == NULL)
+		return -EINVAL;
+	if (g_history == NULL)
+		return -1;
+	head = __atomic_load_n(&g_history_head, __ATOMIC_ACQUIRE);
+	if (head == 0)
+		return -1;
+	/* the newest slot is only rewritten after a full lap, so one retry is plenty */
+	if (history_read(head - 1, sample) < 0)
+		return history_read(__atomic_load_n(&g_history_head, __ATOMIC_ACQUIRE) - 1, sample);
+	return 0;
+}
+
+static float history_field(const cpu_sample_t *sample, int field)
+{
+	switch (field)
+	{
+		case HISTORY_CPU_US: return sample->usage.cpu_us;
+		case HISTORY_CPU_SY: return sample->usage.cpu_sy;
+		case HISTORY_CPU_NI: return sample->usage.cpu_ni;
+		case HISTORY_CPU_ID: return sample->usage.cpu_id;
+		case HISTORY_CPU_WA: return sample->usage.cpu_wa;
+		case HISTORY_CPU_HI: return sample->usage.cpu_hi;
+		case HISTORY_CPU_SI: return sample->usage.cpu_si;
+		case HISTORY_CPU_ST: return sample->usage.cpu_st;
+		case HISTORY_CPU_TOTAL: return sample->usage.cpu_total;
+		case HISTORY_LOAD_1MIN: return sample->load.cpu_load_1min;
+		case HISTORY_LOAD_5MIN: return sample->load.cpu_load_5min;
+		default: return sample->load.cpu_load_15min;
+	}
+}
+
+/*************************************************
+Function: history_walk
+Description: visit the samples of the last window_ms, newest first, straight
+	from the ring; slots overwritten during the walk are skipped
+Calls: 
+	static int history_read(unsigned long long idx, cpu_sample_t *sample)
+Input: 
+	int field---HISTORY_* value to extract
+	int window_ms---window length ending at the newest sample, 0 means the whole ring
+	float values[]---if not NULL, receives every value
+	int cap---room of values[], the walk stops once it is full
+Output: history_stat_t *stat---count, min, max, mean and time range
+Return: how many samples were visited
+*************************************************/
+static int history_walk(int field, int window_ms, float values[], int cap, history_stat_t *stat)
+{
+	unsigned long long head = __atomic_load_n(&g_history_head, __ATOMIC_ACQUIRE);
+	unsigned long long idx;
+	unsigned long long oldest = head > g_history_mask + 1ULL ? head - g_history_mask - 1 : 0;
+	unsigned long long since = 0;
+	double sum = 0;
+	cpu_sample_t sample;
+	int n = 0;
+
+	memset(stat, 0, sizeof(*stat));
+	for (idx = head; idx > oldest; idx--)
+	{
+		float v;
+
+		if (history_read(idx - 1, &sample) < 0)
+			continue;
+		if (n == 0)
+		{
+			stat->last_ts = sample.ts;
+			if (window_ms > 0 && sample.ts > (unsigned long long)window_ms * 1000000ULL)
+				since = sample.ts - (unsigned long long)window_ms * 1000000ULL;
+		}
+		if (sample.ts < since || sample.ts > stat->last_ts)
+			break; /* out of the window, or the ring lapped us */
+		if (values != NULL && n == cap)
+			break;
+		v = history_field(&sample, field);
+		if (n == 0 || v < stat->min)
+			stat->min = v;
+		if (n == 0 || v > stat->max)
+			stat->max = v;
+		sum += v;
+		stat->first_ts = sample.ts;
+		if (values != NULL)
+			values[n] = v;
+		n++;
+	}
+	stat->count = n;
+	if (n > 0)
+		stat->mean = (float)(sum / n);
+	return n;
+}
+
+/*************************************************
+Function: select_nth
+Description: quickselect, put the k-th smallest of v[0..n-1] at v[k]
+Input: float v[], int n, int k
+Output: 
+Return: the k-th smallest value
+*************************************************/
+static float select_nth(float v[], int n, int k)
+{
+	int lo = 0;
+	int hi = n - 1;
+
+	while (lo < hi)
+	{
+		float pivot = v[(lo + hi) / 2];
+		int i = lo;
+		int j = hi;
+
+		while (i <= j)
+		{
+			float t;
+
+			while (v[i] < pivot)
+				i++;
+			while (v[j] > pivot)
+				j--;
+			if (i <= j)
+			{
+				t = v[i];
+				v[i] = v[j];
+				v[j] = t;
+				i++;
+				j--;
+			}
+		}
+		if (k <= j)
+			hi = j;
+		else if (k >= i)
+			lo = i;
+		else
+			break;
+	}
+	return v[k];
+}
+
+static float nearest_rank(float v[], int n, float pct)
+{
+	int k = (int)(pct / 100 * n + 0.999999f) - 1;
+
+	if (k < 0)
+		k = 0;
+	if (k >= n)
+		k = n - 1;
+	return select_nth(v, n, k);
+}
+
+/*************************************************
+Function: history_gather
+Description: collect the values of one field over the last window_ms into an
+	array sized to the window: the window is counted first, then walked
+	again into the array, samples the sampler added meanwhile are left out
+	if there is no room
+Calls: 
+	static int history_walk(int field, int window_ms, float values[], int cap, history_stat_t *stat)
+Input: 
+	int field---HISTORY_* value
+	int window_ms---window length ending at the newest sample, 0 means the whole ring
+Output: 
+	float **values---malloc'ed, newest first, the caller frees it
+	history_stat_t *stat---count, min, max, mean and time range
+Return: 
+	>=0 values gathered
+	-ENOMEM out of memory
+*************************************************/
+static int history_gather(int field, int window_ms, float **values, history_stat_t *stat)
+{
+	int cap;
+
+	/* a few samples of slack for ticks that land between the 2 walks */
+	cap = history_walk(field, window_ms, NULL, 0, stat) + 4;
+	*values = malloc(sizeof(values[0][0]) * cap);
+	if (*values == NULL)
+		return -ENOMEM;
+	return history_walk(field, window_ms, *values, cap, stat);
+}
+
+/*************************************************
+Function: sys_check_cpu_history_stat
+Description: give count/min/max/mean/p50/p95/p99 of one field over the last
+	window_ms of the history ring. Min, max and mean are read straight from
+	the ring; only the window's values of the one field are gathered for the
+	percentiles. Safe to call from any thread while the sampler writes.
+Calls: 
+	static int history_gather(int field, int window_ms, float **values, history_stat_t *stat)
+Input: 
+	int field---HISTORY_* value
+	int window_ms---window length ending at the newest sample, 0 means the whole ring
+Output: history_stat_t *stat
+Return: 
+	>=0 samples in the window
+	<0  function run error
+*************************************************/
+int sys_check_cpu_history_stat (int field, int window_ms, history_stat_t *stat)
+{
+	float *values;
+	int n;
+
+	if (stat == NULL || field < 0 || field >= HISTORY_FIELD_MAX || window_ms < 0)
+		return -EINVAL;
+	if (g_history == NULL)
+		return -1;
+
+	n = history_gather(field, window_ms, &values, stat);
+	if (n < 0)
+		return n;
+	if (n > 0)
+	{
+		stat->p50 = nearest_rank(values, n, 50);
+		stat->p95 = nearest_rank(values, n, 95);
+		stat->p99 = nearest_rank(values, n, 99);
+	}
+	free(values);
+	return n;
+}
+
+/*************************************************
+Function: sys_check_cpu_history_percentile
+Description: give any percentile of one field over the last window_ms
+Calls: 
+	static int history_gather(int field, int window_ms, float **values, history_stat_t *stat)
+Input: 
+	int field---HISTORY_* value
+	int window_ms---window length ending at the newest sample, 0 means the whole ring
+	float pct---percentile, 0 to 100
+Output: float *value
+Return: 
+	>0  samples in the window
+	0   no sample in the window, *value is untouched
+	<0  function run error
+*************************************************/
+int sys_check_cpu_history_percentile (int field, int window_ms, float pct, float *value)
+{
+	history_stat_t stat;
+	float *values;
+	int n;
+
+	if (value == NULL || field < 0 || field >= HISTORY_FIELD_MAX || window_ms < 0
+		|| pct < 0 || pct > 100)
+		return -EINVAL;
+	if (g_history == NULL)
+		return -1;
+
+	n = history_gather(field, window_ms, &values, &stat);
+	if (n < 0)
+		return n;
+	if (n > 0)
+		*value = nearest_rank(values, n, pct);
+	free(values);
+	return n;
+}
+
+/*************************************************
+Function: get_basename
+Description: filter string to get a base name
+Input: progress's abs path
+Output: progress's base name
+*************************************************/
+char *get_basename(const char *path)
+{
+    register const char *s;
+    register const char *pp;
+
+    pp = s = path;
+
+    while (*s) 
+    {
+        if (*s++ == '/') 
+        {
+            pp = s;
+        }
+    }
+
+    return (char *) pp;
+}
+
+/*************************************************
+Function: parse_pid_name
+Description: take the Name: line of a /proc/pid/status content
+Input: const char *buf---content of /proc/pid/status, the first line is enough
+Output: char *name---progress's name, at most size - 1 chars
+Return:
+	0   function run success
+	-1  content has no name
+*************************************************/
+static int parse_pid_name(const char *buf, char *name, int size)
+{
+    const char *p;
+    int i;
+
+    if (strncmp(buf, "Name:", 5) != 0)//find Name: from line
+        return -1;
+
+    p = skip_blank(buf + 5);
+    for (i = 0; i < size - 1 && p[i] != '\n' && p[i] != '\0'; i++)
+        name[i] = p[i];
+    name[i] = '\0';
+    return 0;
+}
+
+/*************************************************
+Function: read_pid_name
+Description: read the Name: line of /proc/pid/status
+Calls: 
+	static int proc_read(int *fd, const char *name, char *buf, int size)
+	static int parse_pid_name(const char *buf, char *name, int size)
+Input: pid_t pid---progress pid
+Output: char *name---progress's name, at most size - 1 chars
+Return:
+	0   function run success
+	-1  progress is gone or has no name
+*************************************************/
+static int read_pid_name(pid_t pid, char *name, int size)
+{
+    char buf[PID_NAME_BUF_SIZE];
+    char path[32];
+
+    snprintf(path, sizeof(path), "%u/status", pid);//change from cmdline
+    if (proc_read(NULL, path, buf, sizeof(buf)) < 0)
+        return -1;
+    return parse_pid_name(buf, name, size);
+}
+
+static unsigned pid_name_hash(const char *name)
+{
+	unsigned h = 2166136261u; /* FNV-1a */
+
+	while (*name)
+	{
+		h ^= (unsigned char)*name++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static int pid_cmp(const void *a, const void *b)
+{
+	pid_t x = *(const pid_t *)a;
+	pid_t y = *(const pid_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*************************************************
+Function: pid_index_rehash
+Description: rebuild the name hash of g_pid_index, every bucket chain
+	is kept in ascending pid order
+Input: 
+Output: 
+Return:
+	0   function run success
+	-ENOMEM  out of memory
+*************************************************/
+static int pid_index_rehash(void)
+{
+	unsigned want = 64;
+	unsigned b;
+	int i;
+
+	while (want < (unsigned)g_pid_index_num * 2)
+		want <<= 1;
+	if (want != g_pid_bucket_num)
+	{
+		int *bucket = realloc(g_pid_bucket, sizeof(bucket[0]) * want);
+		if (bucket == NULL)
+			return -ENOMEM;
+		g_pid_bucket = bucket;
+		g_pid_bucket_num = want;
+	}
+	for (b = 0; b < g_pid_bucket_num; b++)
+		g_pid_bucket[b] = -1;
+	for (i = g_pid_index_num - 1; i >= 0; i--)
+	{
+		b = pid_name_hash(g_pid_index[i].name) & (g_pid_bucket_num - 1);
+		g_pid_index[i].next = g_pid_bucket[b];
+		g_pid_bucket[b] = i;
+	}
+	return 0;
+}
+
+static int parse_pidstat_buf(const char *buf, unsigned long long pid_cpu_stat[PID_STAT_MAX]);
+static void parse_pidstat_name(const char *buf, char *name, int size);
+
+/* proc_batch_fn of pid_index_refresh, a stat that was read makes its entry alive; scan workers call it at once */
+static int pid_index_named(void *arg, int i, const char *buf, int len)
+{
+	pid_index_entry_t *e = (pid_index_entry_t *)arg + g_pid_need_idx[i];
+	unsigned long long pid_stat[PID_STAT_MAX];
+
+	(void)len;
+	if (buf == NULL || parse_pidstat_buf(buf, pid_stat) < 0)
+		return 0;
+	parse_pidstat_name(buf, e->name, sizeof(e->name));
+	e->start_time = pid_stat[START_TIME];
+	e->pid_alive = 1;
+	return 0;
+}
+
+/*************************************************
+Function: pid_index_refresh
+Description: bring the name->pid index up to date with /proc, only pid
+	directories that are not indexed yet get their stat read, pids that
+	disappeared or were pruned are dropped. A pid seen for the first time is
+	read once more on the next refresh, so a child caught between fork() and
+	exec() does not keep its parent's name. A reused pid or a later exec()
+	is caught by pid_index_check when a lookup matches the entry. The stat
+	files of one refresh are read in a batch (through io_uring if enabled)
+	and split across the scan workers if sys_check_cpu_set_scan_workers
+	started some. Caller must hold g_pid_index_lock.
+Calls: 
+	static int proc_list(const char *dir, pid_t **ids, int *size)
+	static int proc_scan(int kind, proc_batch_t *serial, const pid_t ids[], int num, proc_batch_fn fn, void *arg)
+	static int pid_index_rehash(void)
+Input: 
+Output: 
+Return:
+	0   function run success
+	<0  function run error
+*************************************************/
+static int pid_index_refresh(void)
+{
+	int scan_num;
+	int need_num = 0;
+	int i = 0;
+	int j = 0;
+	int n = 0;
+	int k;
+	int ret;
+	pid_index_entry_t *fresh;
+
+	scan_num = proc_list("", &g_pid_scan, &g_pid_scan_size);
+	if (scan_num < 0)
+		return scan_num == -ENOENT ? -EIO : scan_num;
+	qsort(g_pid_scan, scan_num, sizeof(g_pid_scan[0]), pid_cmp);
+
+	if (scan_num > g_pid_spare_size)
+	{
+		fresh = realloc(g_pid_spare, sizeof(fresh[0]) * scan_num);
+		if (fresh == NULL)
+			return -ENOMEM;
+		g_pid_spare = fresh;
+		g_pid_spare_size = scan_num;
+	}
+	if (scan_num > g_pid_need_size)
+	{
+		pid_t *need = realloc(g_pid_need, sizeof(need[0]) * scan_num);
+		int *idx;
+
+		if (need == NULL)
+			return -ENOMEM;
+		g_pid_need = need;
+		idx = realloc(g_pid_need_idx, sizeof(idx[0]) * scan_num);
+		if (idx == NULL)
+			return -ENOMEM;
+		g_pid_need_idx = idx;
+		g_pid_need_size = scan_num;
+	}
+	fresh = g_pid_spare;
+
+	/* both lists are sorted by pid, merge them; stats to read wait as not alive */
+	while (j < scan_num)
+	{
+		pid_t pid = g_pid_scan[j++];
+
+		while (i < g_pid_index_num && g_pid_index[i].pid < pid)
+			i++;
+		if (i < g_pid_index_num && g_pid_index[i].pid == pid && g_pid_index[i].pid_alive)
+		{
+			fresh[n] = g_pid_index[i];
+			if (fresh[n].verified)
+			{
+				n++;
+				continue;
+			}
+			fresh[n].verified = 1;
+		}
+		else
+		{
+			fresh[n].pid = pid;
+			fresh[n].verified = 0;
+		}
+		fresh[n].pid_alive = 0;
+		g_pid_need[need_num] = pid;
+		g_pid_need_idx[need_num++] = n++;
+	}
+
+	if (g_pid_batch.file == NULL)
+		proc_batch_init(&g_pid_batch, "stat", PID_STAT_BUF_SIZE, 0);
+	ret = proc_scan(SCAN_INDEX, &g_pid_batch, g_pid_need, need_num, pid_index_named, fresh);
+	if (ret < 0)
+		return ret;
+	for (k = 0, i = 0; i < n; i++)
+	{
+		if (fresh[i].pid_alive)
+			fresh[k++] = fresh[i];
+	}
+	n = k;
+
+	g_pid_spare = g_pid_index;
+	g_pid_spare_size = g_pid_index_size;
+	g_pid_index = fresh;
+	g_pid_index_size = scan_num;
+	g_pid_index_num = n;
+	return pid_index_rehash();
+}
+
+/*************************************************
+Function: pid_index_prune
+Description: mark a pid dead after reading its /proc files failed, it stops
+	matching lookups and is dropped at the next refresh
+Input: pid_t pid---progress pid
+Output: 
+*************************************************/
+static void pid_index_prune(pid_t pid)
+{
+	int lo = 0;
+	int hi;
+
+	pthread_mutex_lock(&g_pid_index_lock);
+	hi = g_pid_index_num - 1;
+	while (lo <= hi)
+	{
+		int mid = (lo + hi) / 2;
+
+		if (g_pid_index[mid].pid == pid)
+		{
+			g_pid_index[mid].pid_alive = 0;
+			break;
+		}
+		if (g_pid_index[mid].pid < pid)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	pthread_mutex_unlock(&g_pid_index_lock);
+}
+
+/*************************************************
+Function: procev_cmp
+Description: order index changes by pid, then by arrival
+*************************************************/
+static int procev_cmp(const void *a, const void *b)
+{
+	const procev_change_t *x = a;
+	const procev_change_t *y = b;
+
+	if (x->pid != y->pid)
+		return (x->pid > y->pid) - (x->pid < y->pid);
+	return x->seq - y->seq;
+}
+
+/*************************************************
+Function: pid_index_apply
+Description: merge a batch of process events into the name->pid index, the
+	same sorted merge pid_index_refresh does but without reading /proc.
+	Caller must hold g_pid_index_lock.
+Calls: 
+	static int pid_index_rehash(void)
+Input: 
+	procev_change_t chg[]---changes in arrival order, sorted here
+	int num---how many changes
+Output: 
+Return:
+	0   function run success
+	-ENOMEM  out of memory
+*************************************************/
+static int pid_index_apply(procev_change_t chg[], int num)
+{
+	pid_index_entry_t *fresh;
+	int need = g_pid_index_num + num;
+	int i = 0;
+	int j = 0;
+	int n = 0;
+
+	if (num == 0)
+		return 0;
+	qsort(chg, num, sizeof(chg[0]), procev_cmp);
+	if (need > g_pid_spare_size)
+	{
+		fresh = realloc(g_pid_spare, sizeof(fresh[0]) * need);
+		if (fresh == NULL)
+			return -ENOMEM;
+		g_pid_spare = fresh;
+		g_pid_spare_size = need;
+	}
+	fresh = g_pid_spare;
+
+	while (i < g_pid_index_num || j < num)
+	{
+		pid_t pid;
+
+		if (j >= num || (i < g_pid_index_num && g_pid_index[i].pid < chg[j].pid))
+		{
+			if (g_pid_index[i].pid_alive)
+				fresh[n++] = g_pid_index[i];
+			i++;
+			continue;
+		}
+		pid = chg[j].pid;
+		while (j + 1 < num && chg[j + 1].pid == pid)
+			j++;
+		if (i < g_pid_index_num && g_pid_index[i].pid == pid)
+			i++;
+		if (chg[j].alive)
+		{
+			fresh[n].pid = pid;
+			fresh[n].pid_alive = 1;
+			fresh[n].verified = 1; /* a later exec or comm change comes as an event too */
+			fresh[n].start_time = 0;
+			memcpy(fresh[n].name, chg[j].name, sizeof(chg[j].name));
+			n++;
+		}
+		j++;
+	}
+
+	g_pid_spare = g_pid_index;
+	g_pid_spare_size = g_pid_index_size;
+	g_pid_index = fresh;
+	g_pid_index_size = need;
+	g_pid_index_num = n;
+	return pid_index_rehash();
+}
+
+/*************************************************
+Function: procev_decode
+Description: turn one proc connector event into an index change, thread
+	events are ignored since the index only holds processes
+Calls: 
+	static int read_pid_name(pid_t pid, char *name, int size)
+Input: const struct proc_event *ev
+Output: procev_change_t *chg
+Return:
+	1   chg is filled
+	0   event does not change the index
+*************************************************/
+static int procev_decode(const struct proc_event *ev, procev_change_t *chg)
+{
+	memset(chg, 0, sizeof(*chg));
+	switch (ev->what)
+	{
+	case PROC_EVENT_FORK:
+		if (ev->event_data.fork.child_pid != ev->event_data.fork.child_tgid)
+			return 0;
+		chg->pid = ev->event_data.fork.child_tgid;
+		chg->alive = 1;
+		/* comm is the parent's until exec, which is an event of its own */
+		return read_pid_name(chg->pid, chg->name, sizeof(chg->name)) == 0;
+	case PROC_EVENT_EXEC:
+		chg->pid = ev->event_data.exec.process_tgid;
+		chg->alive = 1;
+		return read_pid_name(chg->pid, chg->name, sizeof(chg->name)) == 0;
+	case PROC_EVENT_COMM:
+		if (ev->event_data.comm.process_pid != ev->event_data.comm.process_tgid)
+			return 0;
+		chg->pid = ev->event_data.comm.process_tgid;
+		chg->alive = 1;
+		memcpy(chg->name, ev->event_data.comm.comm, sizeof(chg->name) - 1);
+		return 1;
+	case PROC_EVENT_EXIT:
+		if (ev->event_data.exit.process_pid != ev->event_data.exit.process_tgid)
+			return 0;
+		chg->pid = ev->event_data.exit.process_tgid;
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/*************************************************
+Function: procev_thread
+Description: drain proc connector events and merge them into the name->pid
+	index batch by batch. Lost events (socket overrun) trigger one full
+	/proc rescan; a broken socket hands the index back to the scanning path.
+Input: void *arg---unused
+Output: 
+Return: NULL
+*************************************************/
+static void *procev_thread(void *arg)
+{
+	char buf[4096] __attribute__((aligned(NLMSG_ALIGNTO)));
+	procev_change_t chg[PROCEV_BATCH_SIZE];
+	struct pollfd pfd[2];
+	struct nlmsghdr *nlh;
+	int num;
+	int resync;
+	int broken = 0;
+	ssize_t len;
+
+	(void)arg;
+	while (!broken)
+	{
+		pfd[0].fd = g_procev_sock;
+		pfd[0].events = POLLIN;
+		pfd[1].fd = g_procev_pipe[0];
+		pfd[1].events = POLLIN;
+		if (poll(pfd, 2, -1) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (pfd[1].revents)
+			break; /* stop */
+
+		num = 0;
+		resync = 0;
+		while (num < PROCEV_BATCH_SIZE)
+		{
+			len = recv(g_procev_sock, buf, sizeof(buf), MSG_DONTWAIT);
+			if (len < 0)
+			{
+				if (errno == ENOBUFS)
+				{
+					resync = 1; /* kernel dropped events */
+					continue;
+				}
+				if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+					broken = 1;
+				break;
+			}
+			for (nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len))
+			{
+				struct cn_msg *cn = NLMSG_DATA(nlh);
+
+				if (nlh->nlmsg_type == NLMSG_NOOP)
+					continue;
+				if (nlh->nlmsg_type == NLMSG_ERROR || nlh->nlmsg_type == NLMSG_OVERRUN)
+				{
+					resync = 1;
+					continue;
+				}
+				if (cn->id.idx != CN_IDX_PROC || cn->id.val != CN_VAL_PROC)
+					continue;
+				if (num >= PROCEV_BATCH_SIZE)
+				{
+					resync = 1;
+					continue;
+				}
+				if (procev_decode((const struct proc_event *)cn->data, &chg[num]))
+				{
+					chg[num].seq = num;
+					num++;
+				}
+			}
+		}
+
+		pthread_mutex_lock(&g_pid_index_lock);
+		if (broken)
+			g_procev_live = 0;
+		else if (resync)
+			pid_index_refresh(); /* newer than anything in chg[] */
+		else if (pid_index_apply(chg, num) < 0)
+			pid_index_refresh();
+		pthread_mutex_unlock(&g_pid_index_lock);
+	}
+	if (broken)
+		printf("proc connector socket failed, name lookups scan /proc again\n");
+	return NULL;
+}
+
+/*************************************************
+Function: procev_listen
+Description: tell the proc connector to start or stop sending events
+Input: 
+	int sock---NETLINK_CONNECTOR socket
+	int op---PROC_CN_MCAST_LISTEN or PROC_CN_MCAST_IGNORE
+Output: 
+Return:
+	0   function run success
+	-1  function run error
+*************************************************/
+static int procev_listen(int sock, int op)
+{
+	char buf[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(int))] __attribute__((aligned(NLMSG_ALIGNTO)));
+	struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+	struct cn_msg *cn = NLMSG_DATA(nlh);
+
+	memset(buf, 0, sizeof(buf));
+	nlh->nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(int));
+	nlh->nlmsg_type = NLMSG_DONE;
+	nlh->nlmsg_pid = getpid();
+	cn->id.idx = CN_IDX_PROC;
+	cn->id.val = CN_VAL_PROC;
+	cn->len = sizeof(int);
+	memcpy(cn->data, &op, sizeof(int));
+	return send(sock, buf, nlh->nlmsg_len, 0) < 0 ? -1 : 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_procev_start
+Description: subscribe to the netlink proc connector (fork, exec, comm, exit)
+	and keep the name->pid index current from its events, lookups and
+	is_process_exist then never touch /proc. Needs CAP_NET_ADMIN; without it
+	nothing changes and lookups keep scanning /proc.
+Calls: 
+	static int procev_listen(int sock, int op)
+	static int pid_index_refresh(void)
+Input: 
+Output: 
+Return:
+	0   function run success
+	-EBUSY  already running
+	-EPERM  proc connector not available or procfs is not the kernel's own, scanning is used
+	-1  function run error
+*************************************************/
+int sys_check_cpu_procev_start (void)
+{
+	struct sockaddr_nl addr;
+	int rcvbuf = PROCEV_RCVBUF_SIZE;
+	int sock;
+	int ret;
+
+	pthread_mutex_lock(&g_procev_lock);
+	if (g_procev_running)
+	{
+		pthread_mutex_unlock(&g_procev_lock);
+		return -EBUSY;
+	}
+	if (!g_proc_host)
+	{
+		printf("proc connector only reports the kernel's own pids, name lookups keep scanning %s\n",
+			g_proc_root);
+		pthread_mutex_unlock(&g_procev_lock);
+		return -EPERM;
+	}
+
+	sock = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = CN_IDX_PROC;
+	if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0
+		|| procev_listen(sock, PROC_CN_MCAST_LISTEN) < 0)
+	{
+		printf("proc connector is not available because:%s, name lookups keep scanning /proc\n",
+			strerror(errno));
+		if (sock >= 0)
+			close(sock);
+		pthread_mutex_unlock(&g_procev_lock);
+		return -EPERM;
+	}
+	setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+	if (pipe(g_procev_pipe) < 0)
+	{
+		close(sock);
+		pthread_mutex_unlock(&g_procev_lock);
+		return -1;
+	}
+	fcntl(g_procev_pipe[0], F_SETFD, FD_CLOEXEC);
+	fcntl(g_procev_pipe[1], F_SETFD, FD_CLOEXEC);
+	g_procev_sock = sock;
+
+	/* subscribed first, so nothing between this scan and the first event is lost */
+	pthread_mutex_lock(&g_pid_index_lock);
+	ret = pid_index_refresh();
+	if (ret == 0)
+		g_procev_live = 1;
+	pthread_mutex_unlock(&g_pid_index_lock);
+
+	if (ret < 0 || pthread_create(&g_procev_tid, NULL, procev_thread, NULL) != 0)
+	{
+		printf("can't start process event thread\n");
+		pthread_mutex_lock(&g_pid_index_lock);
+		g_procev_live = 0;
+		pthread_mutex_unlock(&g_pid_index_lock);
+		close(g_procev_pipe[0]);
+		close(g_procev_pipe[1]);
+		close(sock);
+		g_procev_sock = -1;
+		pthread_mutex_unlock(&g_procev_lock);
+		return -1;
+	}
+	g_procev_running = 1;
+	pthread_mutex_unlock(&g_procev_lock);
+	return 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_procev_stop
+Description: stop the process event engine, lookups scan /proc again
+Input: 
+Output: 
+Return:
+	0   function run success
+	-1  engine is not running
+*************************************************/
+int sys_check_cpu_procev_stop (void)
+{
+	pthread_mutex_lock(&g_procev_lock);
+	if (!g_procev_running)
+	{
+		pthread_mutex_unlock(&g_procev_lock);
+		return -1;
+	}
+	if (write(g_procev_pipe[1], "", 1) < 0)
+		printf("can't wake process event thread because:%s\n", strerror(errno));
+	pthread_join(g_procev_tid, NULL);
+
+	pthread_mutex_lock(&g_pid_index_lock);
+	g_procev_live = 0;
+	pthread_mutex_unlock(&g_pid_index_lock);
+
+	procev_listen(g_procev_sock, PROC_CN_MCAST_IGNORE);
+	close(g_procev_sock);
+	close(g_procev_pipe[0]);
+	close(g_procev_pipe[1]);
+	g_procev_sock = -1;
+	g_procev_running = 0;
+	pthread_mutex_unlock(&g_procev_lock);
+	return 0;
+}
+
+/*************************************************
+Function: pid_index_check
+Description: read the stat of an entry a lookup matched. A changed
+	START_TIME (the pid was reused) or comm (an exec() or a rename) replaces
+	the entry's name, a stat that can't be read prunes the entry. Caller
+	must hold g_pid_index_lock.
+Calls: 
+	static int proc_read(int *fd, const char *name, char *buf, int size)
+	static int parse_pidstat_buf(const char *buf, unsigned long long pid_cpu_stat[PID_STAT_MAX])
+	static void parse_pidstat_name(const char *buf, char *name, int size)
+Input: pid_index_entry_t *e---matched entry
+Output: pid_index_entry_t *e---start_time and name of the running process
+Return:
+	0   the entry kept its name
+	1   the name changed, the name hash must be rebuilt
+	-1  process is gone, the entry is pruned
+*************************************************/
+static int pid_index_check(pid_index_entry_t *e)
+{
+	char buf[PID_STAT_BUF_SIZE];
+	char path[32];
+	char comm[sizeof(e->name)];
+	unsigned long long pid_stat[PID_STAT_MAX];
+
+	snprintf(path, sizeof(path), "%u/stat", e->pid);
+	if (proc_read(NULL, path, buf, sizeof(buf)) < 0 || parse_pidstat_buf(buf, pid_stat) < 0)
+	{
+		e->pid_alive = 0;
+		return -1;
+	}
+	parse_pidstat_name(buf, comm, sizeof(comm));
+	if (e->start_time == pid_stat[START_TIME] && strcmp(e->name, comm) == 0)
+		return 0;
+	e->start_time = pid_stat[START_TIME];
+	if (strcmp(e->name, comm) == 0)
+		return 0;
+	memcpy(e->name, comm, sizeof(comm));
+	return 1;
+}
+
+/*************************************************
+Function: scan_pid_by_names
+Description: refresh the name->pid index once and collect the pids of every
+	process whose name matches one of names[]; while the process event
+	engine runs the index is already current and /proc is not touched.
+	Otherwise each match is checked by pid_index_check before it is returned
+Calls: 
+	static int pid_index_refresh(void)
+	static int pid_index_check(pid_index_entry_t *e)
+	static int pid_index_rehash(void)
+Input: 
+	const char *names[]---progress's names
+	int name_num---how many names in names[]
+	int list_size---size of pid_list[] and name_idx[]
+Output: 
+	pid_t pid_list[]---matched pids
+	int name_idx[]---index in names[] each matched pid belongs to, may be NULL
+Return: matched pid number, or negative errno
+*************************************************/
+static int scan_pid_by_names(const char *names[], int name_num, pid_t pid_list[], int name_idx[], int list_size)
+{
+	int count = 0;
+	int renamed = 0;
+	int i;
+	int k;
+	int ret;
+
+	pthread_mutex_lock(&g_pid_index_lock);
+	ret = g_procev_live ? 0 : pid_index_refresh();
+	if (ret < 0)
+	{
+		pthread_mutex_unlock(&g_pid_index_lock);
+		return ret;
+	}
+	for (i = 0; i < name_num && count < list_size; i++)
+	{
+		k = g_pid_bucket[pid_name_hash(names[i]) & (g_pid_bucket_num - 1)];
+		for (; k >= 0 && count < list_size; k = g_pid_index[k].next)
+		{
+			if (!g_pid_index[k].pid_alive || strcmp(g_pid_index[k].name, names[i]) != 0)
+				continue;
+			if (!g_procev_live)
+			{
+				ret = pid_index_check(&g_pid_index[k]);
+				if (ret < 0)
+					continue;
+				if (ret > 0)
+				{
+					renamed = 1; /* next stays valid, the chains are rebuilt below */
+					continue;
+				}
+			}
+			pid_list[count] = g_pid_index[k].pid;
+			if (name_idx != NULL)
+				name_idx[count] = i;
+			count++;
+		}
+	}
+	if (renamed)
+		pid_index_rehash();
+	pthread_mutex_unlock(&g_pid_index_lock);
+	return count;
+}
+
+/*************************************************
+Function: sys_check_cpu_lookup_pid
+Description: look up the pids of every process called name in the cached
+	name->pid index, the index is refreshed incrementally first
+Calls: 
+	char *get_basename(const char *path)
+	static int scan_pid_by_names(const char *names[], int name_num, pid_t pid_list[], int name_idx[], int list_size)
+Input: 
+	const char *name---progress's name, a path is reduced to its base name
+	int list_size---size of pid_list[]
+Output: pid_t pid_list[]---matched pids, ascending
+Return: matched pid number, or negative errno
+*************************************************/
+int sys_check_cpu_lookup_pid (const char *name, pid_t pid_list[], int list_size)
+{
+	const char *base_pname;
+
+	if (name == NULL || pid_list == NULL || list_size <= 0)
+		return -EINVAL;
+
+	base_pname = get_basename(name);
+	if (*base_pname == '\0')
+		return -EINVAL;
+
+	return scan_pid_by_names(&base_pname, 1, pid_list, NULL, list_size);
+}
+
+/*************************************************
+Function: get_pid_by_name
+Description: accord progress's name to get its pid
+Calls: 
+	int sys_check_cpu_lookup_pid (const char *name, pid_t pid_list[], int list_size)
+Input: progress's name
+Output: progress's  pid
+*************************************************/
+int get_pid_by_name(const char *process_name, pid_t pid_list[], int list_size)
+{
+    return sys_check_cpu_lookup_pid(process_name, pid_list, list_size);
+}
+
+/*************************************************
+Function: is_process_exist
+Description: check whether progress exist
+Calls: 
+	int get_pid_by_name(const char *process_name, pid_t pid_list[], int list_size)
+Input: const char *process_name---progress's name
+Output:
+return:
+	0---progress is exist
+	-1---progress is not exist
+*************************************************/
+int is_process_exist(const char *process_name)
+{
+    pid_t pid;
+
+    return (get_pid_by_name(process_name, &pid, 1) > 0);
+}
+
+/*************************************************
+Function: parse_pidstat_buf
+Description: parse the content of a /proc/pid/stat file into pid_cpu_stat[PID_STAT_MAX],
+	comm may contain blanks or ')' so fields are counted from its last ')'.
+	CMD_NAME and TASK_STAT are not numbers and stay 0.
+Input: const char *buf---content of /proc/pid/stat
+Output: unsigned long long pid_cpu_stat[PID_STAT_MAX]
+Return:
+	0   function run success
+	-1  content is malformed
+*************************************************/
+static int parse_pidstat_buf(const char *buf, unsigned long long pid_cpu_stat[PID_STAT_MAX])
+{
+    const char *p = buf;
+    int i;
+
+    memset(pid_cpu_stat, 0, sizeof(pid_cpu_stat[0]) * PID_STAT_MAX);
+    if (!parse_ull(&p, &pid_cpu_stat[PID]))
+        return -1;
+    p = strrchr(p, ')');
+    if (p == NULL)
+        return -1;
+    p = skip_blank(p + 1);
+    if (*p != '\0')
+        p++; /* one char task state */
+    for (i = PPID; i < PID_STAT_MAX; i++)
+    {
+        if (!parse_ull(&p, &pid_cpu_stat[i]))
+            break;
+    }
+    return 0;
+}
+
+/*************************************************
+Function: parse_pidstat_name
+Description: copy the comm field of a /proc/pid/stat content, the text
+	between the first '(' and the last ')'
+Input: 
+	const char *buf---content of /proc/pid/stat
+	int size---size of name
+Output: char *name---progress's name
+*************************************************/
+static void parse_pidstat_name(const char *buf, char *name, int size)
+{
+    const char *b = strchr(buf, '(');
+    const char *e = strrchr(buf, ')');
+    int i = 0;
+
+    if (b != NULL && e != NULL)
+    {
+        for (b++; b < e && i < size - 1; b++)
+            name[i++] = *b;
+    }
+    name[i] = '\0';
+}
+
+/*************************************************
+Function: parse_pidstat
+Description: open /proc/pid/stat, parse the content and store in pid_cpu_stat[PID_STAT_MAX]
+Calls: 
+	static int proc_read(int *fd, const char *name, char *buf, int size)
+	static int parse_pidstat_buf(const char *buf, unsigned long long pid_cpu_stat[PID_STAT_MAX])
+Input: progress pid
+Output: unsigned long long pid_cpu_stat[PID_STAT_MAX]
+Return:
+	0   function run success
+	-1  function run error
+*************************************************/
+static int parse_pidstat(pid_t pid, unsigned long long pid_cpu_stat[PID_STAT_MAX])
+{
+    char buf[PID_STAT_BUF_SIZE];
+    char path[32];
+
+    snprintf(path, sizeof(path), "%u/stat", pid);
+    if (proc_read(NULL, path, buf, sizeof(buf)) < 0
+        || parse_pidstat_buf(buf, pid_cpu_stat) < 0)
+    {
+        memset(pid_cpu_stat, 0, sizeof(pid_cpu_stat[0]) * PID_STAT_MAX);
+        pid_index_prune(pid);
+        return -1;
+    }
+    return 0;
+}
+
+/*************************************************
+Function: parse_schedstat
+Description: read the on-cpu time of a process, the sum of
+	/proc/pid/task/<tid>/schedstat over its threads. /proc/pid/schedstat
+	only covers the thread group leader. It is kept in nanoseconds so it is
+	exact at short intervals. Threads that exited are not in the sum, but
+	UTIME + STIME of /proc/pid/stat still counts them, so when that is
+	larger it is taken instead: the result never falls more than the two
+	ticks stat is rounded to behind the process's real total
+Calls: 
+	static int proc_list(const char *dir, pid_t **ids, int *size)
+	static int proc_read(int *fd, const char *name, char *buf, int size)
+	static int parse_pidstat(pid_t pid, unsigned long long pid_cpu_stat[PID_STAT_MAX])
+Input: 
+	cpu_ctx_t *ctx---not locked by caller, lends its tid buffer
+	pid_t pid---progress pid
+	const unsigned long long pid_stat[PID_STAT_MAX]---stat the caller already read, NULL to read it here
+Output: 
+	unsigned long long *run_ns---time spent on a cpu (unit: nanosecond)
+	unsigned long long *delay_ns---time spent waiting on a run queue of live threads, may be NULL
+Return:
+	0   function run success
+	-1  process is gone or has no schedstat
+*************************************************/
+static int parse_schedstat(cpu_ctx_t *ctx, pid_t pid, const unsigned long long pid_stat[PID_STAT_MAX],
+		unsigned long long *run_ns, unsigned long long *delay_ns)
+{
+	char buf[128];
+	char path[64];
+	const char *p;
+	unsigned long long own_stat[PID_STAT_MAX];
+	unsigned long long val;
+	unsigned long long delay;
+	int num;
+	int found = 0;
+	int i;
+
+	*run_ns = 0;
+	if (delay_ns != NULL)
+		*delay_ns = 0;
+	snprintf(path, sizeof(path), "%u/task", pid);
+	pthread_mutex_lock(&ctx->lock);
+	num = proc_list(path, &ctx->sched_tids, &ctx->sched_tids_size);
+	for (i = 0; i < num; i++)
+	{
+		snprintf(path, sizeof(path), "%u/task/%u/schedstat", pid, ctx->sched_tids[i]);
+		p = buf;
+		/* a thread that exited between list and read drops out */
+		if (proc_read(NULL, path, buf, sizeof(buf)) < 0 || !parse_ull(&p, &val))
+			continue;
+		*run_ns += val;
+		if (delay_ns != NULL && parse_ull(&p, &delay))
+			*delay_ns += delay;
+		found++;
+	}
+	pthread_mutex_unlock(&ctx->lock);
+	if (!found)
+		return -1;
+
+	if (pid_stat == NULL && parse_pidstat(pid, own_stat) == 0)
+		pid_stat = own_stat;
+	if (pid_stat != NULL)
+	{
+		val = (pid_stat[UTIME] + pid_stat[STIME]) * (1000000000ULL / sysconf(_SC_CLK_TCK));
+		if (val > *run_ns)
+			*run_ns = val; /* threads that exited ran longer than the ticks lost to rounding */
+	}
+	return 0;
+}
+
+/*************************************************
+Function: genl_request
+Description: send one generic netlink request carrying a single attribute and
+	receive its reply
+Input: 
+	int sock---NETLINK_GENERIC socket
+	int family---genetlink family id
+	int cmd---family command
+	int attr---attribute type
+	const void *data---attribute payload
+	int len---payload size
+	int size---size of reply
+Output: char *reply---the reply message
+Return:
+	>0  bytes of attributes after the genetlink header, they start at
+	    reply + NLMSG_HDRLEN + GENL_HDRLEN
+	<0  negative errno of the kernel, or -1
+*************************************************/
+static int genl_request(int sock, int family, int cmd, int attr, const void *data, int len,
+		char *reply, int size)
+{
+	char buf[NLMSG_SPACE(GENL_HDRLEN + NLA_HDRLEN + 64)] __attribute__((aligned(NLMSG_ALIGNTO)));
+	struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+	struct genlmsghdr *genl = NLMSG_DATA(nlh);
+	struct nlattr *nla = (struct nlattr *)((char *)genl + GENL_HDRLEN);
+	ssize_t n;
+
+	if (len > 64)
+		return -EINVAL;
+	memset(buf, 0, sizeof(buf));
+	nla->nla_type = attr;
+	nla->nla_len = NLA_HDRLEN + len;
+	memcpy((char *)nla + NLA_HDRLEN, data, len);
+	nlh->nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN + NLA_ALIGN(nla->nla_len));
+	nlh->nlmsg_type = family;
+	nlh->nlmsg_flags = NLM_F_REQUEST;
+	genl->cmd = cmd;
+	genl->version = 1;
+	if (send(sock, buf, nlh->nlmsg_len, 0) < 0)
+		return -1;
+
+	do
+		n = recv(sock, reply, size, 0);
+	while (n < 0 && errno == EINTR);
+	nlh = (struct nlmsghdr *)reply;
+	if (n < 0 || !NLMSG_OK(nlh, n))
+		return -1;
+	if (nlh->nlmsg_type == NLMSG_ERROR)
+	{
+		struct nlmsgerr *err = NLMSG_DATA(nlh);
+		return err->error ? err->error : -1;
+	}
+	return (int)nlh->nlmsg_len - NLMSG_HDRLEN - GENL_HDRLEN;
+}
+
+/*************************************************
+Function: nla_find
+Description: find an attribute in a run of netlink attributes
+Input: 
+	const char *p---first attribute
+	int len---bytes of attributes
+	int type---attribute type to find
+Return: the attribute, NULL if missing
+*************************************************/
+static const struct nlattr *nla_find(const char *p, int len, int type)
+{
+	const struct nlattr *nla;
+
+	while (len >= NLA_HDRLEN)
+	{
+		nla = (const struct nlattr *)p;
+		if (nla->nla_len < NLA_HDRLEN || nla->nla_len > len)
+			return NULL;
+		if ((nla->nla_type & NLA_TYPE_MASK) == type)
+			return nla;
+		len -= NLA_ALIGN(nla->nla_len);
+		p += NLA_ALIGN(nla->nla_len);
+	}
+	return NULL;
+}
+
+/*************************************************
+Function: taskstats_query
+Description: fetch the binary taskstats of a whole process (all its threads
+	added together) in one netlink round trip, no text is parsed.
+	Caller holds ctx->lock.
+Calls: 
+	static int genl_request(int sock, int family, int cmd, int attr, const void *data, int len,
+		char *reply, int size)
+	static const struct nlattr *nla_find(const char *p, int len, int type)
+Input: 
+	cpu_ctx_t *ctx---context with the taskstats backend
+	pid_t pid---process id (tgid)
+Output: struct taskstats *ts---fields the running kernel does not know stay 0
+Return:
+	0   function run success
+	-1  process is gone or the request failed
+*************************************************/
+static int taskstats_query(cpu_ctx_t *ctx, pid_t pid, struct taskstats *ts)
+{
+	char reply[1024] __attribute__((aligned(NLMSG_ALIGNTO)));
+	const char *attrs = reply + NLMSG_HDRLEN + GENL_HDRLEN;
+	const struct nlattr *aggr;
+	const struct nlattr *stats;
+	unsigned int tgid = pid;
+	int len;
+
+	memset(ts, 0, sizeof(*ts));
+	len = genl_request(ctx->ts_sock, ctx->ts_family, TASKSTATS_CMD_GET, TASKSTATS_CMD_ATTR_TGID,
+			&tgid, sizeof(tgid), reply, sizeof(reply));
+	if (len <= 0)
+		return -1;
+	aggr = nla_find(attrs, len, TASKSTATS_TYPE_AGGR_TGID);
+	if (aggr == NULL)
+		return -1;
+	stats = nla_find((const char *)aggr + NLA_HDRLEN, aggr->nla_len - NLA_HDRLEN, TASKSTATS_TYPE_STATS);
+	if (stats == NULL)
+		return -1;
+	len = stats->nla_len - NLA_HDRLEN;
+	memcpy(ts, (const char *)stats + NLA_HDRLEN, len < (int)sizeof(*ts) ? len : (int)sizeof(*ts));
+	return 0;
+}
+
+/*************************************************
+Function: pid_time_mode
+Description: pick how process cpu time is read on a context, caller holds ctx->lock
+Input: cpu_ctx_t *ctx
+Return: PID_TIME_JIFFY, PID_TIME_SCHEDSTAT or PID_TIME_TASKSTATS
+*************************************************/
+static int pid_time_mode(cpu_ctx_t *ctx)
+{
+	/* taskstats answers for the kernel's own pids only */
+	if (ctx->backend == PROC_BACKEND_TASKSTATS && g_proc_host)
+		return PID_TIME_TASKSTATS;
+	return ctx->precise ? PID_TIME_SCHEDSTAT : PID_TIME_JIFFY;
+}
+
+/*************************************************
+Function: read_pid_cputime
+Description: cpu time of a process, jiffies from /proc/pid/stat, or
+	nanoseconds from the threads' schedstat or taskstats. Schedstat mode
+	falls back to /proc/pid/stat jiffies turned into nanoseconds
+Calls: 
+	static int parse_pidstat(pid_t pid, unsigned long long pid_cpu_stat[PID_STAT_MAX])
+	static int parse_schedstat(cpu_ctx_t *ctx, pid_t pid, const unsigned long long pid_stat[PID_STAT_MAX],
+		unsigned long long *run_ns, unsigned long long *delay_ns)
+	static int taskstats_query(cpu_ctx_t *ctx, pid_t pid, struct taskstats *ts)
+Input: 
+	cpu_ctx_t *ctx---not locked by caller
+	int mode---PID_TIME_JIFFY, PID_TIME_SCHEDSTAT or PID_TIME_TASKSTATS
+	pid_t pid
+Output: unsigned long long *val---UTIME + STIME, or run time in ns
+Return:
+	0   function run success
+	-1  function run error
+*************************************************/
+static int read_pid_cputime(cpu_ctx_t *ctx, int mode, pid_t pid, unsigned long long *val)
+{
+	unsigned long long pid_stat[PID_STAT_MAX];
+	struct taskstats ts;
+	int ret;
+
+	if (mode == PID_TIME_SCHEDSTAT && parse_schedstat(ctx, pid, NULL, val, NULL) == 0)
+		return 0;
+	if (mode == PID_TIME_TASKSTATS)
+	{
+		pthread_mutex_lock(&ctx->lock);
+		ret = taskstats_query(ctx, pid, &ts);
+		pthread_mutex_unlock(&ctx->lock);
+		*val = ret < 0 ? 0 : ts.cpu_run_real_total;
+		if (ret < 0)
+			pid_index_prune(pid);
+		return ret;
+	}
+	if (parse_pidstat(pid, pid_stat) < 0)
+	{
+		*val = 0;
+		return -1;
+	}
+	*val = pid_stat[UTIME] + pid_stat[STIME];
+	/* no schedstat (trace without task files, CONFIG_SCHED_INFO off): jiffies in ns */
+	if (mode == PID_TIME_SCHEDSTAT)
+		*val *= 1000000000ULL / sysconf(_SC_CLK_TCK);
+	return 0;
+}
+
+/* a cpu time delta in nanoseconds, jiffies are USER_HZ ticks */
+static unsigned long long cputime_ns(int precise, unsigned long long pid_diff)
+{
+	if (precise)
+		return pid_diff;
+	return pid_diff * (1000000000ULL / sysconf(_SC_CLK_TCK));
+}
+
+/*************************************************
+Function: cputime_usage
+Description: turn a process's cpu time delta into usage precent of one cpu,
+	against the wall time elapsed between the 2 samples. Jiffies are
+	USER_HZ ticks of sysconf(_SC_CLK_TCK); no cpu time is a true 0
+Calls: 
+	static unsigned long long cputime_ns(int precise, unsigned long long pid_diff)
+Input: 
+	int precise---pid_diff is nanoseconds of schedstat or taskstats
+	unsigned long long pid_diff---cpu time delta of the process
+	unsigned long long wall_ns---delta of the samples' proc_clock() stamps
+Return: usage precent, 100 is one cpu fully busy
+*************************************************/
+static float cputime_usage(int precise, unsigned long long pid_diff, unsigned long long wall_ns)
+{
+	if (pid_diff == 0 || wall_ns == 0)
+		return 0;
+	return (float)(100.0 * (double)cputime_ns(precise, pid_diff) / (double)wall_ns);
+}
+
+static void snap_free(snap_t *snap);
+
+/*************************************************
+Function: sys_check_cpu_ctx_create
+Description: create a context that owns its own descriptors, buffers and
+	baselines, so threads with their own contexts never share state
+Input: 
+Output: 
+Return: new context, NULL when out of memory
+*************************************************/
+cpu_ctx_t *sys_check_cpu_ctx_create (void)
+{
+	cpu_ctx_t *ctx = calloc(1, sizeof(*ctx));
+	int i;
+
+	if (ctx == NULL)
+		return NULL;
+	pthread_mutex_init(&ctx->lock, NULL);
+	ctx->stat_fd = -1;
+	ctx->loadavg_fd = -1;
+	for (i = 0; i < PSI_RESOURCE_MAX; i++)
+		ctx->psi_fd[i] = -1;
+	ctx->ts_sock = -1;
+	ctx->online_fd = -1;
+	ctx->cpuset_fd = -1;
+	return ctx;
+}
+
+/*************************************************
+Function: sys_check_cpu_ctx_destroy
+Description: close and free everything a context owns
+Input: cpu_ctx_t *ctx---context from sys_check_cpu_ctx_create, may be NULL
+Output: 
+*************************************************/
+void sys_check_cpu_ctx_destroy (cpu_ctx_t *ctx)
+{
+	int i;
+
+	if (ctx == NULL || ctx == &g_default_ctx)
+		return;
+	if (ctx->stat_fd >= 0)
+		close(ctx->stat_fd);
+	if (ctx->loadavg_fd >= 0)
+		close(ctx->loadavg_fd);
+	for (i = 0; i < PSI_RESOURCE_MAX; i++)
+		if (ctx->psi_fd[i] >= 0)
+			close(ctx->psi_fd[i]);
+	if (ctx->ts_sock >= 0)
+		close(ctx->ts_sock);
+	if (ctx->online_fd >= 0)
+		close(ctx->online_fd);
+	if (ctx->cpuset_fd >= 0)
+		close(ctx->cpuset_fd);
+	free(ctx->cpu_jif);
+	free(ctx->prev_cpu_jif);
+	free(ctx->cpu_online);
+	snap_free(ctx->snap);
+	free(ctx->threads.entry);
+	free(ctx->threads.ids);
+	free(ctx->sched_tids);
+	pthread_mutex_destroy(&ctx->lock);
+	free(ctx);
+}
+
+/*************************************************
+Function: sys_check_cpu_ctx_sample
+Description: read /proc/stat once into ctx, the usage between this sample and
+	the previous one is then given by sys_check_cpu_ctx_usage and
+	sys_check_cpu_ctx_usage_percpu; the first sample reports the average since boot
+Calls: 
+	static int ctx_sample(cpu_ctx_t *ctx)
+Input: cpu_ctx_t *ctx---caller's context
+Output: 
+Return: 
+	0   function run success
+	-1  function run error
+*************************************************/
+int sys_check_cpu_ctx_sample (cpu_ctx_t *ctx)
+{
+	int ret;
+
+	if (ctx == NULL)
+		return -EINVAL;
+	pthread_mutex_lock(&ctx->lock);
+	ret = ctx_sample(ctx);
+	pthread_mutex_unlock(&ctx->lock);
+	return ret;
+}
+
+/*************************************************
+Function: sys_check_cpu_ctx_usage
+Description: give the cpu's usage precent between the last 2 samples of ctx
+Input: cpu_ctx_t *ctx---caller's context, sampled by sys_check_cpu_ctx_sample
+Output: cpu_usage_t *usage---usage precent of every field
+Return: 
+	0   function run success
+	-EINVAL bad argument
+*************************************************/
+int sys_check_cpu_ctx_usage (cpu_ctx_t *ctx, cpu_usage_t *usage)
+{
+	if (ctx == NULL || usage == NULL)
+		return -EINVAL;
+	pthread_mutex_lock(&ctx->lock);
+	*usage = ctx->cur_cpu_usage;
+	pthread_mutex_unlock(&ctx->lock);
+	return 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_ctx_sched
+Description: check cpu's idle precent
+Calls: static void parse_loadavg(cpu_ctx_t *ctx, float cpuloadavg[CPU_LOADAVG_MAX])
+Input: 
+	cpu_ctx_t *ctx---caller's context
+	float *load  used to save current cpu's idle precent
+Output: current cpu's idle precent
+Return:
+	0   function run success
+	-1  function run error
+*************************************************/
+int sys_check_cpu_ctx_sched (cpu_ctx_t *ctx, float *load)
+{
+	int ret;
+	if (ctx == NULL || load == NULL)
+        return -EINVAL;
+
+	float cpuloadavg[CPU_LOADAVG_MAX];
+	pthread_mutex_lock(&ctx->lock);
+	ret = parse_loadavg(ctx, cpuloadavg);
+	if (ret == 0)
+		*load = ctx->cur_cpuload.cpu_load_15min;
+	pthread_mutex_unlock(&ctx->lock);
+	if (ret < 0 )
+		return -1;
+	
+	//printf("cpuloadavg[CPU_LOADAVG_1MINS]=%lu cpuloadavg[CPU_LOADAVG_5MINS]=%lu cpuloadavg[CPU_LOADAVG_15MINS]=%lu\n",
+			//cpuloadavg[CPU_LOADAVG_1MINS],cpuloadavg[CPU_LOADAVG_5MINS],cpuloadavg[CPU_LOADAVG_15MINS]);
+	return 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_sched
+Description: check cpu's idle precent
+Calls: int sys_check_cpu_ctx_sched (cpu_ctx_t *ctx, float *load)
+Input: float *load  used to save current cpu's idle precent
+Output: current cpu's idle precent
+Return:
+	0   function run success
+	-1  function run error
+*************************************************/
+int sys_check_cpu_sched (float *load)
+{
+	return sys_check_cpu_ctx_sched(&g_default_ctx, load);
+}
+
+/*************************************************
+Function: sys_check_cpu_ctx_load
+Description: read /proc/loadavg once and give all of it
+Calls: static int parse_loadavg(cpu_ctx_t *ctx, float cpuloadavg[CPU_LOADAVG_MAX])
+Input: cpu_ctx_t *ctx---caller's context
+Output: proc_load_t *load---1/5/15 minute load, runnable and total tasks, last pid
+Return:
+	0   function run success
+	-1  function run error
+*************************************************/
+int sys_check_cpu_ctx_load (cpu_ctx_t *ctx, proc_load_t *load)
+{
+	float cpuloadavg[CPU_LOADAVG_MAX];
+	int ret;
+
+	if (ctx == NULL || load == NULL)
+		return -EINVAL;
+	pthread_mutex_lock(&ctx->lock);
+	ret = parse_loadavg(ctx, cpuloadavg);
+	if (ret == 0)
+		*load = ctx->cur_cpuload;
+	pthread_mutex_unlock(&ctx->lock);
+	return ret < 0 ? -1 : 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_load
+Description: read /proc/loadavg once and give all of it
+Calls: int sys_check_cpu_ctx_load (cpu_ctx_t *ctx, proc_load_t *load)
+Input: 
+Output: proc_load_t *load---1/5/15 minute load, runnable and total tasks, last pid
+Return:
+	0   function run success
+	-1  function run error
+*************************************************/
+int sys_check_cpu_load (proc_load_t *load)
+{
+	return sys_check_cpu_ctx_load(&g_default_ctx, load);
+}
+
+/*************************************************
+Function: sys_check_cpu_usage_all
+Description: check every field of cpu's usage precent (usr, sys, nice, idle,
+	iowait, irq, softirq, steal, guest, guest nice and busy) at once
+Calls: 
+	static int get_jiffy_counts(cpu_ctx_t *ctx, jiffy_counts_t *jif)
+	static void calc_cpu_usage(const jiffy_counts_t *local_pjif, const jiffy_counts_t *local_prev_pjif, cpu_usage_t *usage)
+Input: 
+Output: cpu_usage_t *usage---from the sampler's latest delta if it runs,
+	otherwise from 2 /proc/stat reads 300ms apart
+Return:
+	0   function run success
+	-1  function run error
+*************************************************/
+int sys_check_cpu_usage_all (cpu_usage_t *usage)
+{
+	int ret;
+	jiffy_counts_t prev_jif; /* local samples, so concurrent callers don't mix their baselines */
+	jiffy_counts_t cur_jif;
+	
+	if (usage == NULL)
+        return -EINVAL;
+
+	pthread_mutex_lock(&g_sampler_lock);
+	if (g_sampler_running)
+	{
+		/* sampler keeps the delta fresh, no need to sleep here */
+		pthread_mutex_lock(&g_default_ctx.lock);
+		*usage = g_default_ctx.cur_cpu_usage;
+		pthread_mutex_unlock(&g_default_ctx.lock);
+		pthread_mutex_unlock(&g_sampler_lock);
+		return 0;
+	}
+	pthread_mutex_unlock(&g_sampler_lock);
+
+	pthread_mutex_lock(&g_default_ctx.lock);
+	ret = get_jiffy_counts(&g_default_ctx, &prev_jif);
+	pthread_mutex_unlock(&g_default_ctx.lock);
+	if (ret < 0)
+		return -1;
+	proc_wait(300000);
+	pthread_mutex_lock(&g_default_ctx.lock);
+	ret = get_jiffy_counts(&g_default_ctx, &cur_jif);
+	pthread_mutex_unlock(&g_default_ctx.lock);
+	if (ret < 0)
+		return -1;
+	calc_cpu_usage(&cur_jif, &prev_jif, usage);
+	return 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_usage
+Description: check cpu's usage precent
+Calls: 
+	int sys_check_cpu_usage_all (cpu_usage_t *usage)
+Input: float *idle  used to save current cpu's usage precent
+Output: current cpu's usage precent
+Return:
+	0   function run success
+	-1  function run error
+*************************************************/
+int sys_check_cpu_usage (float *kernel, float *user)
+{
+	cpu_usage_t usage;
+	
+	if (kernel == NULL || user == NULL)
+        return -EINVAL;
+
+	if (sys_check_cpu_usage_all(&usage) < 0)
+		return -1;
+	*kernel = usage.cpu_sy;
+	*user = usage.cpu_us;
+	return 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_ctx_usage_percpu
+Description: give every cpu core's usage precent between the last 2 samples of ctx
+Calls: 
+	static void calc_cpu_usage(const jiffy_counts_t *local_pjif, const jiffy_counts_t *local_prev_pjif, cpu_usage_t *usage)
+Input: 
+	cpu_ctx_t *ctx---caller's context, sampled by sys_check_cpu_ctx_sample
+	int size---size of usage[]
+Output: cpu_usage_t usage[]---usage[n] is cpuN, an offline cpu reads 0 in every field
+Return:
+	>=0 highest cpu id + 1, only the first size of them are filled
+	<0  function run error
+*************************************************/
+int sys_check_cpu_ctx_usage_percpu (cpu_ctx_t *ctx, cpu_usage_t usage[], int size)
+{
+	int n;
+
+	if (ctx == NULL || usage == NULL || size <= 0)
+		return -EINVAL;
+
+	pthread_mutex_lock(&ctx->lock);
+	for (n = 0; n < ctx->num_cpus && n < size; n++)
+		calc_cpu_usage(&ctx->cpu_jif[n], &ctx->prev_cpu_jif[n], &usage[n]);
+	n = ctx->num_cpus;
+	pthread_mutex_unlock(&ctx->lock);
+	return n;
+}
+
+/*************************************************
+Function: sys_check_cpu_usage_percpu
+Description: check every cpu core's usage precent, per-core jiffies are
+	differenced against the previous /proc/stat read (the sampler's when it runs,
+	otherwise the previous call's; the first call reports the average since boot)
+Calls: 
+	int sys_check_cpu_ctx_sample (cpu_ctx_t *ctx)
+	int sys_check_cpu_ctx_usage_percpu (cpu_ctx_t *ctx, cpu_usage_t usage[], int size)
+Input: int size---size of usage[]
+Output: cpu_usage_t usage[]---usage[n] is cpuN, an offline cpu reads 0 in every field
+Return:
+	>=0 highest cpu id + 1, only the first size of them are filled
+	<0  function run error
+*************************************************/
+int sys_check_cpu_usage_percpu (cpu_usage_t usage[], int size)
+{
+	int running;
+
+	if (usage == NULL || size <= 0)
+		return -EINVAL;
+
+	pthread_mutex_lock(&g_sampler_lock);
+	running = g_sampler_running;
+	pthread_mutex_unlock(&g_sampler_lock);
+	if (!running && sys_check_cpu_ctx_sample(&g_default_ctx) < 0)
+		return -1;
+
+	return sys_check_cpu_ctx_usage_percpu(&g_default_ctx, usage, size);
+}
+
+/*************************************************
+Function: sys_check_cpu_ctx_topology
+Description: give the cpus a context may use: online cpus, the calling
+	process's affinity and its cgroup's cpuset. The sets are read again
+	at most once per CPU_TOPO_RECHECK, or at once when a sample of the
+	context saw a core come or go; compare topo->gen to notice a change
+Calls: 
+	static int topo_refresh(cpu_ctx_t *ctx)
+Input: cpu_ctx_t *ctx---caller's context
+Output: cpu_topo_t *topo
+Return:
+	0   function run success
+	-EINVAL bad argument
+	-1  function run error
+*************************************************/
+int sys_check_cpu_ctx_topology (cpu_ctx_t *ctx, cpu_topo_t *topo)
+{
+	int ret;
+
+	if (ctx == NULL || topo == NULL)
+		return -EINVAL;
+	pthread_mutex_lock(&ctx->lock);
+	ret = topo_refresh(ctx);
+	*topo = ctx->topo;
+	pthread_mutex_unlock(&ctx->lock);
+	return ret;
+}
+
+/*************************************************
+Function: sys_check_cpu_topology
+Description: sys_check_cpu_ctx_topology on the default context
+Calls: 
+	int sys_check_cpu_ctx_topology (cpu_ctx_t *ctx, cpu_topo_t *topo)
+Input: 
+Output: cpu_topo_t *topo
+Return: see sys_check_cpu_ctx_topology
+*************************************************/
+int sys_check_cpu_topology (cpu_topo_t *topo)
+{
+	return sys_check_cpu_ctx_topology(&g_default_ctx, topo);
+}
+
+/*************************************************
+Function: sys_check_cpu_ctx_process_measure
+Description: check a process's cpu usage precent against the wall time that
+	really passed between its 2 samples. Each sample is tagged with
+	CLOCK_MONOTONIC and CLOCK_BOOTTIME when its /proc/pid file was read,
+	so a sleep that overran under load or a late read doesn't skew the
+	result, and a process that used no cpu reads a true 0
+Calls: 
+	int get_pid_by_name(const char *process_name, pid_t pid_list[], int list_size)
+	static int read_pid_cputime(cpu_ctx_t *ctx, int mode, pid_t pid, unsigned long long *val)
+	static void sample_stamp(sample_time_t *st, unsigned long long begin)
+	static float cputime_usage(int precise, unsigned long long pid_diff, unsigned long long wall_ns)
+	static int topo_refresh(cpu_ctx_t *ctx)
+Input: 
+	cpu_ctx_t *ctx---caller's context, not locked during the sleep
+	const char *name---process's name, the first pid found is measured
+	int interval---time interval between 2 take sample(unit:microsecond),
+	 0 means DEFAULT_SAMPLE_INTERVAL, not bigger than MAX_SAMPLE_INTERVAL
+Output: proc_measure_t *measure---usage, cpu and wall time, read times and
+	scan time of both samples, usage normalized by the available cpus
+Return: 
+	0   function run success
+	-EINVAL bad argument
+	-1  function run error or the process is gone
+*************************************************/
+int sys_check_cpu_ctx_process_measure (cpu_ctx_t *ctx, const char *name, int interval, proc_measure_t *measure)
+{
+	pid_t pid[MAX_PID_NUM];
+	int mode;
+	int ret;
+	long long overrun;
+	unsigned long long begin;
+	unsigned long long prev_pid_total; /* jiffies, or ns in schedstat/taskstats mode */
+	unsigned long long pid_total;
+	unsigned long long pid_diff;
+
+	if (ctx == NULL || name == NULL || measure == NULL)
+		return -EINVAL;
+	if ((interval < 0) || (interval > MAX_SAMPLE_INTERVAL))
+	{
+		printf("sample interval time argument is illegal\n");
+		return -EINVAL;
+	}
+	if (interval == 0)
+		interval = DEFAULT_SAMPLE_INTERVAL;
+
+	ret = get_pid_by_name(name, pid, MAX_PID_NUM);
+	if (ret < 1)
+	{
+		printf("process '%s' is not exist!\n",name);
+		return -1;
+	}
+
+	pthread_mutex_lock(&ctx->lock);
+	mode = pid_time_mode(ctx);
+	pthread_mutex_unlock(&ctx->lock);
+
+	memset(measure, 0, sizeof(*measure));
+	measure->pid = pid[0];
+	begin = proc_clock();
+	if (read_pid_cputime(ctx, mode, pid[0], &prev_pid_total) < 0)
+		return -1;
+	sample_stamp(&measure->start, begin);
+
+	proc_wait(interval);
+
+	begin = proc_clock();
+	if (read_pid_cputime(ctx, mode, pid[0], &pid_total) < 0)
+		return -1;
+	sample_stamp(&measure->end, begin);
+
+	pid_diff = pid_total > prev_pid_total ? pid_total - prev_pid_total : 0;
+	measure->wall_ns = measure->end.mono_ns - measure->start.mono_ns;
+	measure->cpu_ns = cputime_ns(mode != PID_TIME_JIFFY, pid_diff);
+	measure->usage = cputime_usage(mode != PID_TIME_JIFFY, pid_diff, measure->wall_ns);
+	overrun = (long long)(measure->wall_ns / 1000) - interval;
+	measure->overrun_us = overrun > 0 ? (int)overrun : 0;
+
+	pthread_mutex_lock(&ctx->lock);
+	ret = topo_refresh(ctx);
+	measure->cpus = ctx->topo.available;
+	pthread_mutex_unlock(&ctx->lock);
+	if (ret < 0)
+		return -1;
+	measure->norm_usage = measure->usage / measure->cpus;
+	return 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_process_measure
+Description: sys_check_cpu_ctx_process_measure on the default context
+Calls: 
+	int sys_check_cpu_ctx_process_measure (cpu_ctx_t *ctx, const char *name, int interval, proc_measure_t *measure)
+Input: 
+	const char *name---process's name
+	int interval---0 means DEFAULT_SAMPLE_INTERVAL
+Output: proc_measure_t *measure
+Return: see sys_check_cpu_ctx_process_measure
+*************************************************/
+int sys_check_cpu_process_measure (const char *name, int interval, proc_measure_t *measure)
+{
+	return sys_check_cpu_ctx_process_measure(&g_default_ctx, name, interval, measure);
+}
+
+/*************************************************
+Function: sys_check_cpu_ctx_process
+Description: check a progress take how many cpu's usage precent
+Calls: 
+	int sys_check_cpu_ctx_process_measure (cpu_ctx_t *ctx, const char *name, int interval, proc_measure_t *measure)
+Input: 
+	cpu_ctx_t *ctx---caller's context, not locked during the sleep;
+	 with sys_check_cpu_ctx_set_precise intervals of 100ms are accurate
+	const char *name---process抯 name	
+	int interval---time interval between 2 take sample(unit:a millisecond),
+	 default is 1200000(1.2 second) if you set interval = 0, you can change it as you wish,
+	 but not bigger than 5000000.
+Unit for millisecond
+Output: float *usage---cpu usage precent of individual process
+Return: 
+	0   function run success
+	-1  function run error
+*************************************************/
+int sys_check_cpu_ctx_process (cpu_ctx_t *ctx, const char *name, float *usage, int interval)
+{
+	proc_measure_t measure;
+
+	if (ctx == NULL || name == NULL || usage == NULL)
+        return -EINVAL;
+
+	if (sys_check_cpu_ctx_process_measure(ctx, name, interval, &measure) < 0)
+		return -1;
+	*usage = measure.usage;
+	return 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_process
+Description: check a progress take how many cpu's usage precent
+Calls: 
+	int sys_check_cpu_ctx_process (cpu_ctx_t *ctx, const char *name, float *usage, int interval)
+Input: 
+	char *name---process's name
+	int interval---time interval between 2 take sample(unit:microsecond),
+	 0 means DEFAULT_SAMPLE_INTERVAL, not bigger than MAX_SAMPLE_INTERVAL
+Output: float *usage---cpu usage precent of individual process
+Return: 
+	0   function run success
+	-1  function run error
+*************************************************/
+int sys_check_cpu_process (char *name, float *usage, int interval)
+{
+	return sys_check_cpu_ctx_process(&g_default_ctx, name, usage, interval);
+}
+
+/* square root by Newton's method, the library does not link libm */
+static double adaptive_sqrt(double x)
+{
+	double r = x > 1 ? x : 1;
+	int i;
+
+	if (x <= 0)
+		return 0;
+	for (i = 0; i < 64; i++)
+	{
+		double next = (r + x / r) / 2;
+
+		if (next >= r)
+			break;
+		r = next;
+	}
+	return r;
+}
+
+/*************************************************
+Function: adaptive_quantum
+Description: how far rounding can move a usage measured over a window: one
+	jiffy of /proc/pid/stat, or in precise mode the time a running task's
+	schedstat may lag behind. The window itself is wall time and not rounded
+Input: 
+	int mode---PID_TIME_JIFFY, PID_TIME_SCHEDSTAT or PID_TIME_TASKSTATS
+	unsigned long long wall_ns---elapsed time of the window
+Return: usage precent
+*************************************************/
+static double adaptive_quantum(int mode, unsigned long long wall_ns)
+{
+	if (wall_ns == 0)
+		wall_ns = 1;
+	if (mode != PID_TIME_JIFFY)
+		return 100.0 * ADAPTIVE_SCHED_TICK_NS / (double)wall_ns;
+	return 100.0 * cputime_ns(0, 1) / (double)wall_ns;
+}
+
+/*************************************************
+Function: sys_check_cpu_ctx_process_adaptive
+Description: check a process's cpu usage precent with a window that is only as
+	long as the reading needs. Sub-samples are taken every ADAPTIVE_STEP; the
+	estimate is the usage over the whole window, its error bound adds the
+	spread of the sub-samples (2 standard errors, with the spread jiffy
+	rounding alone would cause taken out) and the rounding of the 2 window
+	ends. A steady process stops after ADAPTIVE_MIN_SAMPLES sub-samples once
+	the bound is within tolerance, a noisy or jiffy-rounded one keeps
+	sampling up to max_interval.
+Calls: 
+	int get_pid_by_name(const char *process_name, pid_t pid_list[], int list_size)
+	static int read_pid_cputime(cpu_ctx_t *ctx, int mode, pid_t pid, unsigned long long *val)
+	static void sample_stamp(sample_time_t *st, unsigned long long begin)
+	static double adaptive_quantum(int mode, unsigned long long wall_ns)
+Input: 
+	cpu_ctx_t *ctx---caller's context, not locked during the sleeps
+	const char *name---process's name, the first pid found is measured
+	float tolerance---error bound to reach (unit:precent), 0 means ADAPTIVE_DEFAULT_TOLERANCE
+	int max_interval---longest window (unit:microsecond), 0 means MAX_SAMPLE_INTERVAL,
+	 not bigger than MAX_SAMPLE_INTERVAL
+Output: proc_estimate_t *est---usage, error bound, window and sub-samples taken
+Return: 
+	0   function run success, est->error is within tolerance
+	1   max_interval was reached first, est->error is the bound achieved
+	-EINVAL bad argument
+	-1  function run error or the process is gone
+*************************************************/
+int sys_check_cpu_ctx_process_adaptive (cpu_ctx_t *ctx, const char *name, float tolerance, int max_interval,
+	proc_estimate_t *est)
+{
+	pid_t pid[MAX_PID_NUM];
+	int mode;
+	int ret;
+	int elapsed = 0;
+	sample_time_t st;
+	unsigned long long start_ns;
+	unsigned long long first_pid, first_ref; /* window start */
+	unsigned long long prev_pid, prev_ref; /* sub-sample start */
+	unsigned long long pid_total, ref;
+	double sum = 0; /* of sub-sample usages */
+	double sum_sq = 0;
+	double rounding = 0; /* summed variance jiffy rounding adds to sub-samples */
+	double var;
+	double q;
+
+	if (ctx == NULL || name == NULL || est == NULL || tolerance < 0)
+		return -EINVAL;
+	if ((max_interval < 0) || (max_interval > MAX_SAMPLE_INTERVAL))
+	{
+		printf("sample interval time argument is illegal\n");
+		return -EINVAL;
+	}
+	if (tolerance == 0)
+		tolerance = ADAPTIVE_DEFAULT_TOLERANCE;
+	if (max_interval == 0)
+		max_interval = MAX_SAMPLE_INTERVAL;
+
+	ret = get_pid_by_name(name, pid, MAX_PID_NUM);
+	if (ret < 1)
+	{
+		printf("process '%s' is not exist!\n",name);
+		return -1;
+	}
+
+	pthread_mutex_lock(&ctx->lock);
+	mode = pid_time_mode(ctx);
+	pthread_mutex_unlock(&ctx->lock);
+
+	memset(est, 0, sizeof(*est));
+	est->pid = pid[0];
+	start_ns = proc_clock();
+	if (read_pid_cputime(ctx, mode, pid[0], &first_pid) < 0)
+		return -1;
+	sample_stamp(&st, start_ns);
+	first_ref = st.mono_ns;
+	prev_pid = first_pid;
+	prev_ref = first_ref;
+
+	while (1)
+	{
+		double u;
+
+		proc_wait(ADAPTIVE_STEP);
+		elapsed += ADAPTIVE_STEP;
+		ref = proc_clock();
+		if (read_pid_cputime(ctx, mode, pid[0], &pid_total) < 0)
+			return -1;
+		sample_stamp(&st, ref);
+		ref = st.mono_ns;
+
+		/* the schedstat sum may fall by up to two stat ticks when a thread exits */
+		if (pid_total < prev_pid)
+			pid_total = prev_pid;
+		u = cputime_usage(mode != PID_TIME_JIFFY, pid_total - prev_pid, ref - prev_ref);
+		q = adaptive_quantum(mode, ref - prev_ref);
+		sum += u;
+		sum_sq += u * u;
+		/* both ends of a sub-sample are rounded down by up to q, evenly: variance q*q/6 */
+		rounding += q * q / 6;
+		est->samples++;
+		prev_pid = pid_total;
+		prev_ref = ref;
+
+		est->usage = cputime_usage(mode != PID_TIME_JIFFY, pid_total - first_pid, ref - first_ref);
+		var = 0;
+		if (est->samples > 1)
+			var = (sum_sq - sum * sum / est->samples) / (est->samples - 1) - rounding / est->samples;
+		est->error = (float)(2 * adaptive_sqrt(var / est->samples)
+			+ adaptive_quantum(mode, ref - first_ref));
+		if (est->samples >= ADAPTIVE_MIN_SAMPLES && est->error <= tolerance)
+			break;
+		if (elapsed + ADAPTIVE_STEP > max_interval)
+			break;
+	}
+	est->interval = (int)((proc_clock() - start_ns) / 1000);
+	return est->error <= tolerance ? 0 : 1;
+}
+
+/*************************************************
+Function: sys_check_cpu_process_adaptive
+Description: sys_check_cpu_ctx_process_adaptive on the default context
+Calls: 
+	int sys_check_cpu_ctx_process_adaptive (cpu_ctx_t *ctx, const char *name, float tolerance, int max_interval,
+		proc_estimate_t *est)
+Input: 
+	const char *name---process's name
+	float tolerance---error bound to reach (unit:precent), 0 means ADAPTIVE_DEFAULT_TOLERANCE
+	int max_interval---longest window (unit:microsecond), 0 means MAX_SAMPLE_INTERVAL
+Output: proc_estimate_t *est
+Return: 
+	0   function run success, est->error is within tolerance
+	1   max_interval was reached first
+	<0  function run error
+*************************************************/
+int sys_check_cpu_process_adaptive (const char *name, float tolerance, int max_interval, proc_estimate_t *est)
+{
+	return sys_check_cpu_ctx_process_adaptive(&g_default_ctx, name, tolerance, max_interval, est);
+}
+
+/*************************************************
+Function: sys_check_cpu_ctx_set_precise
+Description: switch the per-process usage of a context between jiffies
+	(USER_HZ, 10ms steps) and the schedstat nanoseconds of its threads divided
+	by CLOCK_MONOTONIC, the latter stays accurate at 100ms intervals
+Calls: 
+	static int parse_schedstat(cpu_ctx_t *ctx, pid_t pid, const unsigned long long pid_stat[PID_STAT_MAX],
+		unsigned long long *run_ns, unsigned long long *delay_ns)
+Input: 
+	cpu_ctx_t *ctx---caller's context
+	int enable---1 precise, 0 jiffies
+Output: 
+Return: 
+	0   function run success
+	-EINVAL bad argument
+	-ENOENT kernel has no schedstat (CONFIG_SCHED_INFO off), mode unchanged
+*************************************************/
+int sys_check_cpu_ctx_set_precise (cpu_ctx_t *ctx, int enable)
+{
+	unsigned long long run_ns;
+
+	if (ctx == NULL)
+		return -EINVAL;
+	if (enable && parse_schedstat(ctx, getpid(), NULL, &run_ns, NULL) < 0)
+	{
+		printf("/proc/<pid>/task/<tid>/schedstat is not supported\n");
+		return -ENOENT;
+	}
+	pthread_mutex_lock(&ctx->lock);
+	ctx->precise = enable ? 1 : 0;
+	pthread_mutex_unlock(&ctx->lock);
+	return 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_set_precise
+Description: sys_check_cpu_ctx_set_precise on the default context
+Calls: 
+	int sys_check_cpu_ctx_set_precise (cpu_ctx_t *ctx, int enable)
+Input: int enable---1 precise, 0 jiffies
+Output: 
+Return: see sys_check_cpu_ctx_set_precise
+*************************************************/
+int sys_check_cpu_set_precise (int enable)
+{
+	return sys_check_cpu_ctx_set_precise(&g_default_ctx, enable);
+}
+
+/*************************************************
+Function: sys_check_cpu_ctx_set_backend
+Description: select where the per-process functions of a context get cpu
+	time from, meant to be called once after sys_check_cpu_ctx_create.
+	PROC_BACKEND_TASKSTATS asks the kernel for binary taskstats over one
+	generic netlink socket instead of opening and parsing /proc/<pid> files,
+	and measures in nanoseconds against CLOCK_MONOTONIC. The kernel fills
+	cpu_run_real_total of a process only with delay accounting on
+	(kernel.task_delayacct, off by default since 5.14), so the backend is
+	refused unless the time of this process grows while it burns a few
+	milliseconds of cpu.
+Calls: 
+	static int genl_request(int sock, int family, int cmd, int attr, const void *data, int len,
+		char *reply, int size)
+	static unsigned long long monotonic_ns(void)
+	static int taskstats_query(cpu_ctx_t *ctx, pid_t pid, struct taskstats *ts)
+Input: 
+	cpu_ctx_t *ctx---caller's context
+	int backend---PROC_BACKEND_PROCFS or PROC_BACKEND_TASKSTATS
+Output: 
+Return: 
+	0   function run success
+	-EINVAL bad argument
+	-ENOENT kernel has no taskstats, backend unchanged
+	-EPERM  no CAP_NET_ADMIN, backend unchanged
+	-EOPNOTSUPP delay accounting is off, backend unchanged
+	-1  function run error
+*************************************************/
+int sys_check_cpu_ctx_set_backend (cpu_ctx_t *ctx, int backend)
+{
+	char reply[1024] __attribute__((aligned(NLMSG_ALIGNTO)));
+	const struct nlattr *nla;
+	struct sockaddr_nl addr;
+	struct taskstats ts;
+	struct taskstats burnt;
+	unsigned long long end;
+	int sock;
+	int len;
+
+	if (ctx == NULL || (backend != PROC_BACKEND_PROCFS && backend != PROC_BACKEND_TASKSTATS))
+		return -EINVAL;
+
+	pthread_mutex_lock(&ctx->lock);
+	if (backend == PROC_BACKEND_PROCFS || ctx->ts_sock >= 0)
+	{
+		ctx->backend = backend;
+		pthread_mutex_unlock(&ctx->lock);
+		return 0;
+	}
+
+	sock = socket(PF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+	{
+		printf("can't open generic netlink because:%s\n", strerror(errno));
+		if (sock >= 0)
+			close(sock);
+		pthread_mutex_unlock(&ctx->lock);
+		return -1;
+	}
+	len = genl_request(sock, GENL_ID_CTRL, CTRL_CMD_GETFAMILY, CTRL_ATTR_FAMILY_NAME,
+			TASKSTATS_GENL_NAME, sizeof(TASKSTATS_GENL_NAME), reply, sizeof(reply));
+	nla = len > 0 ? nla_find(reply + NLMSG_HDRLEN + GENL_HDRLEN, len, CTRL_ATTR_FAMILY_ID) : NULL;
+	if (nla == NULL)
+	{
+		printf("taskstats is not supported, keep the procfs backend\n");
+		close(sock);
+		pthread_mutex_unlock(&ctx->lock);
+		return -ENOENT;
+	}
+	ctx->ts_sock = sock;
+	ctx->ts_family = *(const unsigned short *)((const char *)nla + NLA_HDRLEN);
+
+	/* TASKSTATS_CMD_GET is an admin command, find out now rather than at the first measure */
+	if (taskstats_query(ctx, getpid(), &ts) < 0)
+	{
+		printf("taskstats query is not permitted, keep the procfs backend\n");
+		close(sock);
+		ctx->ts_sock = -1;
+		pthread_mutex_unlock(&ctx->lock);
+		return -EPERM;
+	}
+	/* without delay accounting the reply comes back with cpu_run_real_total stuck at 0 */
+	end = monotonic_ns() + 2000000;
+	while (monotonic_ns() < end)
+		;
+	if (taskstats_query(ctx, getpid(), &burnt) < 0 || burnt.cpu_run_real_total <= ts.cpu_run_real_total)
+	{
+		printf("task delay accounting is off (kernel.task_delayacct), keep the procfs backend\n");
+		close(sock);
+		ctx->ts_sock = -1;
+		pthread_mutex_unlock(&ctx->lock);
+		return -EOPNOTSUPP;
+	}
+	ctx->backend = backend;
+	pthread_mutex_unlock(&ctx->lock);
+	return 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_set_backend
+Description: sys_check_cpu_ctx_set_backend on the default context
+Calls: 
+	int sys_check_cpu_ctx_set_backend (cpu_ctx_t *ctx, int backend)
+Input: int backend---PROC_BACKEND_PROCFS or PROC_BACKEND_TASKSTATS
+Output: 
+Return: see sys_check_cpu_ctx_set_backend
+*************************************************/
+int sys_check_cpu_set_backend (int backend)
+{
+	return sys_check_cpu_ctx_set_backend(&g_default_ctx, backend);
+}
+
+/*************************************************
+Function: read_pid_switches
+Description: read the context switch counters of /proc/pid/status
+Calls: 
+	static int proc_read(int *fd, const char *name, char *buf, int size)
+Input: pid_t pid
+Output: task_stat_t *stat---nvcsw and nivcsw
+Return:
+	0   function run success
+	-1  function run error
+*************************************************/
+static int read_pid_switches(pid_t pid, task_stat_t *stat)
+{
+	char buf[4096];
+	char path[32];
+	const char *p;
+
+	snprintf(path, sizeof(path), "%u/status", pid);
+	if (proc_read(NULL, path, buf, sizeof(buf)) < 0)
+		return -1;
+	p = strstr(buf, "\nvoluntary_ctxt_switches:");
+	if (p != NULL)
+	{
+		p += 25;
+		parse_ull(&p, &stat->nvcsw);
+	}
+	p = strstr(buf, "\nnonvoluntary_ctxt_switches:");
+	if (p != NULL)
+	{
+		p += 28;
+		parse_ull(&p, &stat->nivcsw);
+	}
+	return 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_ctx_task_stat
+Description: cpu time, run queue delay, block io delay and context switches
+	of a process, from one taskstats reply or from /proc/pid/stat, the
+	threads' schedstat and status with the procfs backend. Both sum all
+	threads of the process. The kernel leaves ac_utime and ac_stime out of
+	a process's (tgid) taskstats, so user and system time always come from
+	/proc/pid/stat. Counters run since the process started, callers take
+	deltas.
+Calls: 
+	static int taskstats_query(cpu_ctx_t *ctx, pid_t pid, struct taskstats *ts)
+	static int parse_pidstat(pid_t pid, unsigned long long pid_cpu_stat[PID_STAT_MAX])
+	static int parse_schedstat(cpu_ctx_t *ctx, pid_t pid, const unsigned long long pid_stat[PID_STAT_MAX],
+		unsigned long long *run_ns, unsigned long long *delay_ns)
+	static int read_pid_switches(pid_t pid, task_stat_t *stat)
+Input: 
+	cpu_ctx_t *ctx---caller's context
+	pid_t pid---process id
+Output: task_stat_t *stat
+Return: 
+	0   function run success
+	-EINVAL bad argument
+	-1  process is gone
+*************************************************/
+int sys_check_cpu_ctx_task_stat (cpu_ctx_t *ctx, pid_t pid, task_stat_t *stat)
+{
+	unsigned long long pid_stat[PID_STAT_MAX];
+	struct taskstats ts;
+	unsigned long long tick_us;
+	int backend;
+	int ret;
+
+	if (ctx == NULL || stat == NULL || pid <= 0)
+		return -EINVAL;
+	memset(stat, 0, sizeof(*stat));
+	stat->pid = pid;
+
+	pthread_mutex_lock(&ctx->lock);
+	backend = ctx->backend;
+	ret = backend == PROC_BACKEND_TASKSTATS ? taskstats_query(ctx, pid, &ts) : 0;
+	pthread_mutex_unlock(&ctx->lock);
+	if (backend == PROC_BACKEND_TASKSTATS && ret < 0)
+	{
+		pid_index_prune(pid);
+		return -1;
+	}
+
+	if (parse_pidstat(pid, pid_stat) < 0)
+		return -1;
+	tick_us = 1000000 / sysconf(_SC_CLK_TCK);
+	stat->utime_us = pid_stat[UTIME] * tick_us;
+	stat->stime_us = pid_stat[STIME] * tick_us;
+	if (backend == PROC_BACKEND_TASKSTATS)
+	{
+		stat->run_ns = ts.cpu_run_real_total;
+		stat->run_delay_ns = ts.cpu_delay_total;
+		stat->blkio_delay_ns = ts.blkio_delay_total;
+		stat->nvcsw = ts.nvcsw;
+		stat->nivcsw = ts.nivcsw;
+		return 0;
+	}
+	stat->blkio_delay_ns = pid_stat[DELAYACCT_BLKIO_TICKS] * tick_us * 1000;
+	if (parse_schedstat(ctx, pid, pid_stat, &stat->run_ns, &stat->run_delay_ns) < 0)
+		stat->run_ns = (stat->utime_us + stat->stime_us) * 1000;
+	if (read_pid_switches(pid, stat) < 0)
+		return -1;
+	return 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_task_stat
+Description: sys_check_cpu_ctx_task_stat on the default context
+Calls: 
+	int sys_check_cpu_ctx_task_stat (cpu_ctx_t *ctx, pid_t pid, task_stat_t *stat)
+Input: pid_t pid---process id
+Output: task_stat_t *stat
+Return: see sys_check_cpu_ctx_task_stat
+*************************************************/
+int sys_check_cpu_task_stat (pid_t pid, task_stat_t *stat)
+{
+	return sys_check_cpu_ctx_task_stat(&g_default_ctx, pid, stat);
+}
+
+/*************************************************
+Function: read_pid_counters
+Description: read the counters of a process a snapshot takes rates of and
+	fill the values it reports as they are, from /proc/pid/stat and
+	/proc/pid/status (plus schedstat or taskstats in precise modes)
+Calls: 
+	static int parse_pidstat(pid_t pid, unsigned long long pid_cpu_stat[PID_STAT_MAX])
+	static int read_pid_cputime(cpu_ctx_t *ctx, int mode, pid_t pid, unsigned long long *val)
+	static int read_pid_switches(pid_t pid, task_stat_t *stat)
+Input: 
+	cpu_ctx_t *ctx---not locked by caller
+	int mode---PID_TIME_JIFFY, PID_TIME_SCHEDSTAT or PID_TIME_TASKSTATS
+	unsigned long long page_size
+Output: 
+	unsigned long long count[]---cpu time, minor and major faults, voluntary and
+	 involuntary switches, then START_TIME to tell a reused pid apart
+	proc_snapshot_t *snap---rss, vsize, threads, last cpu, priority and nice
+Return:
+	0   function run success
+	-1  process is gone
+*************************************************/
+static int read_pid_counters(cpu_ctx_t *ctx, int mode, unsigned long long page_size,
+	unsigned long long count[6], proc_snapshot_t *snap)
+{
+	unsigned long long pid_stat[PID_STAT_MAX];
+	task_stat_t sw;
+
+	if (parse_pidstat(snap->pid, pid_stat) < 0)
+		return -1;
+	count[0] = pid_stat[UTIME] + pid_stat[STIME];
+	if (mode != PID_TIME_JIFFY && read_pid_cputime(ctx, mode, snap->pid, &count[0]) < 0)
+		return -1;
+	count[1] = pid_stat[MIN_FLT];
+	count[2] = pid_stat[MAJ_FLT];
+	memset(&sw, 0, sizeof(sw));
+	if (read_pid_switches(snap->pid, &sw) < 0)
+		return -1;
+	count[3] = sw.nvcsw;
+	count[4] = sw.nivcsw;
+	count[5] = pid_stat[START_TIME];
+
+	snap->rss_bytes = pid_stat[RSS] * page_size;
+	snap->vsize_bytes = pid_stat[VSIZE];
+	snap->num_threads = (int)pid_stat[NUM_THREADS];
+	snap->last_cpu = (int)pid_stat[TASK_CPU];
+	snap->priority = (int)pid_stat[PRIORITY];
+	snap->nice = (int)pid_stat[NICE];
+	return 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_ctx_proc_snapshot
+Description: take the resources of many processes at once: cpu usage, minor
+	and major fault rates and voluntary/involuntary context switch rates over
+	one shared interval, and rss, vsize, thread count, last cpu, priority and
+	nice at its end. Every process costs a /proc/pid/stat and a
+	/proc/pid/status read before and after the interval.
+Calls: 
+	static int read_pid_counters(cpu_ctx_t *ctx, int mode, unsigned long long page_size,
+		unsigned long long count[6], proc_snapshot_t *snap)
+	static void sample_stamp(sample_time_t *st, unsigned long long begin)
+Input: 
+	cpu_ctx_t *ctx---caller's context, not locked during the sleep
+	const pid_t pids[]---processes to take
+	int num---how many pids, size of snap[]
+	int interval---time interval between 2 take sample(unit:microsecond),
+	 0 means DEFAULT_SAMPLE_INTERVAL, not bigger than MAX_SAMPLE_INTERVAL
+Output: proc_snapshot_t snap[]---in pids[] order, status -1 for a process that
+	is gone, or whose pid was reused during the interval
+Return: 
+	>=0 how many processes were measured
+	-EINVAL bad argument
+	-ENOMEM out of memory
+	-1  function run error
+*************************************************/
+int sys_check_cpu_ctx_proc_snapshot (cpu_ctx_t *ctx, const pid_t pids[], int num, proc_snapshot_t snap[], int interval)
+{
+	unsigned long long (*prev)[6];
+	unsigned long long count[6];
+	unsigned long long page_size;
+	unsigned long long begin;
+	sample_time_t prev_st, st;
+	double seconds;
+	int mode;
+	int done = 0;
+	int i;
+	int k;
+
+	if (ctx == NULL || pids == NULL || snap == NULL || num <= 0)
+		return -EINVAL;
+	if ((interval < 0) || (interval > MAX_SAMPLE_INTERVAL))
+	{
+		printf("sample interval time argument is illegal\n");
+		return -EINVAL;
+	}
+
+	pthread_mutex_lock(&ctx->lock);
+	mode = pid_time_mode(ctx);
+	pthread_mutex_unlock(&ctx->lock);
+
+	prev = malloc(sizeof(prev[0]) * num);
+	if (prev == NULL)
+		return -ENOMEM;
+	page_size = sysconf(_SC_PAGESIZE);
+	memset(snap, 0, sizeof(snap[0]) * num);
+	begin = proc_clock();
+	for (i = 0; i < num; i++)
+	{
+		snap[i].pid = pids[i];
+		snap[i].status = read_pid_counters(ctx, mode, page_size, prev[i], &snap[i]);
+	}
+	sample_stamp(&prev_st, begin);
+
+	proc_wait(interval ? interval : DEFAULT_SAMPLE_INTERVAL);
+
+	begin = proc_clock();
+	for (i = 0; i < num; i++)
+	{
+		/* a pid that exited during the interval keeps status -1 */
+		if (snap[i].status == 0)
+			snap[i].status = read_pid_counters(ctx, mode, page_size, count, &snap[i]);
+		if (snap[i].status < 0)
+			continue;
+		if (count[5] != prev[i][5])
+		{
+			snap[i].status = -1; /* another process has the pid now */
+			continue;
+		}
+		/* a counter that went back (the ticks of an exited thread's schedstat) counts as 0 */
+		for (k = 0; k < 5; k++)
+			prev[i][k] = count[k] > prev[i][k] ? count[k] - prev[i][k] : 0;
+	}
+	sample_stamp(&st, begin);
+
+	seconds = st.mono_ns > prev_st.mono_ns ? (st.mono_ns - prev_st.mono_ns) / 1e9 : 1;
+	for (i = 0; i < num; i++)
+	{
+		if (snap[i].status < 0)
+			continue;
+		snap[i].usage = cputime_usage(mode != PID_TIME_JIFFY, prev[i][0], st.mono_ns - prev_st.mono_ns);
+		snap[i].min_flt_rate = (float)(prev[i][1] / seconds);
+		snap[i].maj_flt_rate = (float)(prev[i][2] / seconds);
+		snap[i].nvcsw_rate = (float)(prev[i][3] / seconds);
+		snap[i].nivcsw_rate = (float)(prev[i][4] / seconds);
+		done++;
+	}
+	free(prev);
+	return done;
+}
+
+/*************************************************
+Function: sys_check_cpu_proc_snapshot
+Description: sys_check_cpu_ctx_proc_snapshot on the default context
+Calls: 
+	int sys_check_cpu_ctx_proc_snapshot (cpu_ctx_t *ctx, const pid_t pids[], int num, proc_snapshot_t snap[], int interval)
+Input: 
+	const pid_t pids[]
+	int num
+	int interval---0 means DEFAULT_SAMPLE_INTERVAL
+Output: proc_snapshot_t snap[]
+Return: see sys_check_cpu_ctx_proc_snapshot
+*************************************************/
+int sys_check_cpu_proc_snapshot (const pid_t pids[], int num, proc_snapshot_t snap[], int interval)
+{
+	return sys_check_cpu_ctx_proc_snapshot(&g_default_ctx, pids, num, snap, interval);
+}
+
+/*************************************************
+Function: alert_pid_cmp
+Description: qsort()/bsearch() compare of alert_pid_t by pid
+*************************************************/
+static int alert_pid_cmp(const void *a, const void *b)
+{
+	pid_t x = ((const alert_pid_t *)a)->pid;
+	pid_t y = ((const alert_pid_t *)b)->pid;
+
+	return (x > y) - (x < y);
+}
+
+/*************************************************
+Function: alert_process_usage
+Description: usage of every distinct process name of the rules since the
+	previous tick, all processes of a name added together; one index
+	lookup and one cpu time read per process however many rules share it.
+	Only the sampler thread calls it, g_alert_lock is not held across the
+	/proc sweep
+Calls: 
+	static int scan_pid_by_names(const char *names[], int name_num, pid_t pid_list[], int name_idx[], int list_size)
+	static int read_pid_cputime(cpu_ctx_t *ctx, int mode, pid_t pid, unsigned long long *val)
+	static void sample_stamp(sample_time_t *st, unsigned long long begin)
+Input: 
+	const char *names[]---distinct base names
+	int name_num---how many names in names[]
+Output: float usage[]---usage precent of names[i], 100 is one cpu fully busy
+Return: 
+	1   usage[] is valid
+	0   first tick, only the baseline is taken
+	<0  function run error
+*************************************************/
+static int alert_process_usage(const char *names[], int name_num, float usage[])
+{
+	pid_t pid_list[MAX_PID_NUM];
+	int name_idx[MAX_PID_NUM];
+	alert_pid_t *cur = g_alert_pid_cur;
+	alert_pid_t *prev;
+	sample_time_t st;
+	unsigned long long begin;
+	int mode;
+	int count;
+	int valid;
+	int i;
+
+	pthread_mutex_lock(&g_default_ctx.lock);
+	mode = pid_time_mode(&g_default_ctx);
+	pthread_mutex_unlock(&g_default_ctx.lock);
+
+	count = name_num > 0 ? scan_pid_by_names(names, name_num, pid_list, name_idx, MAX_PID_NUM) : 0;
+	if (count < 0)
+		return count;
+	if (g_alert_pid == NULL)
+	{
+		g_alert_pid = malloc(sizeof(g_alert_pid[0]) * MAX_PID_NUM);
+		g_alert_pid_cur = cur = malloc(sizeof(g_alert_pid[0]) * MAX_PID_NUM);
+		if (g_alert_pid == NULL || cur == NULL)
+		{
+			free(g_alert_pid);
+			free(cur);
+			g_alert_pid = g_alert_pid_cur = NULL;
+			return -ENOMEM;
+		}
+	}
+
+	begin = proc_clock();
+	for (i = 0; i < count; i++)
+	{
+		cur[i].pid = pid_list[i];
+		cur[i].name_idx = name_idx[i];
+		if (read_pid_cputime(&g_default_ctx, mode, pid_list[i], &cur[i].time) < 0)
+			cur[i].pid = 0; /* exited, sorted to the front and never matched */
+	}
+	sample_stamp(&st, begin);
+	qsort(cur, count, sizeof(cur[0]), alert_pid_cmp);
+
+	valid = g_alert_primed && mode == g_alert_mode;
+	for (i = 0; i < name_num; i++)
+		usage[i] = 0;
+	for (i = 0; valid && i < count; i++)
+	{
+		if (cur[i].pid == 0)
+			continue;
+		prev = bsearch(&cur[i], g_alert_pid, g_alert_pid_num, sizeof(cur[0]), alert_pid_cmp);
+		/* a process first seen this tick, or a reused pid whose time went back, counts from the next tick */
+		if (prev != NULL && cur[i].time >= prev->time)
+			usage[cur[i].name_idx] += cputime_usage(mode != PID_TIME_JIFFY, cur[i].time - prev->time, st.mono_ns - g_alert_clock);
+	}
+
+	g_alert_pid_cur = g_alert_pid;
+	g_alert_pid = cur;
+	g_alert_pid_num = count;
+	g_alert_clock = st.mono_ns;
+	g_alert_mode = mode;
+	g_alert_primed = 1;
+	return valid;
+}
+
+/*************************************************
+Function: alert_step
+Description: advance one rule's state machine with a new value, an edge is
+	taken once its condition held for fire_ms or clear_ms; between
+	threshold and clear the rule keeps its state. caller holds g_alert_lock
+Input: 
+	alert_slot_t *slot
+	float value
+	int num_cpus---scale of per_cpu rules
+	unsigned long long ts---time of the sample (unit:nanosecond)
+Return: 1 the rule took an edge, slot->fired is the new state, 0 no change
+*************************************************/
+static int alert_step(alert_slot_t *slot, float value, int num_cpus, unsigned long long ts)
+{
+	const alert_rule_t *rule = &slot->rule;
+	float scale = rule->per_cpu ? (float)num_cpus : 1.0f;
+	float threshold = rule->threshold * scale;
+	float clear = rule->clear * scale;
+	unsigned long long hold;
+	int cond;
+
+	if (!slot->fired)
+	{
+		cond = rule->op == ALERT_ABOVE ? value > threshold : value < threshold;
+		hold = (unsigned long long)rule->fire_ms * 1000000;
+	}
+	else
+	{
+		cond = rule->op == ALERT_ABOVE ? value <= clear : value >= clear;
+		hold = (unsigned long long)rule->clear_ms * 1000000;
+	}
+	if (!cond)
+	{
+		slot->since = 0;
+		return 0;
+	}
+	if (slot->since == 0)
+		slot->since = ts;
+	if (ts - slot->since < hold)
+		return 0;
+	slot->since = 0;
+	slot->fired = !slot->fired;
+	return 1;
+}
+
+/*************************************************
+Function: alert_grow
+Description: make the sampler thread's per-tick alert buffers hold size
+	rules, they only grow and g_alert_names[i] always points to the i-th
+	name of g_alert_name_buf. caller holds g_alert_lock
+Input: int size---g_alert_size
+Output: 
+Return: 
+	0   function run success
+	-ENOMEM  out of memory, the old buffers stay
+*************************************************/
+static int alert_grow(int size)
+{
+	const char **names;
+	char *name_buf;
+	float *usage;
+	alert_fire_t *fire;
+	int i;
+
+	if (size <= g_alert_buf_size)
+		return 0;
+	names = realloc(g_alert_names, sizeof(names[0]) * size);
+	if (names == NULL)
+		return -ENOMEM;
+	g_alert_names = names;
+	name_buf = realloc(g_alert_name_buf, sizeof(g_alert[0].rule.name) * size);
+	if (name_buf == NULL)
+		return -ENOMEM;
+	g_alert_name_buf = name_buf;
+	usage = realloc(g_alert_usage, sizeof(usage[0]) * size);
+	if (usage == NULL)
+		return -ENOMEM;
+	g_alert_usage = usage;
+	fire = realloc(g_alert_fire, sizeof(fire[0]) * size);
+	if (fire == NULL)
+		return -ENOMEM;
+	g_alert_fire = fire;
+	for (i = 0; i < size; i++)
+		names[i] = name_buf + (size_t)i * sizeof(g_alert[0].rule.name);
+	g_alert_buf_size = size;
+	return 0;
+}
+
+/*************************************************
+Function: alert_eval
+Description: evaluate every rule on the sampler's newest sample, it runs on
+	the sampler thread after each sample. The process names of the rules are
+	copied out under g_alert_lock and measured without it, so adding,
+	removing or reading rules does not wait for the /proc sweep; a rule
+	added meanwhile is evaluated from the next tick. Events of rules with a
+	callback are delivered after g_alert_lock is dropped, the others are
+	queued and the eventfd is signalled
+Calls: 
+	static int alert_grow(int size)
+	static int alert_process_usage(const char *names[], int name_num, float usage[])
+	static int alert_step(alert_slot_t *slot, float value, int num_cpus, unsigned long long ts)
+	static float history_field(const cpu_sample_t *sample, int field)
+Input: 
+	const cpu_sample_t *sample
+	int num_cpus---scale of per_cpu rules, the cpus available to the caller
+*************************************************/
+static void alert_eval(const cpu_sample_t *sample, int num_cpus)
+{
+	const int name_size = sizeof(g_alert[0].rule.name);
+	alert_slot_t *slot;
+	alert_event_t *q;
+	float value;
+	int name_num = 0;
+	int fire_num = 0;
+	int queued = 0;
+	int valid;
+	int i;
+	int k;
+
+	pthread_mutex_lock(&g_alert_lock);
+	if (g_alert_num == 0 || alert_grow(g_alert_size) < 0)
+	{
+		pthread_mutex_unlock(&g_alert_lock);
+		return;
+	}
+	if (g_alert_stale)
+	{
+		g_alert_primed = 0;
+		g_alert_stale = 0;
+	}
+	/* process rules watching the same name share one lookup and one read per process */
+	for (i = 0; i < g_alert_size; i++)
+	{
+		slot = &g_alert[i];
+		if (!slot->used || slot->rule.field != ALERT_PROCESS)
+			continue;
+		for (k = 0; k < name_num && strcmp(g_alert_names[k], slot->rule.name) != 0; k++)
+			;
+		if (k < name_num)
+			continue;
+		memcpy(g_alert_name_buf + (size_t)name_num++ * name_size, slot->rule.name, name_size);
+	}
+	pthread_mutex_unlock(&g_alert_lock);
+
+	valid = name_num > 0 ? alert_process_usage(g_alert_names, name_num, g_alert_usage) : 0;
+
+	pthread_mutex_lock(&g_alert_lock);
+	/* rules added during the sweep need room for their events */
+	if (alert_grow(g_alert_size) < 0)
+	{
+		pthread_mutex_unlock(&g_alert_lock);
+		return;
+	}
+	for (i = 0; i < g_alert_size; i++)
+	{
+		slot = &g_alert[i];
+		if (!slot->used)
+			continue;
+		if (slot->rule.field == ALERT_PROCESS)
+		{
+			if (valid <= 0)
+				continue;
+			for (k = 0; k < name_num && strcmp(g_alert_names[k], slot->rule.name) != 0; k++)
+				;
+			if (k == name_num)
+				continue; /* added during the sweep */
+			value = g_alert_usage[k];
+		}
+		else
+			value = history_field(sample, slot->rule.field);
+		if (!alert_step(slot, value, num_cpus, sample->ts))
+			continue;
+		if (slot->cb != NULL)
+		{
+			g_alert_fire[fire_num].cb = slot->cb;
+			g_alert_fire[fire_num].arg = slot->arg;
+			q = &g_alert_fire[fire_num++].event;
+		}
+		else
+		{
+			if (g_alert_qhead - g_alert_qtail == ALERT_QUEUE_SIZE)
+				g_alert_qtail++; /* full, drop the oldest */
+			q = &g_alert_queue[g_alert_qhead++ % ALERT_QUEUE_SIZE];
+			queued++;
+		}
+		q->rule = i;
+		q->fired = slot->fired;
+		q->value = value;
+		q->ts = sample->ts;
+	}
+	if (queued > 0 && g_alert_efd >= 0)
+	{
+		uint64_t n = queued;
+
+		/* EAGAIN: the counter is saturated, the reader is awake anyway */
+		if (write(g_alert_efd, &n, sizeof(n)) < 0 && errno != EAGAIN)
+			printf("can't signal alert eventfd because:%s\n", strerror(errno));
+	}
+	pthread_mutex_unlock(&g_alert_lock);
+
+	/* callbacks may add or remove rules, so they run unlocked */
+	for (i = 0; i < fire_num; i++)
+		g_alert_fire[i].cb(&g_alert_fire[i].event, g_alert_fire[i].arg);
+}
+
+/*************************************************
+Function: sys_check_cpu_alert_add
+Description: register a threshold rule such as "process X > 80% for 10 s",
+	"iowait > 30%" or "load1 > 2 x ncpu". Rules are evaluated on every sample
+	of the background sampler, so they only run while it is started, and
+	the sampler period is their time resolution. A rule fires once its value
+	was past threshold for fire_ms and clears once it was back past clear
+	for clear_ms, only those edges are reported.
+	Process usage is 100 for one cpu fully busy, like sys_check_cpu_process
+Calls: 
+	char *get_basename(const char *path)
+Input: 
+	const alert_rule_t *rule
+	alert_cb_t cb---called on the sampler thread for every edge, NULL queues
+	 the edges for sys_check_cpu_alert_read instead
+	void *arg---passed to cb
+Output: 
+Return: 
+	>=0 id of the rule, reused after sys_check_cpu_alert_remove
+	-EINVAL  rule is illegal
+	-ENOMEM  out of memory
+*************************************************/
+int sys_check_cpu_alert_add (const alert_rule_t *rule, alert_cb_t cb, void *arg)
+{
+	alert_slot_t *grown;
+	int size;
+	int i;
+
+	if (rule == NULL || rule->field < 0 || rule->field >= ALERT_FIELD_MAX
+		|| rule->fire_ms < 0 || rule->clear_ms < 0)
+		return -EINVAL;
+	if ((rule->op == ALERT_ABOVE && rule->clear > rule->threshold)
+		|| (rule->op == ALERT_BELOW && rule->clear < rule->threshold)
+		|| (rule->op != ALERT_ABOVE && rule->op != ALERT_BELOW))
+	{
+		printf("alert clear level must not be past the threshold\n");
+		return -EINVAL;
+	}
+	if (rule->field == ALERT_PROCESS
+		&& (memchr(rule->name, '\0', sizeof(rule->name)) == NULL || rule->name[0] == '\0'))
+		return -EINVAL;
+
+	pthread_mutex_lock(&g_alert_lock);
+	for (i = 0; i < g_alert_size && g_alert[i].used; i++)
+		;
+	if (i == g_alert_size)
+	{
+		size = g_alert_size ? g_alert_size * 2 : 16;
+		grown = realloc(g_alert, sizeof(g_alert[0]) * size);
+		if (grown == NULL)
+		{
+			pthread_mutex_unlock(&g_alert_lock);
+			return -ENOMEM;
+		}
+		memset(grown + g_alert_size, 0, sizeof(grown[0]) * (size - g_alert_size));
+		g_alert = grown;
+		g_alert_size = size;
+	}
+	memset(&g_alert[i], 0, sizeof(g_alert[i]));
+	g_alert[i].rule = *rule;
+	if (rule->field == ALERT_PROCESS)
+		snprintf(g_alert[i].rule.name, sizeof(g_alert[i].rule.name), "%s", get_basename(rule->name));
+	g_alert[i].cb = cb;
+	g_alert[i].arg = arg;
+	g_alert[i].used = 1;
+	__atomic_store_n(&g_alert_num, g_alert_num + 1, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&g_alert_lock);
+	return i;
+}
+
+/*************************************************
+Function: sys_check_cpu_alert_remove
+Description: drop a rule, no edge is reported for it afterwards except a
+	callback the sampler already took out of the tick being evaluated
+Input: int id---from sys_check_cpu_alert_add
+Output: 
+Return: 
+	0   function run success
+	-ENOENT  no such rule
+*************************************************/
+int sys_check_cpu_alert_remove (int id)
+{
+	pthread_mutex_lock(&g_alert_lock);
+	if (id < 0 || id >= g_alert_size || !g_alert[id].used)
+	{
+		pthread_mutex_unlock(&g_alert_lock);
+		return -ENOENT;
+	}
+	g_alert[id].used = 0;
+	__atomic_store_n(&g_alert_num, g_alert_num - 1, __ATOMIC_RELAXED);
+	if (g_alert_num == 0)
+		g_alert_stale = 1; /* process baselines go stale while no rule runs */
+	pthread_mutex_unlock(&g_alert_lock);
+	return 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_alert_fd
+Description: an eventfd that is readable while events of rules without a
+	callback are queued, poll it and then call sys_check_cpu_alert_read.
+	It is created by the first call and stays open
+Input: 
+Output: 
+Return: 
+	>=0 the eventfd
+	-1  function run error
+*************************************************/
+int sys_check_cpu_alert_fd (void)
+{
+	int fd;
+
+	pthread_mutex_lock(&g_alert_lock);
+	if (g_alert_efd < 0)
+	{
+		g_alert_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (g_alert_efd < 0)
+			printf("can't create alert eventfd\n");
+		else if (g_alert_qhead != g_alert_qtail)
+		{
+			uint64_t n = g_alert_qhead - g_alert_qtail;
+
+			if (write(g_alert_efd, &n, sizeof(n)) < 0)
+				printf("can't signal alert eventfd because:%s\n", strerror(errno));
+		}
+	}
+	fd = g_alert_efd;
+	pthread_mutex_unlock(&g_alert_lock);
+	return fd;
+}
+
+/*************************************************
+Function: sys_check_cpu_alert_read
+Description: take queued events of rules without a callback, oldest first;
+	the eventfd is reset once the queue is empty. When more than
+	ALERT_QUEUE_SIZE events wait the oldest ones are lost
+Input: int size---size of events[]
+Output: alert_event_t events[]
+Return: 
+	>=0 how many events are taken
+	-EINVAL  argument is illegal
+*************************************************/
+int sys_check_cpu_alert_read (alert_event_t events[], int size)
+{
+	uint64_t n;
+	int i;
+
+	if (events == NULL || size < 0)
+		return -EINVAL;
+	pthread_mutex_lock(&g_alert_lock);
+	for (i = 0; i < size && g_alert_qtail != g_alert_qhead; i++)
+		events[i] = g_alert_queue[g_alert_qtail++ % ALERT_QUEUE_SIZE];
+	if (g_alert_qtail == g_alert_qhead && g_alert_efd >= 0)
+	{
+		/* EAGAIN: the counter is already 0 */
+		if (read(g_alert_efd, &n, sizeof(n)) < 0 && errno != EAGAIN)
+			printf("can't reset alert eventfd because:%s\n", strerror(errno));
+	}
+	pthread_mutex_unlock(&g_alert_lock);
+	return i;
+}
+
+
+/*************************************************
+Function: sys_check_cpu_ctx_process_batch
+Description: check many processes' cpu usage precent with one shared sample interval,
+	every /proc/<pid>/stat is read once before and once after a single sleep
+Calls: 
+	char *get_basename(const char *path)
+	static int scan_pid_by_names(const char *names[], int name_num, pid_t pid_list[], int name_idx[], int list_size)
+	static int read_pid_cputime(cpu_ctx_t *ctx, int mode, pid_t pid, unsigned long long *val)
+	static void sample_stamp(sample_time_t *st, unsigned long long begin)
+Input: 
+	cpu_ctx_t *ctx---caller's context, not locked during the sleep
+	const char *names[]---process names to check, all pids matching a name are measured, may be NULL
+	int name_num---how many names in names[]
+	const pid_t pids[]---extra pids to check, may be NULL
+	int pid_num---how many pids in pids[]
+	int usage_size---size of pid_usage[]
+	int interval---time interval between 2 take sample(unit:microsecond),
+	 0 means DEFAULT_SAMPLE_INTERVAL, not bigger than MAX_SAMPLE_INTERVAL
+Output: 
+	proc_usage_t pid_usage[]---usage of every measured pid, matched pids first then pids[]
+	name_usage_t name_usage[]---usage of all pids of names[i] added together, may be NULL
+Return: 
+	>=0 how many entries of pid_usage[] are filled
+	<0  function run error
+*************************************************/
+int sys_check_cpu_ctx_process_batch (cpu_ctx_t *ctx, const char *names[], int name_num, const pid_t pids[], int pid_num,
+		proc_usage_t pid_usage[], int usage_size, name_usage_t name_usage[], int interval)
+{
+	int i;
+	int count;
+	int name_idx[MAX_PID_NUM];
+	pid_t pid_list[MAX_PID_NUM];
+	const char *base_names[MAX_BATCH_NAME_NUM];
+	int mode;
+	unsigned long long *prev_total;
+	unsigned long long begin;
+	sample_time_t prev_st, st;
+	unsigned long long pid_total;
+
+	if (ctx == NULL || pid_usage == NULL || usage_size <= 0
+		|| (name_num > 0 && names == NULL) || (pid_num > 0 && pids == NULL))
+		return -EINVAL;
+	if (name_num < 0 || name_num > MAX_BATCH_NAME_NUM || pid_num < 0)
+		return -EINVAL;
+	if ((interval < 0) || (interval > MAX_SAMPLE_INTERVAL))
+	{
+		printf("sample interval time argument is illegal\n");
+		return -1;
+	}
+
+	count = 0;
+	if (name_num > 0)
+	{
+		for (i = 0; i < name_num; i++)
+		{
+			base_names[i] = get_basename(names[i]);
+			if (name_usage != NULL)
+				memset(&name_usage[i], 0, sizeof(name_usage[i]));
+		}
+		count = scan_pid_by_names(base_names, name_num, pid_list, name_idx,
+				usage_size < MAX_PID_NUM ? usage_size : MAX_PID_NUM);
+		if (count < 0)
+			return count;
+	}
+	for (i = 0; i < count; i++)
+	{
+		pid_usage[i].pid = pid_list[i];
+		pid_usage[i].name_idx = name_idx[i];
+	}
+	for (i = 0; i < pid_num && count < usage_size; i++, count++)
+	{
+		pid_usage[count].pid = pids[i];
+		pid_usage[count].name_idx = -1;
+	}
+	if (count == 0)
+		return 0;
+
+	pthread_mutex_lock(&ctx->lock);
+	mode = pid_time_mode(ctx);
+	pthread_mutex_unlock(&ctx->lock);
+
+	prev_total = malloc(sizeof(prev_total[0]) * count);
+	if (prev_total == NULL)
+		return -ENOMEM;
+
+	begin = proc_clock();
+	for (i = 0; i < count; i++)
+	{
+		pid_usage[i].status = read_pid_cputime(ctx, mode, pid_usage[i].pid, &prev_total[i]);
+		pid_usage[i].usage = 0;
+	}
+	sample_stamp(&prev_st, begin);
+
+	proc_wait(interval ? interval : DEFAULT_SAMPLE_INTERVAL);
+
+	begin = proc_clock();
+	for (i = 0; i < count; i++)
+	{
+		if (pid_usage[i].status < 0)
+			continue;
+		/* a pid that exited during the interval keeps status -1 */
+		pid_usage[i].status = read_pid_cputime(ctx, mode, pid_usage[i].pid, &pid_total);
+		if (pid_usage[i].status < 0)
+			continue;
+		prev_total[i] = pid_total > prev_total[i] ? pid_total - prev_total[i] : 0;
+	}
+	sample_stamp(&st, begin);
+
+	for (i = 0; i < count; i++)
+	{
+		if (pid_usage[i].status < 0)
+			continue;
+		pid_usage[i].usage = cputime_usage(mode != PID_TIME_JIFFY, prev_total[i], st.mono_ns - prev_st.mono_ns);
+		if (name_usage != NULL && pid_usage[i].name_idx >= 0)
+		{
+			name_usage[pid_usage[i].name_idx].pid_num++;
+			name_usage[pid_usage[i].name_idx].usage += pid_usage[i].usage;
+		}
+	}
+	free(prev_total);
+	return count;
+}
+
+/*************************************************
+Function: sys_check_cpu_process_batch
+Description: check many processes' cpu usage precent with one shared sample interval
+Calls: 
+	int sys_check_cpu_ctx_process_batch (cpu_ctx_t *ctx, const char *names[], int name_num, const pid_t pids[], int pid_num,
+		proc_usage_t pid_usage[], int usage_size, name_usage_t name_usage[], int interval)
+Input: see sys_check_cpu_ctx_process_batch
+Output: see sys_check_cpu_ctx_process_batch
+Return: 
+	>=0 how many entries of pid_usage[] are filled
+	<0  function run error
+*************************************************/
+int sys_check_cpu_process_batch (const char *names[], int name_num, const pid_t pids[], int pid_num,
+		proc_usage_t pid_usage[], int usage_size, name_usage_t name_usage[], int interval)
+{
+	return sys_check_cpu_ctx_process_batch(&g_default_ctx, names, name_num, pids, pid_num,
+			pid_usage, usage_size, name_usage, interval);
+}
+
+/*************************************************
+Function: snap_free
+Description: free the process table snapshots of a context
+Input: snap_t *snap---may be NULL
+Output: 
+*************************************************/
+static void snap_free(snap_t *snap)
+{
+	int i;
+
+	if (snap == NULL)
+		return;
+	for (i = 0; i < 2; i++)
+	{
+		free(snap->buf[i].entry);
+		free(snap->buf[i].slot);
+	}
+	free(snap->ids);
+	free(snap->scan);
+	proc_batch_free(&snap->batch);
+	free(snap);
+}
+
+/*************************************************
+Function: snap_grow
+Description: make both snapshot buffers hold at least want entries,
+	never more than SNAP_MAX_TASKS; the hash of the previous walk is rebuilt
+Input: 
+	snap_t *snap
+	int want---entries needed
+Output: 
+Return: 
+	0   function run success
+	-ENOMEM out of memory, buffers keep their old size
+*************************************************/
+static int snap_grow(snap_t *snap, int want)
+{
+	int size = snap->size ? snap->size : SNAP_INIT_TASKS;
+	unsigned slots = 1;
+	int i;
+	int k;
+
+	while (size < want)
+		size *= 2;
+	if (size > SNAP_MAX_TASKS)
+		size = SNAP_MAX_TASKS;
+	if (size <= snap->size)
+		return 0;
+	while (slots < (unsigned)size * 2)
+		slots <<= 1;
+
+	for (i = 0; i < 2; i++)
+	{
+		snap_entry_t *entry = realloc(snap->buf[i].entry, sizeof(entry[0]) * size);
+		int *slot;
+
+		if (entry == NULL)
+			return -ENOMEM;
+		snap->buf[i].entry = entry;
+		slot = realloc(snap->buf[i].slot, sizeof(slot[0]) * slots);
+		if (slot == NULL)
+			return -ENOMEM;
+		snap->buf[i].slot = slot;
+	}
+	snap->size = size;
+	snap->slot_mask = slots - 1;
+
+	/* slot positions depend on the mask, index the previous walk again */
+	for (i = 0; i < 2; i++)
+	{
+		snap_buf_t *b = &snap->buf[i];
+
+		memset(b->slot, 0, sizeof(b->slot[0]) * slots);
+		for (k = 0; k < b->num; k++)
+		{
+			unsigned h = (unsigned)b->entry[k].pid * 2654435761u & snap->slot_mask;
+
+			while (b->slot[h])
+				h = (h + 1) & snap->slot_mask;
+			b->slot[h] = k + 1;
+		}
+	}
+	return 0;
+}
+
+static snap_entry_t *snap_lookup(const snap_t *snap, const snap_buf_t *b, pid_t pid)
+{
+	unsigned h = (unsigned)pid * 2654435761u & snap->slot_mask;
+
+	while (b->slot[h])
+	{
+		if (b->entry[b->slot[h] - 1].pid == pid)
+			return &b->entry[b->slot[h] - 1];
+		h = (h + 1) & snap->slot_mask;
+	}
+	return NULL;
+}
+
+/* proc_batch_fn of snap_walk, parses one /proc/pid/stat into its scan entry; scan workers call it at once */
+static int snap_parse(void *arg, int i, const char *buf, int len)
+{
+	snap_entry_t *e = &((snap_t *)arg)->scan[i];
+	unsigned long long pid_cpu_stat[PID_STAT_MAX];
+
+	(void)len;
+	e->pid = 0;
+	if (buf == NULL || parse_pidstat_buf(buf, pid_cpu_stat) < 0)
+		return 0;
+	e->pid = (pid_t)pid_cpu_stat[PID];
+	e->cpu = (int)pid_cpu_stat[TASK_CPU];
+	e->start_time = pid_cpu_stat[START_TIME];
+	e->jif = pid_cpu_stat[UTIME] + pid_cpu_stat[STIME];
+	parse_pidstat_name(buf, e->name, sizeof(e->name));
+	return 0;
+}
+
+/*************************************************
+Function: snap_walk
+Description: walk /proc once into the spare snapshot buffer, parse every
+	/proc/pid/stat and index it by pid, then make it the current buffer.
+	A serial walk keeps the stat files open in the context's batch reader
+	and reads them in one io_uring submission where the kernel has it;
+	with scan workers the files are split across them. The walk is dated
+	half way through its reads
+Calls: 
+	static int proc_list(const char *dir, pid_t **ids, int *size)
+	static int proc_scan(int kind, proc_batch_t *serial, const pid_t ids[], int num, proc_batch_fn fn, void *arg)
+	static int snap_parse(void *arg, int i, const char *buf, int len)
+	static void sample_stamp(sample_time_t *st, unsigned long long begin)
+Input: cpu_ctx_t *ctx---caller holds ctx->lock, ctx->snap is allocated
+Output: 
+Return: 
+	0   function run success
+	<0  function run error
+*************************************************/
+static int snap_walk(cpu_ctx_t *ctx)
+{
+	snap_t *snap = ctx->snap;
+	snap_buf_t *b = &snap->buf[!snap->cur];
+	sample_time_t st;
+	unsigned long long begin;
+	int num;
+	int ret;
+	int i;
+
+	num = proc_list("", &snap->ids, &snap->ids_size);
+	if (num < 0)
+		return num == -ENOENT ? -EIO : num;
+	qsort(snap->ids, num, sizeof(snap->ids[0]), pid_cmp);
+	if (num > snap->scan_size)
+	{
+		snap_entry_t *scan = realloc(snap->scan, sizeof(scan[0]) * num);
+
+		if (scan == NULL)
+			return -ENOMEM;
+		snap->scan = scan;
+		snap->scan_size = num;
+	}
+	begin = proc_clock();
+	ret = proc_scan(SCAN_TOP, &snap->batch, snap->ids, num, snap_parse, snap);
+	if (ret < 0)
+		return ret;
+	sample_stamp(&st, begin);
+
+	b->num = 0;
+	b->ns = st.mono_ns;
+	memset(b->slot, 0, sizeof(b->slot[0]) * (snap->slot_mask + 1));
+	for (i = 0; i < num; i++)
+	{
+		unsigned h;
+
+		if (snap->scan[i].pid == 0)
+			continue;
+		if (b->num >= snap->size && snap_grow(snap, b->num + 1) < 0)
+			break;
+		if (b->num >= snap->size)
+			break; /* SNAP_MAX_TASKS reached, the rest is not seen */
+		b->entry[b->num] = snap->scan[i];
+		h = (unsigned)b->entry[b->num].pid * 2654435761u & snap->slot_mask;
+		while (b->slot[h])
+			h = (h + 1) & snap->slot_mask;
+		b->slot[h] = ++b->num;
+	}
+	snap->cur = !snap->cur;
+	return 0;
+}
+
+/* min-heap on usage, the root is the smallest of the n best so far */
+static void top_sift_down(proc_top_t top[], int n, int i)
+{
+	while (1)
+	{
+		int l = 2 * i + 1;
+		int m = i;
+		proc_top_t t;
+
+		if (l < n && top[l].usage < top[m].usage)
+			m = l;
+		if (l + 1 < n && top[l + 1].usage < top[m].usage)
+			m = l + 1;
+		if (m == i)
+			return;
+		t = top[i];
+		top[i] = top[m];
+		top[m] = t;
+		i = m;
+	}
+}
+
+static int top_cmp(const void *a, const void *b)
+{
+	float x = ((const proc_top_t *)a)->usage;
+	float y = ((const proc_top_t *)b)->usage;
+
+	return (x < y) - (x > y);
+}
+
+/*************************************************
+Function: sys_check_cpu_ctx_top
+Description: walk /proc once and give the n processes that took the most cpu
+	since the previous call on the same context. The previous walk is kept
+	in a pid-keyed hash, only the n best are kept in a heap while walking
+	so no full sort happens. Memory is bounded by SNAP_MAX_TASKS and reused.
+	The first call only records the baseline and returns 0.
+Calls: 
+	static int snap_walk(cpu_ctx_t *ctx)
+	static float cputime_usage(int precise, unsigned long long pid_diff, unsigned long long wall_ns)
+Input: 
+	cpu_ctx_t *ctx---caller's context
+	int n---size of top[]
+Output: proc_top_t top[]---busiest processes, most cpu first
+Return: 
+	>=0 how many entries of top[] are filled
+	<0  function run error
+*************************************************/
+int sys_check_cpu_ctx_top (cpu_ctx_t *ctx, proc_top_t top[], int n)
+{
+	snap_t *snap;
+	snap_buf_t *cur;
+	snap_buf_t *prev;
+	unsigned long long wall_ns;
+	int count = 0;
+	int ret;
+	int i;
+
+	if (ctx == NULL || top == NULL || n <= 0)
+		return -EINVAL;
+
+	pthread_mutex_lock(&ctx->lock);
+	if (ctx->snap == NULL)
+	{
+		ctx->snap = calloc(1, sizeof(*ctx->snap));
+		if (ctx->snap != NULL)
+			proc_batch_init(&ctx->snap->batch, "stat", PID_STAT_BUF_SIZE, 1);
+		if (ctx->snap == NULL || snap_grow(ctx->snap, SNAP_INIT_TASKS) < 0)
+		{
+			snap_free(ctx->snap);
+			ctx->snap = NULL;
+			pthread_mutex_unlock(&ctx->lock);
+			return -ENOMEM;
+		}
+	}
+	snap = ctx->snap;
+	ret = snap_walk(ctx);
+	if (ret < 0)
+	{
+		pthread_mutex_unlock(&ctx->lock);
+		return ret;
+	}
+
+	cur = &snap->buf[snap->cur];
+	prev = &snap->buf[!snap->cur];
+	if (prev->ns == 0 || cur->ns <= prev->ns)
+	{
+		pthread_mutex_unlock(&ctx->lock);
+		return 0;
+	}
+	wall_ns = cur->ns - prev->ns;
+
+	for (i = 0; i < cur->num; i++)
+	{
+		snap_entry_t *e = &cur->entry[i];
+		snap_entry_t *old = snap_lookup(snap, prev, e->pid);
+		float usage;
+
+		if (old == NULL || old->start_time != e->start_time || e->jif < old->jif)
+			continue; /* new process, its baseline starts now */
+		if (e->jif == old->jif)
+			continue; /* idle, not worth a slot */
+		usage = cputime_usage(0, e->jif - old->jif, wall_ns);
+		if (count == n && usage <= top[0].usage)
+			continue;
+		if (count < n)
+		{
+			int k = count++;
+
+			top[k].usage = usage;
+			top[k].pid = e->pid;
+			top[k].cpu = e->cpu;
+			memcpy(top[k].name, e->name, sizeof(top[k].name));
+			/* sift up */
+			while (k > 0 && top[(k - 1) / 2].usage > top[k].usage)
+			{
+				proc_top_t t = top[k];
+
+				top[k] = top[(k - 1) / 2];
+				top[(k - 1) / 2] = t;
+				k = (k - 1) / 2;
+			}
+		}
+		else
+		{
+			top[0].usage = usage;
+			top[0].pid = e->pid;
+			top[0].cpu = e->cpu;
+			memcpy(top[0].name, e->name, sizeof(top[0].name));
+			top_sift_down(top, count, 0);
+		}
+	}
+	pthread_mutex_unlock(&ctx->lock);
+
+	qsort(top, count, sizeof(top[0]), top_cmp);
+	return count;
+}
+
+/*************************************************
+Function: sys_check_cpu_top
+Description: give the n processes that took the most cpu during interval
+Calls: 
+	int sys_check_cpu_ctx_top (cpu_ctx_t *ctx, proc_top_t top[], int n)
+Input: 
+	int n---size of top[]
+	int interval---time interval between 2 take sample(unit:microsecond),
+	 0 means DEFAULT_SAMPLE_INTERVAL, not bigger than MAX_SAMPLE_INTERVAL
+Output: proc_top_t top[]---busiest processes, most cpu first
+Return: 
+	>=0 how many entries of top[] are filled
+	<0  function run error
+*************************************************/
+int sys_check_cpu_top (proc_top_t top[], int n, int interval)
+{
+	int ret;
+
+	if ((interval < 0) || (interval > MAX_SAMPLE_INTERVAL))
+	{
+		printf("sample interval time argument is illegal\n");
+		return -1;
+	}
+	ret = sys_check_cpu_ctx_top(&g_default_ctx, top, n);
+	if (ret < 0)
+		return ret;
+	proc_wait(interval ? interval : DEFAULT_SAMPLE_INTERVAL);
+	return sys_check_cpu_ctx_top(&g_default_ctx, top, n);
+}
+
+static int thread_cmp(const void *a, const void *b)
+{
+	return pid_cmp(&((const snap_entry_t *)a)->pid, &((const snap_entry_t *)b)->pid);
+}
+
+/*************************************************
+Function: read_thread_stat
+Description: read /proc/pid/task/tid/stat into a thread cache entry
+Calls: 
+	static int proc_read(int *fd, const char *name, char *buf, int size)
+	static int parse_pidstat_buf(const char *buf, unsigned long long pid_cpu_stat[PID_STAT_MAX])
+	static void parse_pidstat_name(const char *buf, char *name, int size)
+Input: 
+	pid_t pid---process
+	pid_t tid---thread of pid
+Output: snap_entry_t *e---tid, last cpu, start time, jiffies and name
+Return: 
+	0   function run success
+	-1  thread is gone
+*************************************************/
+static int read_thread_stat(pid_t pid, pid_t tid, snap_entry_t *e)
+{
+	char path[64];
+	char buf[PID_STAT_BUF_SIZE];
+	unsigned long long pid_cpu_stat[PID_STAT_MAX];
+
+	snprintf(path, sizeof(path), "%u/task/%u/stat", pid, tid);
+	if (proc_read(NULL, path, buf, sizeof(buf)) < 0
+		|| parse_pidstat_buf(buf, pid_cpu_stat) < 0)
+		return -1;
+	e->pid = tid;
+	e->cpu = (int)pid_cpu_stat[TASK_CPU];
+	e->start_time = pid_cpu_stat[START_TIME];
+	e->jif = pid_cpu_stat[UTIME] + pid_cpu_stat[STIME];
+	parse_pidstat_name(buf, e->name, sizeof(e->name));
+	return 0;
+}
+
+/*************************************************
+Function: thread_cache_rescan
+Description: list /proc/pid/task and add the tids the cache doesn't know yet,
+	their first sample becomes their baseline
+Calls: 
+	static int proc_list(const char *dir, pid_t **ids, int *size)
+	static int read_thread_stat(pid_t pid, pid_t tid, snap_entry_t *e)
+Input: 
+	thread_cache_t *tc---cache of pid
+	pid_t pid---process
+Output: 
+Return: 
+	0   function run success
+	<0  function run error
+*************************************************/
+static int thread_cache_rescan(thread_cache_t *tc, pid_t pid)
+{
+	char path[32];
+	int known = tc->num;
+	snap_entry_t key;
+	int num;
+	int i;
+
+	snprintf(path, sizeof(path), "%u/task", pid);
+	num = proc_list(path, &tc->ids, &tc->ids_size);
+	if (num < 0)
+		return num == -ENOENT ? -ESRCH : num;
+	for (i = 0; i < num; i++)
+	{
+		key.pid = tc->ids[i];
+		if (bsearch(&key, tc->entry, known, sizeof(key), thread_cmp) != NULL)
+			continue;
+		if (tc->num >= tc->size)
+		{
+			int size = tc->size ? tc->size * 2 : 16;
+			snap_entry_t *entry = realloc(tc->entry, sizeof(entry[0]) * size);
+
+			if (entry == NULL)
+				return -ENOMEM;
+			tc->entry = entry;
+			tc->size = size;
+		}
+		if (read_thread_stat(pid, key.pid, &tc->entry[tc->num]) == 0)
+			tc->num++;
+	}
+	qsort(tc->entry, tc->num, sizeof(tc->entry[0]), thread_cmp);
+	return 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_ctx_threads
+Description: give every thread's cpu usage precent of a process since the
+	previous call on the same context. Known tids and their names are cached,
+	/proc/pid/task is only listed again when the thread count changed or a
+	known thread is gone, so repeated polling reads one stat file per thread.
+	The first call for a pid only records the baseline and returns 0.
+Calls: 
+	static int read_thread_stat(pid_t pid, pid_t tid, snap_entry_t *e)
+	static int thread_cache_rescan(thread_cache_t *tc, pid_t pid)
+	static void sample_stamp(sample_time_t *st, unsigned long long begin)
+Input: 
+	cpu_ctx_t *ctx---caller's context
+	pid_t pid---process whose threads are checked
+	int size---size of usage[]
+Output: thread_usage_t usage[]---usage of every thread, ascending tid
+Return: 
+	>=0 how many threads exist, only the first size of them are filled
+	<0  function run error
+*************************************************/
+int sys_check_cpu_ctx_threads (cpu_ctx_t *ctx, pid_t pid, thread_usage_t usage[], int size)
+{
+	thread_cache_t *tc;
+	unsigned long long pid_cpu_stat[PID_STAT_MAX];
+	unsigned long long begin;
+	unsigned long long wall_ns = 0;
+	sample_time_t st;
+	snap_entry_t e;
+	int count = 0;
+	int primed;
+	int rescan;
+	int ret = 0;
+	int i;
+	int n;
+
+	if (ctx == NULL || usage == NULL || size <= 0 || pid <= 0)
+		return -EINVAL;
+	/* NUM_THREADS tells whether the cached tid list can still be complete */
+	if (parse_pidstat(pid, pid_cpu_stat) < 0)
+		return -ESRCH;
+
+	pthread_mutex_lock(&ctx->lock);
+	tc = &ctx->threads;
+	if (tc->pid != pid)
+	{
+		tc->pid = pid;
+		tc->num = 0;
+		tc->ns = 0;
+	}
+	primed = tc->ns != 0;
+
+	rescan = (tc->num != (int)pid_cpu_stat[NUM_THREADS]);
+	begin = proc_clock();
+	for (i = 0, n = 0; i < tc->num; i++)
+	{
+		snap_entry_t *old = &tc->entry[i];
+
+		if (read_thread_stat(pid, old->pid, &e) < 0 || e.start_time != old->start_time)
+		{
+			rescan = 1; /* thread exited, or its tid was reused */
+			continue;
+		}
+		if (primed)
+		{
+			if (count < size)
+			{
+				usage[count].tid = e.pid;
+				usage[count].cpu = e.cpu;
+				usage[count].usage = (float)(e.jif - old->jif); /* jiffies until the reads are dated */
+				memcpy(usage[count].name, e.name, sizeof(usage[count].name));
+			}
+			count++;
+		}
+		tc->entry[n++] = e;
+	}
+	tc->num = n;
+	sample_stamp(&st, begin);
+	if (primed && st.mono_ns > tc->ns)
+		wall_ns = st.mono_ns - tc->ns;
+	for (i = 0; i < count && i < size; i++)
+		usage[i].usage = cputime_usage(0, (unsigned long long)usage[i].usage, wall_ns);
+	tc->ns = st.mono_ns;
+	if (rescan)
+		ret = thread_cache_rescan(tc, pid);
+	pthread_mutex_unlock(&ctx->lock);
+	return ret < 0 ? ret : count;
+}
+
+/*************************************************
+Function: sys_check_cpu_threads
+Description: give every thread's cpu usage precent of a process during interval
+Calls: 
+	int sys_check_cpu_ctx_threads (cpu_ctx_t *ctx, pid_t pid, thread_usage_t usage[], int size)
+Input: 
+	pid_t pid---process whose threads are checked
+	int size---size of usage[]
+	int interval---time interval between 2 take sample(unit:microsecond),
+	 0 means DEFAULT_SAMPLE_INTERVAL, not bigger than MAX_SAMPLE_INTERVAL
+Output: thread_usage_t usage[]---usage of every thread, ascending tid
+Return: 
+	>=0 how many threads exist, only the first size of them are filled
+	<0  function run error
+*************************************************/
+int sys_check_cpu_threads (pid_t pid, thread_usage_t usage[], int size, int interval)
+{
+	int ret;
+
+	if ((interval < 0) || (interval > MAX_SAMPLE_INTERVAL))
+	{
+		printf("sample interval time argument is illegal\n");
+		return -1;
+	}
+	ret = sys_check_cpu_ctx_threads(&g_default_ctx, pid, usage, size);
+	if (ret < 0)
+		return ret;
+	proc_wait(interval ? interval : DEFAULT_SAMPLE_INTERVAL);
+	return sys_check_cpu_ctx_threads(&g_default_ctx, pid, usage, size);
+}
+
+/*************************************************
+Function: cgroup_read
+Description: pread cpu.stat and cpu.max of a cgroup and parse them,
+	keys the kernel does not print (no cpu controller) stay 0
+	static int pread_proc_file(int *fd, const char *path, char *buf, int size)
+	static int proc_read(int *fd, const char *name, char *buf, int size)
+Input: cgroup_mon_t *mon---locked by caller
+Output: cgroup_stat_t *stat
+Return: 
+	0   function run success
+	-1  cgroup is gone
+*************************************************/
+static int cgroup_read(cgroup_mon_t *mon, cgroup_stat_t *stat)
+{
+	static const struct
+	{
+		const char *key;
+		int len;
+		size_t off;
+	} keys[] = {
+		{ "usage_usec", 10, offsetof(cgroup_stat_t, usage_usec) },
+		{ "user_usec", 9, offsetof(cgroup_stat_t, user_usec) },
+		{ "system_usec", 11, offsetof(cgroup_stat_t, system_usec) },
+		{ "nr_periods", 10, offsetof(cgroup_stat_t, nr_periods) },
+		{ "nr_throttled", 12, offsetof(cgroup_stat_t, nr_throttled) },
+		{ "throttled_usec", 14, offsetof(cgroup_stat_t, throttled_usec) },
+	};
+	char buf[1024];
+	char path[CGROUP_PATH_SIZE + 16];
+	const char *p;
+	unsigned long long val;
+	int i;
+
+	memset(stat, 0, sizeof(*stat));
+	stat->quota_usec = -1;
+	snprintf(path, sizeof(path), "%s/cpu.stat", mon->dir);
+	if (pread_proc_file(&mon->stat_fd, path, buf, sizeof(buf)) < 0)
+		return -1;
+	for (p = buf; *p; )
+	{
+		for (i = 0; i < (int)(sizeof(keys) / sizeof(keys[0])); i++)
+		{
+			if (strncmp(p, keys[i].key, keys[i].len) == 0 && p[keys[i].len] == ' ')
+			{
+				p += keys[i].len;
+				if (parse_ull(&p, &val))
+					*(unsigned long long *)((char *)stat + keys[i].off) = val;
+				break;
+			}
+		}
+		while (*p && *p != '\n')
+			p++;
+		if (*p == '\n')
+			p++;
+	}
+
+	if (mon->max_fd < 0)
+		return 0; /* root cgroup, never limited */
+	snprintf(path, sizeof(path), "%s/cpu.max", mon->dir);
+	if (pread_proc_file(&mon->max_fd, path, buf, sizeof(buf)) < 0)
+		return -1;
+	p = skip_blank(buf);
+	if (strncmp(p, "max", 3) == 0)
+		p += 3; /* no quota */
+	else if (parse_ull(&p, &val))
+		stat->quota_usec = (long long)val;
+	parse_ull(&p, &stat->period_usec);
+	return 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_cgroup_open
+Description: start watching a cgroup v2 directory, the counters read here are
+	the baseline of the first sys_check_cpu_cgroup_usage
+Calls: 
+	static int cgroup_read(cgroup_mon_t *mon, cgroup_stat_t *stat)
+Input: const char *dir---cgroup directory, e.g. /sys/fs/cgroup/system.slice/foo.service
+Output: 
+Return: new monitor, NULL when the directory has no cpu.stat or out of memory
+*************************************************/
+cgroup_mon_t *sys_check_cpu_cgroup_open (const char *dir)
+{
+	cgroup_mon_t *mon;
+	char path[CGROUP_PATH_SIZE + 16];
+	size_t len;
+
+	if (dir == NULL || (len = strlen(dir)) >= CGROUP_PATH_SIZE)
+		return NULL;
+	mon = calloc(1, sizeof(*mon));
+	if (mon == NULL)
+		return NULL;
+	pthread_mutex_init(&mon->lock, NULL);
+	memcpy(mon->dir, dir, len + 1);
+	while (len > 1 && mon->dir[len - 1] == '/')
+		mon->dir[--len] = '\0';
+	mon->stat_fd = -1;
+	snprintf(path, sizeof(path), "%s/cpu.max", mon->dir);
+	mon->max_fd = open(path, O_RDONLY | O_CLOEXEC); /* -1 is fine, root cgroup */
+	if (cgroup_read(mon, &mon->prev) < 0)
+	{
+		printf("cgroup '%s' has no cpu.stat\n", dir);
+		sys_check_cpu_cgroup_close(mon);
+		return NULL;
+	}
+	mon->prev_ns = monotonic_ns();
+	return mon;
+}
+
+/*************************************************
+Function: sys_check_cpu_cgroup_open_pid
+Description: start watching the cgroup v2 a process belongs to
+Calls: 
+	static int cgroup_path(pid_t pid, const char *controller, char *path, int size)
+	cgroup_mon_t *sys_check_cpu_cgroup_open (const char *dir)
+Input: pid_t pid---0 for the calling process
+Output: 
+Return: new monitor, NULL when the pid is gone, not in a cgroup v2 or out of memory
+*************************************************/
+cgroup_mon_t *sys_check_cpu_cgroup_open_pid (pid_t pid)
+{
+	char rel[CGROUP_PATH_SIZE];
+	char path[CGROUP_PATH_SIZE];
+
+	if (cgroup_path(pid, NULL, rel, sizeof(rel)) < 0)
+	{
+		printf("pid %u is not in a cgroup v2\n", pid);
+		return NULL;
+	}
+	if (snprintf(path, sizeof(path), "%s%s", CGROUP_ROOT, rel) >= (int)sizeof(path))
+		return NULL;
+	return sys_check_cpu_cgroup_open(path);
+}
+
+/*************************************************
+Function: sys_check_cpu_cgroup_close
+Description: close and free a cgroup monitor
+Input: cgroup_mon_t *mon---may be NULL
+Output: 
+*************************************************/
+void sys_check_cpu_cgroup_close (cgroup_mon_t *mon)
+{
+	if (mon == NULL)
+		return;
+	if (mon->stat_fd >= 0)
+		close(mon->stat_fd);
+	if (mon->max_fd >= 0)
+		close(mon->max_fd);
+	pthread_mutex_destroy(&mon->lock);
+	free(mon);
+}
+
+/*************************************************
+Function: sys_check_cpu_cgroup_stat
+Description: read the raw counters of cpu.stat and the limit of cpu.max,
+	the baseline of sys_check_cpu_cgroup_usage is not touched
+Calls: 
+	static int cgroup_read(cgroup_mon_t *mon, cgroup_stat_t *stat)
+Input: cgroup_mon_t *mon
+Output: cgroup_stat_t *stat
+Return: 
+	0   function run success
+	-1  function run error
+*************************************************/
+int sys_check_cpu_cgroup_stat (cgroup_mon_t *mon, cgroup_stat_t *stat)
+{
+	int ret;
+
+	if (mon == NULL || stat == NULL)
+		return -EINVAL;
+	pthread_mutex_lock(&mon->lock);
+	ret = cgroup_read(mon, stat);
+	pthread_mutex_unlock(&mon->lock);
+	return ret;
+}
+
+/*************************************************
+Function: sys_check_cpu_cgroup_usage
+Description: cpu usage of a cgroup against its quota and how often it was
+	throttled. Each call moves the baseline, so polling with interval 0 gives
+	the usage since the previous call (or since open) without any sleep.
+Calls: 
+	static int cgroup_read(cgroup_mon_t *mon, cgroup_stat_t *stat)
+Input: 
+	cgroup_mon_t *mon
+	int interval---time interval between 2 take sample(unit:microsecond),
+	 0 means since the previous call, not bigger than MAX_SAMPLE_INTERVAL
+Output: cgroup_usage_t *usage
+Return: 
+	0   function run success
+	-1  function run error
+*************************************************/
+int sys_check_cpu_cgroup_usage (cgroup_mon_t *mon, cgroup_usage_t *usage, int interval)
+{
+	cgroup_stat_t cur;
+	unsigned long long now;
+	double wall_usec;
+
+	if (mon == NULL || usage == NULL)
+		return -EINVAL;
+	if ((interval < 0) || (interval > MAX_SAMPLE_INTERVAL))
+	{
+		printf("sample interval time argument is illegal\n");
+		return -1;
+	}
+
+	pthread_mutex_lock(&mon->lock);
+	if (interval > 0)
+	{
+		if (cgroup_read(mon, &mon->prev) < 0)
+		{
+			pthread_mutex_unlock(&mon->lock);
+			return -1;
+		}
+		mon->prev_ns = monotonic_ns();
+		pthread_mutex_unlock(&mon->lock);
+		usleep(interval);
+		pthread_mutex_lock(&mon->lock);
+	}
+	if (cgroup_read(mon, &cur) < 0)
+	{
+		pthread_mutex_unlock(&mon->lock);
+		return -1;
+	}
+	now = monotonic_ns();
+
+	memset(usage, 0, sizeof(*usage));
+	wall_usec = (double)(now - mon->prev_ns) / 1000;
+	if (wall_usec < 1)
+		wall_usec = 1;
+	usage->usage = (float)(100.0 * (double)(cur.usage_usec - mon->prev.usage_usec) / wall_usec);
+	usage->throttled = (float)(100.0 * (double)(cur.throttled_usec - mon->prev.throttled_usec) / wall_usec);
+	if (cur.nr_periods > mon->prev.nr_periods)
+		usage->throttle_rate = (float)(100.0 * (double)(cur.nr_throttled - mon->prev.nr_throttled)
+				/ (double)(cur.nr_periods - mon->prev.nr_periods));
+	if (cur.quota_usec >= 0 && cur.period_usec > 0)
+	{
+		usage->limit = (float)(100.0 * (double)cur.quota_usec / (double)cur.period_usec);
+		if (usage->limit > 0)
+			usage->quota_usage = 100 * usage->usage / usage->limit;
+	}
+	mon->prev = cur;
+	mon->prev_ns = now;
+	pthread_mutex_unlock(&mon->lock);
+	return 0;
+}
+
+/*************************************************
+Function: psi_absent
+Description: tell once that the kernel has no PSI (older than 4.20,
+	CONFIG_PSI off or booted with psi=0)
+Input: 
+Output: 
+Return: -ENOENT
+*************************************************/
+static int psi_absent(void)
+{
+	static int told = 0;
+
+	if (!__atomic_exchange_n(&told, 1, __ATOMIC_RELAXED))
+		printf("/proc/pressure is not supported, use sys_check_cpu_load instead\n");
+	return -ENOENT;
+}
+
+/*************************************************
+Function: psi_present
+Description: whether the procfs root has a pressure directory, looked for
+	once per procfs source instead of on every call
+Input: 
+Output: 
+Return: 1 present (or a backend is set), 0 absent
+*************************************************/
+static int psi_present(void)
+{
+	char path[PROC_ROOT_SIZE + 16];
+	unsigned long long probe = __atomic_load_n(&g_psi_probe, __ATOMIC_RELAXED);
+	unsigned gen = __atomic_load_n(&g_proc_gen, __ATOMIC_RELAXED);
+
+	if (g_proc_backend != NULL)
+		return 1;
+	if ((probe & 2) == 0 || (probe >> 2) != gen)
+	{
+		snprintf(path, sizeof(path), "%s/pressure", g_proc_root);
+		probe = ((unsigned long long)gen << 2) | 2 | (access(path, F_OK) == 0);
+		__atomic_store_n(&g_psi_probe, probe, __ATOMIC_RELAXED);
+	}
+	return (int)(probe & 1);
+}
+
+/*************************************************
+Function: parse_psi_line
+Description: parse "avg10=0.12 avg60=0.05 avg300=0.01 total=123456" after the some/full word
+Input: const char **pp---parse position, moved to the end of the line
+Output: psi_line_t *line
+Return: 
+	1   a line was parsed
+	0   parse error
+*************************************************/
+static int parse_psi_line(const char **pp, psi_line_t *line)
+{
+	const char *p = *pp;
+	float *avg[3];
+	int i;
+
+	avg[0] = &line->avg10;
+	avg[1] = &line->avg60;
+	avg[2] = &line->avg300;
+	for (i = 0; i < 3; i++)
+	{
+		p = strchr(p, '=');
+		if (p == NULL)
+			return 0;
+		p++;
+		if (!parse_fixed(&p, avg[i]))
+			return 0;
+	}
+	p = strchr(p, '=');
+	if (p == NULL)
+		return 0;
+	p++;
+	if (!parse_ull(&p, &line->total))
+		return 0;
+	while (*p && *p != '\n')
+		p++;
+	*pp = p;
+	return 1;
+}
+
+/*************************************************
+Function: sys_check_cpu_ctx_psi
+Description: read the pressure stall information of cpu, io or memory, it moves
+	within seconds where the load average takes minutes
+Calls: 
+	static int psi_present(void)
+	static int proc_read(int *fd, const char *name, char *buf, int size)
+	static int parse_psi_line(const char **pp, psi_line_t *line)
+Input: 
+	cpu_ctx_t *ctx---caller's context, the file stays open in it
+	int resource---PSI_CPU, PSI_IO or PSI_MEMORY
+Output: psi_stat_t *stat
+Return: 
+	0   function run success
+	-EINVAL bad argument
+	-ENOENT kernel has no PSI
+	-1  function run error
+*************************************************/
+int sys_check_cpu_ctx_psi (cpu_ctx_t *ctx, int resource, psi_stat_t *stat)
+{
+	char buf[256];
+	const char *p;
+	int ret;
+	int err;
+
+	if (ctx == NULL || stat == NULL || resource < 0 || resource >= PSI_RESOURCE_MAX)
+		return -EINVAL;
+	if (!psi_present())
+		return psi_absent();
+
+	memset(stat, 0, sizeof(*stat));
+	pthread_mutex_lock(&ctx->lock);
+	ret = proc_read(&ctx->psi_fd[resource], g_psi_path[resource], buf, sizeof(buf));
+	err = errno;
+	pthread_mutex_unlock(&ctx->lock);
+	if (ret < 0)
+		return err == EOPNOTSUPP ? psi_absent() : -1;
+
+	for (p = buf; *p; )
+	{
+		if (strncmp(p, "some", 4) == 0)
+		{
+			if (!parse_psi_line(&p, &stat->some))
+				return -1;
+		}
+		else if (strncmp(p, "full", 4) == 0)
+		{
+			if (!parse_psi_line(&p, &stat->full))
+				return -1;
+		}
+		while (*p && *p != '\n')
+			p++;
+		if (*p == '\n')
+			p++;
+	}
+	return 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_psi
+Description: read the pressure stall information of cpu, io or memory
+Calls: 
+	int sys_check_cpu_ctx_psi (cpu_ctx_t *ctx, int resource, psi_stat_t *stat)
+Input: int resource---PSI_CPU, PSI_IO or PSI_MEMORY
+Output: psi_stat_t *stat
+Return: see sys_check_cpu_ctx_psi
+*************************************************/
+int sys_check_cpu_psi (int resource, psi_stat_t *stat)
+{
+	return sys_check_cpu_ctx_psi(&g_default_ctx, resource, stat);
+}
+
+/*************************************************
+Function: sys_check_cpu_psi_trigger
+Description: register a PSI threshold, the returned fd gets POLLPRI once the
+	tasks were stalled stall_us within any window_us. The fd may be put in the
+	caller's own poll set or given to sys_check_cpu_psi_wait; close() removes
+	the trigger. Unprivileged callers need window_us to be a multiple of 2s.
+Input: 
+	int resource---PSI_CPU, PSI_IO or PSI_MEMORY
+	int full---1 for the "full" line, 0 for "some"
+	int stall_us---stall time that fires the trigger (unit:microsecond)
+	int window_us---PSI_MIN_WINDOW to PSI_MAX_WINDOW (unit:microsecond)
+Output: 
+Return: 
+	>=0 trigger fd
+	-EINVAL bad argument
+	-ENOENT kernel has no PSI, poll sys_check_cpu_psi or the load average instead
+	-1  function run error
+*************************************************/
+int sys_check_cpu_psi_trigger (int resource, int full, int stall_us, int window_us)
+{
+	char buf[64];
+	char path[PROC_ROOT_SIZE + 32];
+	int fd;
+	int len;
+	int err;
+
+	if (resource < 0 || resource >= PSI_RESOURCE_MAX)
+		return -EINVAL;
+	if (g_proc_backend != NULL)
+		return -ENOENT; /* a backend has nothing to poll */
+	if (window_us < PSI_MIN_WINDOW || window_us > PSI_MAX_WINDOW
+		|| stall_us <= 0 || stall_us > window_us)
+	{
+		printf("psi trigger threshold argument is illegal\n");
+		return -EINVAL;
+	}
+
+	snprintf(path, sizeof(path), "%s/%s", g_proc_root, g_psi_path[resource]);
+	fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0)
+	{
+		if (errno == ENOENT || errno == EOPNOTSUPP)
+			return psi_absent();
+		printf("can't open %s because:%s\n", path, strerror(errno));
+		return -1;
+	}
+	len = snprintf(buf, sizeof(buf), "%s %d %d", full ? "full" : "some", stall_us, window_us);
+	/* the trailing '\0' is part of what the kernel expects */
+	if (write(fd, buf, len + 1) < 0)
+	{
+		err = errno;
+		close(fd);
+		if (err == EOPNOTSUPP)
+			return psi_absent();
+		printf("can't set psi trigger '%s' because:%s\n", buf, strerror(err));
+		return -1;
+	}
+	return fd;
+}
+
+/*************************************************
+Function: sys_check_cpu_psi_wait
+Description: sleep in poll() until one of the PSI triggers fires
+Input: 
+	const int fds[]---fds from sys_check_cpu_psi_trigger
+	int num---how many fds, at most 32
+	int timeout_ms----1 waits forever
+Output: int fired[]---1 for every fd that fired, may be NULL
+Return: 
+	>0  how many triggers fired
+	0   timeout
+	-EINVAL bad argument
+	-EIO a trigger fd is broken (its cgroup or the kernel dropped it)
+	-1  function run error
+*************************************************/
+int sys_check_cpu_psi_wait (const int fds[], int num, int timeout_ms, int fired[])
+{
+	struct pollfd pfd[32];
+	int ret;
+	int i;
+
+	if (fds == NULL || num <= 0 || num > (int)(sizeof(pfd) / sizeof(pfd[0])))
+		return -EINVAL;
+	for (i = 0; i < num; i++)
+	{
+		pfd[i].fd = fds[i];
+		pfd[i].events = POLLPRI;
+		pfd[i].revents = 0;
+	}
+	do
+		ret = poll(pfd, num, timeout_ms);
+	while (ret < 0 && errno == EINTR);
+	if (ret < 0)
+		return -1;
+
+	ret = 0;
+	for (i = 0; i < num; i++)
+	{
+		if (pfd[i].revents & (POLLERR | POLLNVAL))
+			return -EIO;
+		if (fired != NULL)
+			fired[i] = (pfd[i].revents & POLLPRI) ? 1 : 0;
+		if (pfd[i].revents & POLLPRI)
+			ret++;
+	}
+	return ret;
+}
+
+/*************************************************
+Function: proc_source_set
+Description: switch where procfs is read from. The default context's
+	descriptors are closed and the name->pid index is emptied, nothing read
+	from the previous source is mixed with the new one.
+Input: 
+	const char *root---new procfs root, NULL keeps the current one
+	const proc_backend_t *backend---NULL reads the files under the root
+Output: 
+Return: 
+	0   function run success
+	-EBUSY  the sampler or the proc connector runs
+*************************************************/
+static int proc_source_set(const char *root, const proc_backend_t *backend)
+{
+	int i;
+
+	pthread_mutex_lock(&g_sampler_lock);
+	i = g_sampler_running;
+	pthread_mutex_unlock(&g_sampler_lock);
+	pthread_mutex_lock(&g_procev_lock);
+	i |= g_procev_running;
+	pthread_mutex_unlock(&g_procev_lock);
+	if (i)
+	{
+		printf("stop the sampler and the proc connector before changing the procfs source\n");
+		return -EBUSY;
+	}
+
+	pthread_mutex_lock(&g_default_ctx.lock);
+	if (g_default_ctx.stat_fd >= 0)
+		close(g_default_ctx.stat_fd);
+	if (g_default_ctx.loadavg_fd >= 0)
+		close(g_default_ctx.loadavg_fd);
+	g_default_ctx.stat_fd = -1;
+	g_default_ctx.loadavg_fd = -1;
+	for (i = 0; i < PSI_RESOURCE_MAX; i++)
+	{
+		if (g_default_ctx.psi_fd[i] >= 0)
+			close(g_default_ctx.psi_fd[i]);
+		g_default_ctx.psi_fd[i] = -1;
+	}
+	pthread_mutex_lock(&g_pid_index_lock);
+	g_pid_index_num = 0;
+	if (root != NULL)
+		snprintf(g_proc_root, sizeof(g_proc_root), "%s", root);
+	g_proc_backend = backend;
+	g_proc_host = backend == NULL && strcmp(g_proc_root, PROC_ROOT) == 0;
+	g_proc_gen++; /* every context checks its topology again */
+	pthread_mutex_unlock(&g_pid_index_lock);
+	pthread_mutex_unlock(&g_default_ctx.lock);
+	return 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_set_proc_root
+Description: read procfs from another mount point, a container's or a copy of
+	one. Call it before contexts are created: contexts other than the
+	default one keep descriptors of the previous root. A backend set with
+	sys_check_cpu_set_proc_backend still takes precedence.
+Calls: 
+	static int proc_source_set(const char *root, const proc_backend_t *backend)
+Input: const char *root---"/proc" by default, a trailing '/' is dropped
+Output: 
+Return: 
+	0   function run success
+	-EINVAL bad argument
+	-EBUSY  the sampler or the proc connector runs
+*************************************************/
+int sys_check_cpu_set_proc_root (const char *root)
+{
+	char dir[PROC_ROOT_SIZE];
+	int len;
+
+	if (root == NULL || root[0] == '\0' || strlen(root) >= sizeof(dir))
+		return -EINVAL;
+	len = snprintf(dir, sizeof(dir), "%s", root);
+	while (len > 1 && dir[len - 1] == '/')
+		dir[--len] = '\0';
+	return proc_source_set(dir, g_proc_backend);
+}
+
+/*************************************************
+Function: sys_check_cpu_set_proc_backend
+Description: read procfs through a backend instead of files, every /proc read,
+	listing, sleep between 2 samples and the precise mode clock go through it.
+	Taskstats and the proc connector are not used while a backend is set.
+Calls: 
+	static int proc_source_set(const char *root, const proc_backend_t *backend)
+Input: const proc_backend_t *backend---must stay valid while set, NULL goes back to the files
+Output: 
+Return: 
+	0   function run success
+	-EINVAL backend misses read or list
+	-EBUSY  the sampler or the proc connector runs
+*************************************************/
+int sys_check_cpu_set_proc_backend (const proc_backend_t *backend)
+{
+	if (backend != NULL && (backend->read == NULL || backend->list == NULL))
+		return -EINVAL;
+	return proc_source_set(NULL, backend);
+}
+
+/*************************************************
+Function: sys_check_cpu_set_uring
+Description: choose how the /proc/<pid> sweeps of the name->pid index and of
+	sys_check_cpu_ctx_top read their files: one pread per file by default,
+	or io_uring batches. Measured sweeps were slower through io_uring, so it
+	is opt-in; kernels without io_uring, or with it disabled, stay on pread
+	on their own. Each reader switches at its next sweep
+Input: int enable---0 for pread, otherwise io_uring
+Output: 
+Return: 
+	0   function run success
+*************************************************/
+int sys_check_cpu_set_uring (int enable)
+{
+	__atomic_store_n(&g_proc_uring, enable ? 1 : 0, __ATOMIC_RELAXED);
+	return 0;
+}
+
+/*************************************************
+Function: sys_check_cpu_set_scan_workers
+Description: split the /proc/<pid> sweeps of the name->pid index and of
+	sys_check_cpu_ctx_top across threads. The pids are cut into chunks of
+	SCAN_CHUNK, every thread gets an even share and steals chunks from the
+	others once its own is done. The thread calling the scan is one of the
+	workers. Files are not kept open between parallel sweeps, each one is
+	opened, read and closed. It waits for a running scan to finish
+Calls: 
+	static void scan_pool_stop(int started)
+	static int scan_pool_start(int workers)
+Input: int workers---1 to SCAN_MAX_WORKERS, 1 stops the pool and scans serially
+Output: 
+Return: 
+	0   function run success
+	-EINVAL  workers is out of range
+	-ENOMEM  out of memory
+	-EAGAIN  a thread could not be created, scans stay serial
+*************************************************/
+int sys_check_cpu_set_scan_workers (int workers)
+{
+	int ret = 0;
+
+	if (workers < 1 || workers > SCAN_MAX_WORKERS)
+		return -EINVAL;
+	pthread_mutex_lock(&g_scan_run);
+	if (workers != g_scan_workers)
+	{
+		scan_pool_stop(g_scan_workers - 1);
+		if (workers > 1)
+			ret = scan_pool_start(workers);
+	}
+	pthread_mutex_unlock(&g_scan_run);
+	return ret;
+}
+
+/*************************************************
+Function: sys_check_cpu_scan_stat
+Description: size and wall time of the last /proc sweep of a kind, a
+	measurement taken right after one can tell how long it was delayed
+Input: int kind---SCAN_INDEX or SCAN_TOP
+Output: scan_stat_t *stat---all 0 if no sweep of the kind ran yet
+Return: 
+	0   function run success
+	-EINVAL  argument is illegal
+*************************************************/
+int sys_check_cpu_scan_stat (int kind, scan_stat_t *stat)
+{
+	if (kind < 0 || kind >= SCAN_KIND_MAX || stat == NULL)
+		return -EINVAL;
+	pthread_mutex_lock(&g_scan_lock);
+	*stat = g_scan_stat[kind];
+	pthread_mutex_unlock(&g_scan_lock);
+	return 0;
+}
+
+/* append one file of the procfs source to a trace, a file that is gone is left out */
+static void snapshot_file(FILE *f, const char *name, char *buf)
+{
+	int n = proc_read(NULL, name, buf, PROC_STAT_BUF_SIZE);
 
-	fclose(fp);
-	return 0;
+	if (n < 0)
+		return;
+	fprintf(f, "F %s %d\n", name, n);
+	fwrite(buf, 1, n, f);
+	fputc('\n', f);
 }
 
 /*************************************************
-Function: get_num_cpus
-Description: get current system's cpu number
+Function: sys_check_cpu_snapshot_record
+Description: append one snapshot of the procfs source to a trace file, to be
+	replayed by sys_check_cpu_replay_open. The file is text:
+		SCCTRACE 1
+		S <CLOCK_MONOTONIC ns>
+		F <name> <bytes>
+		<file content>
+	with one S line per snapshot. A snapshot holds stat, loadavg, pressure/<resource>
+	and stat, status and schedstat of every pid. Without the task files precise
+	process usage of a replay falls back to jiffies.
 Calls: 
+	static int proc_list(const char *dir, pid_t **ids, int *size)
+	static void snapshot_file(FILE *f, const char *name, char *buf)
 Input: 
+	const char *path---trace file, created when missing
+	int threads---1 records task/<tid>/stat and schedstat of every thread as well
 Output: 
 Return: 
+	0   function run success
+	-EINVAL bad argument
+	-ENOMEM out of memory
+	-1  function run error
 *************************************************/
-static int get_num_cpus()
+int sys_check_cpu_snapshot_record (const char *path, int threads)
 {
-	FILE *fp;
-	if (NULL == (fp = fopen("/proc/stat","r")))
+	static const char *sys_names[] = { "stat", "loadavg", "pressure/cpu", "pressure/io", "pressure/memory" };
+	static const char *pid_names[] = { "stat", "status", "schedstat" };
+	char name[64];
+	char *buf;
+	pid_t *ids = NULL;
+	pid_t *tids = NULL;
+	int ids_size = 0;
+	int tids_size = 0;
+	int num;
+	int tid_num;
+	int i;
+	int j;
+	int k;
+	FILE *f;
+
+	if (path == NULL)
+		return -EINVAL;
+	buf = malloc(PROC_STAT_BUF_SIZE);
+	if (buf == NULL)
+		return -ENOMEM;
+	f = fopen(path, "a");
+	if (f == NULL)
 	{
-		printf("can't open /proc/stat because:%s\n", strerror(errno));
+		printf("can't open %s because:%s\n", path, strerror(errno));
+		free(buf);
 		return -1;
 	}
-		
-	g_prev_jif = g_cur_jif;
-	if (read_cpu_jiffy(fp, &g_cur_jif) < 4)
-		printf("can't read '%s'", "/proc/stat");
+	fseek(f, 0, SEEK_END);
+	if (ftell(f) == 0)
+		fputs("SCCTRACE 1\n", f);
+	fprintf(f, "S %llu\n", proc_clock());
 
-	if (0 == g_num_cpus) 
+	for (i = 0; i < (int)(sizeof(sys_names) / sizeof(sys_names[0])); i++)
+		snapshot_file(f, sys_names[i], buf);
+	num = proc_list("", &ids, &ids_size);
+	for (i = 0; i < num; i++)
 	{
-		while (1) 
+		for (j = 0; j < (int)(sizeof(pid_names) / sizeof(pid_names[0])); j++)
 		{
-			g_cpu_jif = xrealloc_vector(g_cpu_jif, 1, g_num_cpus);
-			if (read_cpu_jiffy(fp, &g_cpu_jif[g_num_cpus]) <= 4)
-				break;
-			g_num_cpus++;
-		}	
+			snprintf(name, sizeof(name), "%u/%s", ids[i], pid_names[j]);
+			snapshot_file(f, name, buf);
+		}
+		if (!threads)
+			continue;
+		snprintf(name, sizeof(name), "%u/task", ids[i]);
+		tid_num = proc_list(name, &tids, &tids_size);
+		for (k = 0; k < tid_num; k++)
+		{
+			snprintf(name, sizeof(name), "%u/task/%u/stat", ids[i], tids[k]);
+			snapshot_file(f, name, buf);
+			snprintf(name, sizeof(name), "%u/task/%u/schedstat", ids[i], tids[k]);
+			snapshot_file(f, name, buf);
+		}
 	}
-	fclose(fp);
-	return 0;
+	free(tids);
+	free(ids);
+	free(buf);
+	if (ferror(f) | fclose(f))
+	{
+		printf("can't write %s\n", path);
+		return -1;
+	}
+	return num < 0 ? num : 0;
 }
 
-/*************************************************
-Function: display_cpus
-Description: accord /proc/stat to calculate cpu's usage
-Calls: 
-Input: 
-Output: 
-*************************************************/
-static void display_cpus()
+/* compare 2 names that are not '\0' terminated */
+static int replay_name_cmp(const char *a, int alen, const char *b, int blen)
 {
-	unsigned total_diff;
-	jiffy_counts_t *local_pjif = &g_cur_jif;
-	jiffy_counts_t *local_prev_pjif = &g_prev_jif;
-
-# define  CALC_TOTAL_DIFF do { \
-	total_diff = (unsigned)(local_pjif->total - local_prev_pjif->total); \
-	if (total_diff == 0) total_diff = 1; \
-} while (0)
-
-#  define CALC_STAT(xxx) unsigned xxx = 100 * (unsigned)(local_pjif->xxx - local_prev_pjif->xxx) / total_diff
-#  define SHOW_STAT(xxx) xxx
-#  define FMT "%4u%% "
+	int ret = memcmp(a, b, alen < blen ? alen : blen);
 
-	{
-		CALC_TOTAL_DIFF;
+	return ret ? ret : alen - blen;
+}
 
-		//printf("total_diff(%u)\n", total_diff);
-		{
-			CALC_STAT(usr);
-			CALC_STAT(sys);
-			CALC_STAT(nic);
-			CALC_STAT(idle);
-			CALC_STAT(iowait);
-			CALC_STAT(irq);
-			CALC_STAT(softirq);
-			
-			g_cur_cpu_usage.cpu_us = usr;
-			g_cur_cpu_usage.cpu_sy = sys;
-			g_cur_cpu_usage.cpu_ni = nic;
-			g_cur_cpu_usage.cpu_id = idle;
-			g_cur_cpu_usage.cpu_wa = iowait;
-			g_cur_cpu_usage.cpu_hi = irq;
-			g_cur_cpu_usage.cpu_si = softirq;
+static int replay_file_cmp(const void *a, const void *b)
+{
+	const replay_file_t *fa = a;
+	const replay_file_t *fb = b;
 
-			/*printf(
-				"CPU:"FMT"usr"FMT"sys"FMT"nic"FMT"idle"FMT"io"FMT"irq"FMT"sirq\n",
-				SHOW_STAT(usr), SHOW_STAT(sys), SHOW_STAT(nic), SHOW_STAT(idle),
-				SHOW_STAT(iowait), SHOW_STAT(irq), SHOW_STAT(softirq)
-			);*/
-		}
-	}
-# undef SHOW_STAT
-# undef CALC_STAT
-# undef FMT
+	return replay_name_cmp(fa->name, fa->name_len, fb->name, fb->name_len);
 }
 
-/*************************************************
-Function: get_basename
-Description: filter string to get a base name
-Input: progress's abs path
-Output: progress's base name
-*************************************************/
-char *get_basename(const char *path)
+/* first file of the snapshot whose name is not below name */
+static int replay_lower(const proc_replay_t *replay, const replay_snap_t *snap, const char *name, int len)
 {
-    register const char *s;
-    register const char *pp;
+	const replay_file_t *file = replay->file + snap->first;
+	int lo = 0;
+	int hi = snap->num;
 
-    pp = s = path;
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
 
-    while (*s) 
-    {
-        if (*s++ == '/') 
-        {
-            pp = s;
-        }
-    }
+		if (replay_name_cmp(file[mid].name, file[mid].name_len, name, len) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
 
-    return (char *) pp;
+static const replay_snap_t *replay_current(const proc_replay_t *replay)
+{
+	return &replay->snap[__atomic_load_n(&replay->cur, __ATOMIC_ACQUIRE)];
 }
 
-/*************************************************
-Function: get_pid_by_name
-Description: accord progress's name to get its pid
-Calls: 
-	char *get_basename(const char *path)
-Input: progress's name
-Output: progress's  pid
-*************************************************/
-int get_pid_by_name(const char *process_name, pid_t pid_list[], int list_size)
+/* proc_backend_t read of a trace */
+static int replay_read(void *priv, const char *name, char *buf, int size)
 {
-    DIR *dir;
-    struct dirent *next;
-    int count = 0;
-    pid_t pid;
-    FILE *fp;
-    char *base_pname = NULL;
-    char base_fname[MAX_BUF_SIZE];
-    char cmdline[MAX_BUF_SIZE];
-    char path[MAX_BUF_SIZE];
+	const proc_replay_t *replay = priv;
+	const replay_snap_t *snap = replay_current(replay);
+	const replay_file_t *file;
+	int len = strlen(name);
+	int i;
 
-    if(process_name == NULL || pid_list == NULL)
-        return -EINVAL;
+	i = replay_lower(replay, snap, name, len);
+	if (i >= snap->num)
+		return -1;
+	file = &replay->file[snap->first + i];
+	if (replay_name_cmp(file->name, file->name_len, name, len) != 0)
+		return -1;
+	len = file->len < size - 1 ? file->len : size - 1;
+	memcpy(buf, file->data, len);
+	buf[len] = '\0';
+	return len;
+}
 
-    base_pname = get_basename(process_name);
-    if(strlen(base_pname) <= 0)
-        return -EINVAL;
+/* proc_backend_t list of a trace, the numbers following "<dir>/" in file names */
+static int replay_list(void *priv, const char *dir, pid_t **ids, int *size)
+{
+	const proc_replay_t *replay = priv;
+	const replay_snap_t *snap = replay_current(replay);
+	char prefix[64];
+	int len;
+	int num = 0;
+	int i;
 
-    dir = opendir("/proc");
-    if (NULL == dir)//(!dir)
-    {
-        return -EIO;
-    }
-    while ((next = readdir(dir)) != NULL) 
-    {
-        /* skip non-number */
-        if (!isdigit(*next->d_name))
-            continue;
+	len = snprintf(prefix, sizeof(prefix), dir[0] ? "%s/" : "%s", dir);
+	if (len >= (int)sizeof(prefix))
+		return -ENOENT;
+	/* files of one entry sort next to each other, so repeats are adjacent */
+	for (i = replay_lower(replay, snap, prefix, len); i < snap->num; i++)
+	{
+		const replay_file_t *file = &replay->file[snap->first + i];
+		pid_t id = 0;
+		int j;
 
-        pid = strtol(next->d_name, NULL, 0);
-        sprintf(path, "/proc/%u/status", pid);//change from cmdline
-		fp = fopen(path, "r");
-        if(fp == NULL)
-            continue;
+		if (file->name_len < len || memcmp(file->name, prefix, len) != 0)
+			break;
+		for (j = len; j < file->name_len && (unsigned)(file->name[j] - '0') <= 9; j++)
+			id = id * 10 + (file->name[j] - '0');
+		if (j == len || j == file->name_len || file->name[j] != '/')
+			continue;
+		if (num > 0 && (*ids)[num - 1] == id)
+			continue;
+		if (num >= *size && proc_ids_grow(ids, size, num + 1) < 0)
+			return -ENOMEM;
+		(*ids)[num++] = id;
+	}
+	if (num == 0 && dir[0])
+		return -ENOENT;
+	return num;
+}
 
-        memset(cmdline, 0, sizeof(cmdline));
-		if(fgets(cmdline, sizeof(cmdline), fp) > 0)//get message from the file opend before whose file pointer is fp
-		{
-			cmdline[strlen(cmdline) - 1] = '\0';
-			if (strstr(cmdline, "Name:") != NULL)//find Name: from line
-			{
-				strcpy(base_fname, (char *)cmdline + 6);
-			}
-		}        
-        fclose(fp);
-        
-        if (strcmp(base_fname, base_pname) == 0 )
-        {
-            if(count >= list_size)
-            {
-                break;
-            }
-            else
-            {
-                pid_list[count] = pid;
-                count++;
-            }
-        }
-    }
-    closedir(dir) ;
-    return count;
+/* proc_backend_t clock of a trace, the recording time of the current snapshot */
+static unsigned long long replay_clock(void *priv)
+{
+	return replay_current(priv)->ns;
 }
 
-/*************************************************
-Function: is_process_exist
-Description: check whether progress exist
-Calls: 
-	int get_pid_by_name(const char *process_name, pid_t pid_list[], int list_size)
-Input: const char *process_name---progress's name
-Output:
-return:
-	0---progress is exist
-	-1---progress is not exist
-*************************************************/
-int is_process_exist(const char *process_name)
+/* proc_backend_t wait of a trace: step at least one snapshot, then on until usec of recorded time passed */
+static void replay_wait(void *priv, int usec)
 {
-    pid_t pid;
+	proc_replay_t *replay = priv;
+	int cur = __atomic_load_n(&replay->cur, __ATOMIC_ACQUIRE);
+	unsigned long long until = replay->snap[cur].ns + (unsigned long long)usec * 1000;
 
-    return (get_pid_by_name(process_name, &pid, 1) > 0);
+	if (cur + 1 < replay->snap_num)
+		cur++;
+	while (cur + 1 < replay->snap_num && replay->snap[cur].ns < until)
+		cur++;
+	__atomic_store_n(&replay->cur, cur, __ATOMIC_RELEASE);
 }
 
-/*************************************************
-Function: parse_pidstat
-Description: open /proc/pid/stat, parse the content and store in pid_cpu_stat[PID_STAT_MAX]
-Input: progress pid
-Output: unsigned long long pid_cpu_stat[PID_STAT_MAX]
-Return:
-	0   function run success
-	-1  function run error
-*************************************************/
-static int parse_pidstat(pid_t pid, unsigned long long pid_cpu_stat[PID_STAT_MAX])
+/* parse a decimal number ending before end, the mapped trace is not '\0' terminated */
+static int replay_number(const char **pp, const char *end, unsigned long long *val)
 {
-    char buf[600];
-    char path[200];
-    FILE *f;
-    int i = 0;
+	const char *p = *pp;
 
-    memset(pid_cpu_stat, 0, sizeof(pid_cpu_stat[0]) * PID_STAT_MAX);
-    snprintf(path, sizeof(path), "%s%u%s","/proc/", pid, "/stat");
-    f = xfopen_for_read(path);
-	if (f == NULL)
-		return -1;
-    while (fgets(buf, sizeof(buf), f) != NULL) 
-    {
-        //printf("buf=%s\n",buf);//for debug
-        char *tmp = buf;
-        char *p[PID_STAT_MAX];
-        while ((p[i] = strtok(tmp, " ")) != NULL) 
-        {
-            //printf("p[%d]=%s\n", i, p[i]); //for debug
-            pid_cpu_stat[i] = atof(p[i]);
-            
-            //printf("pid_cpu_stat[%d]=%llu\n", i, pid_cpu_stat[i]);
-            i++;
-            tmp = NULL;
-        }
-    }
-    fclose(f);
-    return 0;
+	*val = 0;
+	while (p < end && *p == ' ')
+		p++;
+	if (p >= end || (unsigned)(*p - '0') > 9)
+		return 0;
+	while (p < end && (unsigned)(*p - '0') <= 9)
+		*val = *val * 10 + (unsigned)(*p++ - '0');
+	*pp = p;
+	return 1;
 }
 
 /*************************************************
-Function: sys_check_cpu_sched
-Description: check cpu's idle precent
-Calls: static void parse_loadavg(float cpuloadavg[CPU_LOADAVG_MAX])
-Input: float *load  used to save current cpu's idle precent
-Output: current cpu's idle precent
-Return:
+Function: replay_index
+Description: index the snapshots and files of a mapped trace
+Input: proc_replay_t *replay---map and map_size are set
+Output: 
+Return: 
 	0   function run success
-	-1  function run error
+	-EINVAL the trace is damaged
+	-ENOMEM out of memory
 *************************************************/
-int sys_check_cpu_sched (float *load)
+static int replay_index(proc_replay_t *replay)
 {
-	int ret;
-	if (load == NULL)
-        return -EINVAL;
+	const char *p = replay->map;
+	const char *end = replay->map + replay->map_size;
+	int snap_size = 0;
+	int file_size = 0;
+	unsigned long long val;
+	int i;
 
-	float cpuloadavg[CPU_LOADAVG_MAX];
-	ret = parse_loadavg(cpuloadavg);
-	if (ret < 0 )
-		return -1;
-	*load = g_cur_cpuload.cpu_load_15min;
-	
-	//printf("cpuloadavg[CPU_LOADAVG_1MINS]=%lu cpuloadavg[CPU_LOADAVG_5MINS]=%lu cpuloadavg[CPU_LOADAVG_15MINS]=%lu\n",
-			//cpuloadavg[CPU_LOADAVG_1MINS],cpuloadavg[CPU_LOADAVG_5MINS],cpuloadavg[CPU_LOADAVG_15MINS]);
+	if (replay->map_size < 11 || memcmp(p, "SCCTRACE 1\n", 11) != 0)
+		return -EINVAL;
+	p += 11;
+	while (p < end)
+	{
+		if (*p == 'S')
+		{
+			p++;
+			if (!replay_number(&p, end, &val) || p >= end || *p++ != '\n')
+				return -EINVAL;
+			if (replay->snap_num >= snap_size)
+			{
+				replay_snap_t *snap;
+
+				snap_size = snap_size ? snap_size * 2 : 64;
+				snap = realloc(replay->snap, sizeof(snap[0]) * snap_size);
+				if (snap == NULL)
+					return -ENOMEM;
+				replay->snap = snap;
+			}
+			replay->snap[replay->snap_num].ns = val;
+			replay->snap[replay->snap_num].first = replay->file_num;
+			replay->snap[replay->snap_num].num = 0;
+			replay->snap_num++;
+		}
+		else if (*p == 'F' && replay->snap_num > 0)
+		{
+			replay_file_t *file;
+			const char *name;
+
+			p++;
+			if (p >= end || *p++ != ' ')
+				return -EINVAL;
+			for (name = p; p < end && *p != ' ' && *p != '\n'; p++)
+				;
+			if (p >= end || *p != ' ' || p == name || p - name > 63)
+				return -EINVAL;
+			i = p - name;
+			if (!replay_number(&p, end, &val) || p >= end || *p++ != '\n' || val > (unsigned long long)(end - p))
+				return -EINVAL;
+			if (replay->file_num >= file_size)
+			{
+				file_size = file_size ? file_size * 2 : 4096;
+				file = realloc(replay->file, sizeof(file[0]) * file_size);
+				if (file == NULL)
+					return -ENOMEM;
+				replay->file = file;
+			}
+			file = &replay->file[replay->file_num++];
+			file->name = name;
+			file->name_len = i;
+			file->data = p;
+			file->len = (int)val;
+			replay->snap[replay->snap_num - 1].num++;
+			p += val;
+			if (p < end && *p == '\n')
+				p++;
+		}
+		else
+			return -EINVAL;
+	}
+	if (replay->snap_num == 0)
+		return -EINVAL;
+	for (i = 0; i < replay->snap_num; i++)
+		qsort(replay->file + replay->snap[i].first, replay->snap[i].num, sizeof(replay->file[0]), replay_file_cmp);
 	return 0;
 }
 
 /*************************************************
-Function: sys_check_cpu_usage
-Description: check cpu's usage precent
+Function: sys_check_cpu_replay_open
+Description: map a trace of sys_check_cpu_snapshot_record and index it, the
+	first snapshot is current. Set its backend with sys_check_cpu_set_proc_backend
+	(sys_check_cpu_replay_backend) and every call reads the trace at full
+	speed: the sleep between 2 samples steps to the snapshot recorded that
+	much later, and precise mode runs on the recorded timestamps.
 Calls: 
-	static int get_jiffy_counts(jiffy_counts_t *p_jif)
-	static void display_cpus()
-Input: float *idle  used to save current cpu's usage precent
-Output: current cpu's usage precent
-Return:
-	0   function run success
-	-1  function run error
+	static int replay_index(proc_replay_t *replay)
+Input: const char *path
+Output: 
+Return: new replay, NULL when the trace can't be read or is damaged
 *************************************************/
-int sys_check_cpu_usage (float *kernel, float *user)
+proc_replay_t *sys_check_cpu_replay_open (const char *path)
 {
+	proc_replay_t *replay;
+	struct stat st;
+	int fd;
 	int ret;
-	
-	if (kernel == NULL || user == NULL)
-        return -EINVAL;
 
-	ret = get_jiffy_counts(&g_prev_jif);
-	if (ret < 0)
-		return -1;
-	usleep(300000);
-	ret = get_jiffy_counts(&g_cur_jif);
+	if (path == NULL)
+		return NULL;
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0 || fstat(fd, &st) < 0 || st.st_size == 0)
+	{
+		printf("can't read %s because:%s\n", path, fd < 0 ? strerror(errno) : "empty trace");
+		if (fd >= 0)
+			close(fd);
+		return NULL;
+	}
+	replay = calloc(1, sizeof(*replay));
+	if (replay == NULL)
+	{
+		close(fd);
+		return NULL;
+	}
+	replay->map_size = st.st_size;
+	replay->map = mmap(NULL, replay->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (replay->map == MAP_FAILED)
+	{
+		printf("can't map %s because:%s\n", path, strerror(errno));
+		free(replay);
+		return NULL;
+	}
+	ret = replay_index(replay);
 	if (ret < 0)
-		return -1;
-	display_cpus();
-	*kernel = g_cur_cpu_usage.cpu_sy;
-	*user = g_cur_cpu_usage.cpu_us;
-	return 0;
+	{
+		printf("%s is not a usable trace (%d)\n", path, ret);
+		sys_check_cpu_replay_close(replay);
+		return NULL;
+	}
+	replay->backend.read = replay_read;
+	replay->backend.list = replay_list;
+	replay->backend.clock = replay_clock;
+	replay->backend.wait = replay_wait;
+	replay->backend.priv = replay;
+	return replay;
 }
 
 /*************************************************
-Function: sys_check_cpu_process
-Description: check a progress take how many cpu's usage precent
+Function: sys_check_cpu_replay_close
+Description: unmap a trace, procfs goes back to the files when its backend is set
 Calls: 
-	int is_process_exist(const char *process_name)
-	int get_pid_by_name(const char *process_name, pid_t pid_list[], int list_size)
-	static void parse_pidstat(pid_t pid, unsigned long long pid_cpu_stat[PID_STAT_MAX])
-	static int get_jiffy_counts(jiffy_counts_t *p_jif)
-	static void display_cpus()
-Input: 
-	char *name---process抯 name	
-	int interval---time interval between 2 take sample(unit:a millisecond),
-	 default is 1200000(1.2 second) if you set interval = 0, you can change it as you wish,
-	 but not bigger than 5000000.
-Unit for millisecond
-Output: float *usage---cpu usage precent of individual process
+	static int proc_source_set(const char *root, const proc_backend_t *backend)
+Input: proc_replay_t *replay---may be NULL
+Output: 
 Return: 
 	0   function run success
-	-1  function run error
+	-EBUSY  the trace is the procfs source and the sampler or the proc
+	        connector runs, the trace is kept
 *************************************************/
-int sys_check_cpu_process (char *name, float *usage, int interval)
+int sys_check_cpu_replay_close (proc_replay_t *replay)
 {
-	int ret = 0;  
-	int n;  
-	pid_t pid[MAX_PID_NUM];  
-
-	if (name == NULL || usage == NULL)
-        return -EINVAL;
-
-	if ((interval < 0) || (interval > 5000001))
-	{
-		printf("sample interval time argument is illegal\n");
-		return -1;
-	}
+	int ret;
 
-	ret = is_process_exist(name); 
-	if (ret < 1)
+	if (replay == NULL)
+		return 0;
+	if (g_proc_backend == &replay->backend)
 	{
-		printf("process '%s' is not exist!\n",name);
-		return -1;
-	}
-
-	ret = get_pid_by_name(name, pid, MAX_PID_NUM);  
-	
-	//printf("process '%s' is existed? (%d): %c\n", name, ret, (ret > 0) ? 'y' : 'n');
-	for(n = 0; n < ret; n++)
-	{   //maybe there are servel same progress running, but function only return one usage precent, so lazy here...
-		//printf("pid:%u\n", pid[n]);
+		ret = proc_source_set(NULL, NULL);
+		if (ret < 0)
+			return ret;
 	}
+	munmap(replay->map, replay->map_size);
+	free(replay->file);
+	free(replay->snap);
+	free(replay);
+	return 0;
+}
 
-	ret = get_num_cpus();
-	if (ret < 0)
-		return -1;
-
-	ret = parse_pidstat(pid[0], g_prev_pid_cpu_stat);
-	if (ret < 0)
-		return -1;
-	ret = get_jiffy_counts(&g_prev_jif);
-	if (ret < 0)
-		return -1;
-
-	if (0 == interval)
-		usleep(1200000);
-	else
-		usleep(interval);
-
-	ret = parse_pidstat(pid[0], g_cur_pid_cpu_stat);
-	if (ret < 0)
-		return -1;
-	ret = get_jiffy_counts(&g_cur_jif);
-	if (ret < 0)
-		return -1;
-
+/*************************************************
+Function: sys_check_cpu_replay_backend
+Description: backend serving the current snapshot of a trace
+Input: proc_replay_t *replay
+Output: 
+Return: backend for sys_check_cpu_set_proc_backend, NULL for a NULL replay
+*************************************************/
+const proc_backend_t *sys_check_cpu_replay_backend (proc_replay_t *replay)
 {
-	unsigned total_pid_diff;
-	unsigned pid_jif_total;
-	unsigned prev_pid_jif_total;
-	# define  CALC_TOTAL_PID_DIFF do { \
-		total_pid_diff = (unsigned)(pid_jif_total - prev_pid_jif_total); \
-		if (total_pid_diff == 0) total_pid_diff = 1; \
-	} while (0)
-
-	{
-		prev_pid_jif_total = g_prev_pid_cpu_stat[UTIME] + g_prev_pid_cpu_stat[STIME];
-							 
-							 //+ g_prev_pid_cpu_stat[CUTIME] + g_prev_pid_cpu_stat[CSTIME];
-
-		/*printf("prev_pid[UTIME](%llu) prev_pid[STIME](%llu) prev_pid[CUTIME](%llu) prev_pid_[CSTIME](%llu) \n", 
-				g_prev_pid_cpu_stat[UTIME], g_prev_pid_cpu_stat[STIME], g_prev_pid_cpu_stat[CUTIME], g_prev_pid_cpu_stat[CSTIME]);*/
-		pid_jif_total = g_cur_pid_cpu_stat[UTIME] + g_cur_pid_cpu_stat[STIME];
-						
-						//+ g_cur_pid_cpu_stat[CUTIME] + g_cur_pid_cpu_stat[CSTIME];
-
-		/*printf("cur_pid[UTIME](%llu) cur_pid[STIME](%llu) cur_pid[CUTIME](%llu) cur_pid[CSTIME](%llu) \n", 
-				g_cur_pid_cpu_stat[UTIME], g_cur_pid_cpu_stat[STIME], g_cur_pid_cpu_stat[CUTIME], g_cur_pid_cpu_stat[CSTIME]);*/
-		CALC_TOTAL_PID_DIFF;
-	}
+	return replay == NULL ? NULL : &replay->backend;
+}
 
-	*usage = 100 * (float)(total_pid_diff) / (g_cur_jif.total - g_prev_jif.total) * g_num_cpus;
+/*************************************************
+Function: sys_check_cpu_replay_next
+Description: make the next snapshot of a trace current
+Input: proc_replay_t *replay
+Output: 
+Return: 
+	>=0 index of the snapshot now current
+	-EINVAL bad argument
+	-ENOENT the last snapshot is current already
+*************************************************/
+int sys_check_cpu_replay_next (proc_replay_t *replay)
+{
+	int cur;
 
-/*	printf("process time prev(%u) cur(%u) total_diff(%u) cpu_total(%llu)\n", 
-	prev_pid_jif_total, pid_jif_total, total_pid_diff, (g_cur_jif.total - g_prev_jif.total));*/
-# undef CALC_TOTAL_PID_DIFF
-}
-	return ret;  
+	if (replay == NULL)
+		return -EINVAL;
+	cur = __atomic_load_n(&replay->cur, __ATOMIC_ACQUIRE);
+	if (cur + 1 >= replay->snap_num)
+		return -ENOENT;
+	__atomic_store_n(&replay->cur, cur + 1, __ATOMIC_RELEASE);
+	return cur + 1;
 }
 
-
+#ifndef SYS_CHECK_CPU_NO_MAIN
 #define TEST_COUNT 100
 
 int main(int argc, char *argv[]) 
@@ -648,6 +7639,7 @@ int main(int argc, char *argv[])
 	}
     gettimeofday(&t3, NULL);
 */
+	gettimeofday(&t3, NULL); /* v3 is timed from here, the block setting it above is disabled */
 	for (i = 0; i < TEST_COUNT; i++)
 	{
 		ret = sys_check_cpu_process (process, &usage, 5000000);
@@ -664,6 +7656,7 @@ int main(int argc, char *argv[])
 	printf("v3=%f\n", v3);
     return 0;
 }
+#endif
 
 
 #if 0
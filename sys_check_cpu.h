@@ -10,11 +10,81 @@ supply fellowing interface function
 int sys_check_cpu_sched (float *load)
 int sys_check_cpu_usage (float *idle)
 int sys_check_cpu_process (char *name, float *usage)
+int sys_check_cpu_sampler_start (int period)
+int sys_check_cpu_sampler_stop (void)
+int sys_check_cpu_sampler_set_period (int period)
+int sys_check_cpu_process_batch (const char *names[], int name_num, const pid_t pids[], int pid_num,
+	proc_usage_t pid_usage[], int usage_size, name_usage_t name_usage[], int interval)
+int sys_check_cpu_lookup_pid (const char *name, pid_t pid_list[], int list_size)
+int sys_check_cpu_usage_percpu (cpu_usage_t usage[], int size)
+cpu_ctx_t *sys_check_cpu_ctx_create (void)
+void sys_check_cpu_ctx_destroy (cpu_ctx_t *ctx)
+int sys_check_cpu_ctx_sample (cpu_ctx_t *ctx)
+int sys_check_cpu_ctx_usage (cpu_ctx_t *ctx, cpu_usage_t *usage)
+int sys_check_cpu_ctx_usage_percpu (cpu_ctx_t *ctx, cpu_usage_t usage[], int size)
+int sys_check_cpu_ctx_sched (cpu_ctx_t *ctx, float *load)
+int sys_check_cpu_ctx_process (cpu_ctx_t *ctx, const char *name, float *usage, int interval)
+int sys_check_cpu_ctx_process_batch (cpu_ctx_t *ctx, const char *names[], int name_num, const pid_t pids[], int pid_num,
+	proc_usage_t pid_usage[], int usage_size, name_usage_t name_usage[], int interval)
+int sys_check_cpu_ctx_top (cpu_ctx_t *ctx, proc_top_t top[], int n)
+int sys_check_cpu_top (proc_top_t top[], int n, int interval)
+int sys_check_cpu_ctx_threads (cpu_ctx_t *ctx, pid_t pid, thread_usage_t usage[], int size)
+int sys_check_cpu_threads (pid_t pid, thread_usage_t usage[], int size, int interval)
+int sys_check_cpu_history_enable (int capacity)
+int sys_check_cpu_history_disable (void)
+int sys_check_cpu_history_latest (cpu_sample_t *sample)
+int sys_check_cpu_history_stat (int field, int window_ms, history_stat_t *stat)
+int sys_check_cpu_history_percentile (int field, int window_ms, float pct, float *value)
+int sys_check_cpu_ctx_load (cpu_ctx_t *ctx, proc_load_t *load)
+int sys_check_cpu_load (proc_load_t *load)
+int sys_check_cpu_usage_all (cpu_usage_t *usage)
+int sys_check_cpu_ctx_set_precise (cpu_ctx_t *ctx, int enable)
+int sys_check_cpu_set_precise (int enable)
+cgroup_mon_t *sys_check_cpu_cgroup_open (const char *dir)
+cgroup_mon_t *sys_check_cpu_cgroup_open_pid (pid_t pid)
+void sys_check_cpu_cgroup_close (cgroup_mon_t *mon)
+int sys_check_cpu_cgroup_stat (cgroup_mon_t *mon, cgroup_stat_t *stat)
+int sys_check_cpu_cgroup_usage (cgroup_mon_t *mon, cgroup_usage_t *usage, int interval)
+int sys_check_cpu_ctx_psi (cpu_ctx_t *ctx, int resource, psi_stat_t *stat)
+int sys_check_cpu_psi (int resource, psi_stat_t *stat)
+int sys_check_cpu_psi_trigger (int resource, int full, int stall_us, int window_us)
+int sys_check_cpu_psi_wait (const int fds[], int num, int timeout_ms, int fired[])
+int sys_check_cpu_procev_start (void)
+int sys_check_cpu_procev_stop (void)
+int sys_check_cpu_ctx_set_backend (cpu_ctx_t *ctx, int backend)
+int sys_check_cpu_set_backend (int backend)
+int sys_check_cpu_ctx_task_stat (cpu_ctx_t *ctx, pid_t pid, task_stat_t *stat)
+int sys_check_cpu_task_stat (pid_t pid, task_stat_t *stat)
+int sys_check_cpu_set_proc_root (const char *root)
+int sys_check_cpu_set_proc_backend (const proc_backend_t *backend)
+int sys_check_cpu_snapshot_record (const char *path, int threads)
+proc_replay_t *sys_check_cpu_replay_open (const char *path)
+int sys_check_cpu_replay_close (proc_replay_t *replay)
+const proc_backend_t *sys_check_cpu_replay_backend (proc_replay_t *replay)
+int sys_check_cpu_replay_next (proc_replay_t *replay)
+int sys_check_cpu_ctx_process_adaptive (cpu_ctx_t *ctx, const char *name, float tolerance, int max_interval,
+	proc_estimate_t *est)
+int sys_check_cpu_process_adaptive (const char *name, float tolerance, int max_interval, proc_estimate_t *est)
+int sys_check_cpu_ctx_proc_snapshot (cpu_ctx_t *ctx, const pid_t pids[], int num, proc_snapshot_t snap[], int interval)
+int sys_check_cpu_proc_snapshot (const pid_t pids[], int num, proc_snapshot_t snap[], int interval)
+int sys_check_cpu_alert_add (const alert_rule_t *rule, alert_cb_t cb, void *arg)
+int sys_check_cpu_alert_remove (int id)
+int sys_check_cpu_alert_fd (void)
+int sys_check_cpu_alert_read (alert_event_t events[], int size)
+int sys_check_cpu_set_uring (int enable)
+int sys_check_cpu_set_scan_workers (int workers)
+int sys_check_cpu_scan_stat (int kind, scan_stat_t *stat)
+int sys_check_cpu_ctx_process_measure (cpu_ctx_t *ctx, const char *name, int interval, proc_measure_t *measure)
+int sys_check_cpu_process_measure (const char *name, int interval, proc_measure_t *measure)
+int sys_check_cpu_ctx_topology (cpu_ctx_t *ctx, cpu_topo_t *topo)
+int sys_check_cpu_topology (cpu_topo_t *topo)
 *************************************************/
 
 #ifndef _SYS_CHECK_CPU_H_
 #define _SYS_CHECK_CPU_H_
 
+#include <sys/types.h>
+
 /* FAST_FUNC is a qualifier which (possibly) makes function call faster
  * and/or smaller by using modified ABI. Recent versions of gcc
  * optimize statics automatically. FAST_FUNC on static is required
@@ -28,6 +98,39 @@ int sys_check_cpu_process (char *name, float *usage)
 /* define area */
 #define MAX_BUF_SIZE 3000 /* store some temp read out data */
 #define MAX_PID_NUM  1024 /* define the max scan progress number while get progress pid from progress name */
+#define PROC_STAT_BUF_SIZE 65536 /* whole /proc/stat read at once, cpu lines of big boxes must fit */
+#define PID_STAT_BUF_SIZE 1024 /* whole /proc/pid/stat read at once */
+#define PID_NAME_BUF_SIZE 128 /* head of /proc/pid/status, "Name:\t<comm>\n" is its first line */
+#define SAMPLER_DEFAULT_PERIOD 1000000 /* default background sampler period (unit:microsecond) */
+#define SAMPLER_MIN_PERIOD 10000 /* smallest background sampler period accepted (unit:microsecond) */
+#define DEFAULT_SAMPLE_INTERVAL 1200000 /* default process sample interval (unit:microsecond) */
+#define MAX_SAMPLE_INTERVAL 5000000 /* biggest process sample interval accepted (unit:microsecond) */
+#define MAX_BATCH_NAME_NUM 256 /* max process names checked by one batch call */
+#define SNAP_INIT_TASKS 1024 /* process table snapshot starts with room for this many tasks */
+#define SNAP_MAX_TASKS 65536 /* process table snapshot never grows past this many tasks */
+#define HISTORY_MAX_SIZE (1 << 20) /* most samples the history ring can keep */
+#define CGROUP_ROOT "/sys/fs/cgroup" /* cgroup v2 unified hierarchy mount point */
+#define CGROUP_PATH_SIZE 512 /* longest cgroup directory path accepted */
+#define PSI_MIN_WINDOW 500000 /* smallest PSI trigger window the kernel takes (unit:microsecond) */
+#define PSI_MAX_WINDOW 10000000 /* biggest PSI trigger window the kernel takes (unit:microsecond) */
+#define PROCEV_BATCH_SIZE 256 /* process events merged into the name->pid index at once */
+#define PROCEV_RCVBUF_SIZE (1 << 20) /* proc connector socket buffer, bursts of forks must fit */
+#define PROC_ROOT "/proc" /* default procfs mount point */
+#define PROC_ROOT_SIZE 256 /* longest procfs root accepted */
+#define PROC_BATCH_WINDOW 1024 /* /proc/<pid> files read by one io_uring round, buffers are held for this many */
+#define PROC_BATCH_RING 1024 /* submission queue entries of a batch reader's io_uring */
+#define PROC_BATCH_TEMP 256 /* io_uring file slots for files opened and closed within one round */
+#define PROC_BATCH_MAX_OPEN 512 /* files all batch readers together keep open between sweeps in pread mode, a quarter of RLIMIT_NOFILE at most */
+#define SCAN_MAX_WORKERS 64 /* most threads a parallel /proc scan uses, the caller included */
+#define SCAN_CHUNK 64 /* pids a scan worker takes or steals at once */
+#define ALERT_QUEUE_SIZE 1024 /* alert events kept for sys_check_cpu_alert_read, the oldest are dropped past it */
+#define CPU_TOPO_MAX 4096 /* cpu ids the topology sets hold, higher ones are not counted */
+#define CPU_TOPO_RECHECK 1000000 /* online, affinity and cpuset sets are read again after this long (unit:microsecond) */
+#define CPU_ONLINE_PATH "/sys/devices/system/cpu/online" /* cpu list of the online cpus */
+#define ADAPTIVE_STEP 100000 /* sub-sample period of the adaptive process measure (unit:microsecond) */
+#define ADAPTIVE_MIN_SAMPLES 3 /* sub-samples taken before the adaptive measure may stop */
+#define ADAPTIVE_DEFAULT_TOLERANCE 2.0f /* error bound the adaptive measure stops at (unit:precent) */
+#define ADAPTIVE_SCHED_TICK_NS 4000000 /* how stale a running task's schedstat may be, one tick at HZ=250 (unit:nanosecond) */
 
 /* enum area */
 /*  used for store /proc/loadavg data */
@@ -85,7 +188,7 @@ enum
     TASK_CPU,
     TASK_RT_PRIORITY,
     TASK_POLICY,
-    DUMMY_ITEM1,
+    DELAYACCT_BLKIO_TICKS, /* time waited for block io (unit:clock tick) */
     DUMMY_ITEM2,
     DUMMY_ITEM3,
     DUMMY_ITEM4,
@@ -93,6 +196,62 @@ enum
     PID_STAT_MAX
 };
 
+/*  fields of a history sample, used by sys_check_cpu_history_stat */
+enum
+{
+	HISTORY_CPU_US = 0,
+	HISTORY_CPU_SY,
+	HISTORY_CPU_NI,
+	HISTORY_CPU_ID,
+	HISTORY_CPU_WA,
+	HISTORY_CPU_HI,
+	HISTORY_CPU_SI,
+	HISTORY_CPU_ST,
+	HISTORY_CPU_TOTAL,
+	HISTORY_LOAD_1MIN,
+	HISTORY_LOAD_5MIN,
+	HISTORY_LOAD_15MIN,
+	HISTORY_FIELD_MAX
+};
+
+/*  what an alert rule watches besides the HISTORY_* fields */
+enum
+{
+	ALERT_PROCESS = HISTORY_FIELD_MAX, /* cpu usage precent of all processes of a name added together */
+	ALERT_FIELD_MAX
+};
+
+/*  /proc sweeps timed by sys_check_cpu_scan_stat */
+enum
+{
+	SCAN_INDEX = 0, /* name->pid index refresh, /proc/<pid>/stat of new pids */
+	SCAN_TOP, /* process table walk of sys_check_cpu_ctx_top, every /proc/<pid>/stat */
+	SCAN_KIND_MAX
+};
+
+/*  direction of an alert rule */
+enum
+{
+	ALERT_ABOVE = 0, /* fires when the value goes over the threshold */
+	ALERT_BELOW /* fires when the value goes under the threshold */
+};
+
+/*  where per-process cpu time comes from, see sys_check_cpu_set_backend */
+enum
+{
+	PROC_BACKEND_PROCFS = 0, /* text of /proc/<pid>/stat and schedstat */
+	PROC_BACKEND_TASKSTATS /* binary taskstats over generic netlink, needs CAP_NET_ADMIN and kernel.task_delayacct=1 */
+};
+
+/*  resources of /proc/pressure, used by sys_check_cpu_psi */
+enum
+{
+	PSI_CPU = 0,
+	PSI_IO,
+	PSI_MEMORY,
+	PSI_RESOURCE_MAX
+};
+
 /* struct area */
 /*  used for store /proc/loadaverage */
 typedef struct proc_load_t
@@ -102,6 +261,9 @@ typedef struct proc_load_t
 	float cpu_load_15min;
 	float cpu_load_reserved1;
 	float cpu_load_reserved2;
+	unsigned running; /* runnable tasks, the number before '/' */
+	unsigned total_tasks; /* all tasks, the number after '/' */
+	unsigned last_pid; /* most recently created pid */
 } proc_load_t;
 
 /*  used for store the result of caculate /proc/stat */
@@ -112,6 +274,7 @@ typedef struct jiffy_counts_t
 	unsigned long long iowait, irq, softirq, steal;
 	unsigned long long total;
 	unsigned long long busy;
+	unsigned long long guest, guest_nice; /* already included in usr and nic; appended to keep the layout of older builds */
 } jiffy_counts_t;
 
 /*  used for store the result of caculate /proc/pid/stat */
@@ -126,11 +289,308 @@ typedef struct cpu_usage_t
 	float cpu_si;
 	float cpu_st;
 	float cpu_total;
+	float cpu_gu; /* guest, part of cpu_us; appended to keep the layout of older builds */
+	float cpu_gn; /* guest nice, part of cpu_ni */
 } cpu_usage_t;
 
+/*  used for store one sampler tick in the history ring */
+typedef struct cpu_sample_t
+{
+	unsigned long long ts; /* CLOCK_MONOTONIC time of the sample (unit:nanosecond) */
+	unsigned long long boot_ts; /* CLOCK_BOOTTIME of the same moment, keeps counting across suspend */
+	cpu_usage_t usage; /* usage since the previous tick */
+	proc_load_t load; /* /proc/loadavg at the tick */
+} cpu_sample_t;
+
+/*  used for store the result of sys_check_cpu_history_stat */
+typedef struct history_stat_t
+{
+	int count; /* samples in the window */
+	float min;
+	float max;
+	float mean;
+	float p50;
+	float p95;
+	float p99;
+	unsigned long long first_ts; /* oldest sample in the window */
+	unsigned long long last_ts; /* newest sample in the window */
+} history_stat_t;
+
+/*  used for store one pid's result of sys_check_cpu_process_batch */
+typedef struct proc_usage_t
+{
+	pid_t pid;
+	int name_idx; /* index of the name this pid matched, -1 if it was passed by pid */
+	int status; /* 0 measured, -1 process gone before the second sample */
+	float usage;
+} proc_usage_t;
+
+/*  used for store one name's aggregated result of sys_check_cpu_process_batch */
+typedef struct name_usage_t
+{
+	int pid_num; /* how many measured pids matched this name */
+	float usage; /* all matched pids' usage added together */
+} name_usage_t;
+
+/*  used for store one entry of sys_check_cpu_top */
+typedef struct proc_top_t
+{
+	pid_t pid;
+	int cpu; /* cpu the process last ran on */
+	float usage;
+	char name[16];
+} proc_top_t;
+
+/*  used for store one thread's result of sys_check_cpu_threads */
+typedef struct thread_usage_t
+{
+	pid_t tid;
+	int cpu; /* cpu the thread last ran on */
+	float usage;
+	char name[16];
+} thread_usage_t;
+
+/*  used for store one read of a cgroup's cpu.stat and cpu.max */
+typedef struct cgroup_stat_t
+{
+	unsigned long long usage_usec; /* cpu time of all tasks in the cgroup */
+	unsigned long long user_usec;
+	unsigned long long system_usec;
+	unsigned long long nr_periods; /* enforcement periods elapsed, 0 without a quota */
+	unsigned long long nr_throttled; /* periods the cgroup ran out of quota */
+	unsigned long long throttled_usec; /* time the cgroup was held back */
+	long long quota_usec; /* cpu.max quota, -1 for "max" (no limit) */
+	unsigned long long period_usec; /* cpu.max period */
+} cgroup_stat_t;
+
+/*  used for store a cgroup's cpu usage over an interval */
+typedef struct cgroup_usage_t
+{
+	float usage; /* precent of one cpu, 200 is 2 cpus busy */
+	float limit; /* quota / period in precent of one cpu, 0 without a quota */
+	float quota_usage; /* usage precent of the quota, 0 without a quota */
+	float throttle_rate; /* precent of the periods that were throttled */
+	float throttled; /* precent of the interval the cgroup was held back */
+} cgroup_usage_t;
+
+/*  used for store one process's accounting of sys_check_cpu_task_stat */
+typedef struct task_stat_t
+{
+	pid_t pid;
+	unsigned long long utime_us; /* user cpu time (unit:microsecond) */
+	unsigned long long stime_us; /* system cpu time (unit:microsecond) */
+	unsigned long long run_ns; /* time on a cpu (unit:nanosecond) */
+	unsigned long long run_delay_ns; /* time runnable but waiting on a run queue (unit:nanosecond) */
+	unsigned long long blkio_delay_ns; /* time waiting for block io, 0 without delay accounting (unit:nanosecond) */
+	unsigned long long nvcsw; /* voluntary context switches */
+	unsigned long long nivcsw; /* involuntary context switches */
+} task_stat_t;
+
+/*  used for store one process's resources of sys_check_cpu_proc_snapshot */
+typedef struct proc_snapshot_t
+{
+	pid_t pid;
+	int status; /* 0 measured, -1 process gone before the second sample */
+	float usage; /* precent of one cpu */
+	float min_flt_rate; /* minor page faults per second */
+	float maj_flt_rate; /* major page faults per second, the ones that waited for io */
+	float nvcsw_rate; /* voluntary context switches per second */
+	float nivcsw_rate; /* involuntary context switches per second */
+	unsigned long long rss_bytes; /* resident set size at the second sample */
+	unsigned long long vsize_bytes; /* virtual memory size at the second sample */
+	int num_threads;
+	int last_cpu; /* cpu the process last ran on */
+	int priority;
+	int nice;
+} proc_snapshot_t;
+
+/*  the last /proc sweep of one kind */
+typedef struct scan_stat_t
+{
+	int workers; /* threads that read it, 1 is the caller alone */
+	int pids; /* /proc/<pid> files read */
+	int steals; /* chunks taken from another worker's share */
+	unsigned long long start_ns; /* CLOCK_MONOTONIC at its start (unit:nanosecond) */
+	unsigned long long wall_ns; /* how long it took (unit:nanosecond) */
+} scan_stat_t;
+
+/*  one rule of the alert engine, evaluated on every sampler tick */
+typedef struct alert_rule_t
+{
+	int field; /* HISTORY_* field or ALERT_PROCESS */
+	char name[64]; /* process name of ALERT_PROCESS */
+	int op; /* ALERT_ABOVE or ALERT_BELOW */
+	float threshold; /* value that fires the rule */
+	float clear; /* value that clears it, on the other side of threshold; equal to threshold for no hysteresis */
+	int per_cpu; /* 1 multiplies threshold and clear by the cpu number, for rules like load1 > 2 x ncpu */
+	int fire_ms; /* the firing condition must hold this long before the rule fires (unit:millisecond) */
+	int clear_ms; /* the clearing condition must hold this long before the rule clears (unit:millisecond) */
+} alert_rule_t;
+
+/*  one edge of an alert rule */
+typedef struct alert_event_t
+{
+	int rule; /* id from sys_check_cpu_alert_add */
+	int fired; /* 1 the rule fired, 0 it cleared */
+	float value; /* value at the edge */
+	unsigned long long ts; /* CLOCK_MONOTONIC time of the sample (unit:nanosecond) */
+} alert_event_t;
+
+/*  alert callback, it runs on the sampler thread and must not block */
+typedef void (*alert_cb_t)(const alert_event_t *event, void *arg);
+
+/*  used for store one line of /proc/pressure/<resource> */
+typedef struct psi_line_t
+{
+	float avg10; /* precent of time stalled over the last 10 seconds */
+	float avg60;
+	float avg300;
+	unsigned long long total; /* stall time since boot (unit:microsecond) */
+} psi_line_t;
+
+/*  used for store one read of /proc/pressure/<resource> */
+typedef struct psi_stat_t
+{
+	psi_line_t some; /* at least one task stalled */
+	psi_line_t full; /* all non-idle tasks stalled, all 0 on kernels without it for cpu */
+} psi_stat_t;
+
+/*  procfs source behind every /proc read of the library. Names are relative
+ *  to the procfs root: "stat", "loadavg", "123/stat", "123/task/124/stat" */
+typedef struct proc_backend_t
+{
+	int (*read)(void *priv, const char *name, char *buf, int size); /* whole file, '\0' terminated, bytes or -1 */
+	int (*list)(void *priv, const char *dir, pid_t **ids, int *size); /* numeric entries of dir ("" is the root) into *ids, grown with realloc, count or <0 */
+	unsigned long long (*clock)(void *priv); /* replaces CLOCK_MONOTONIC and CLOCK_BOOTTIME of the samples (unit:nanosecond), NULL keeps them */
+	void (*wait)(void *priv, int usec); /* replaces the sleep between 2 samples, NULL keeps usleep */
+	void *priv;
+} proc_backend_t;
+
+/*  used for store the result of sys_check_cpu_process_adaptive */
+typedef struct proc_estimate_t
+{
+	pid_t pid;
+	float usage; /* precent of one cpu over the whole window */
+	float error; /* the true usage is within usage +- error (about 95%) */
+	int interval; /* window actually measured (unit:microsecond) */
+	int samples; /* sub-samples taken */
+} proc_estimate_t;
+
+/*  when the reads of one sample were taken */
+typedef struct sample_time_t
+{
+	unsigned long long mono_ns; /* CLOCK_MONOTONIC half way through the reads (unit:nanosecond) */
+	unsigned long long boot_ns; /* CLOCK_BOOTTIME of the same moment */
+	unsigned long long scan_ns; /* how long the reads took */
+} sample_time_t;
+
+/*  used for store the result of sys_check_cpu_process_measure */
+typedef struct proc_measure_t
+{
+	pid_t pid;
+	float usage; /* precent of one cpu, cpu time over elapsed wall time; 0 when it used none */
+	unsigned long long cpu_ns; /* cpu time the process used between the 2 samples */
+	unsigned long long wall_ns; /* elapsed time between the 2 samples */
+	int overrun_us; /* how much longer than interval the sleep took */
+	int cpus; /* cpus available when the measure ended, see cpu_topo_t */
+	float norm_usage; /* usage / cpus, 100 is every available cpu busy */
+	sample_time_t start; /* first sample */
+	sample_time_t end; /* second sample */
+} proc_measure_t;
+
+/*  cpus a context may use, sys_check_cpu_ctx_topology */
+typedef struct cpu_topo_t
+{
+	int id_limit; /* highest online cpu id + 1, entries a per-cpu array indexed by cpu id needs */
+	int online; /* cpus of /sys/devices/system/cpu/online, or the cpu lines of a non-host /proc/stat */
+	int affinity; /* cpus sched_getaffinity lets the calling process run on */
+	int cpuset; /* cpus of the cgroup's cpuset.cpus.effective, online when there is none */
+	int available; /* online cpus in both affinity and cpuset, process usage is normalized by it */
+	unsigned gen; /* bumped whenever one of the sets changed */
+} cpu_topo_t;
+
+/*  opaque recorded trace of procfs snapshots, replayed through a proc_backend_t */
+typedef struct proc_replay_t proc_replay_t;
+
+/*  opaque cgroup monitor, keeps cpu.stat and cpu.max open for cheap polling */
+typedef struct cgroup_mon_t cgroup_mon_t;
+
+/*  opaque per-caller state: descriptors, buffers and baselines. Functions taking
+ *  a context are safe to call in parallel on different contexts, the ones
+ *  without work on a shared default context */
+typedef struct cpu_ctx_t cpu_ctx_t;
+
 /*function area*/
 int sys_check_cpu_sched (float *load); /* check cpu's idle precent */
 int sys_check_cpu_usage (float *kernel, float *user);/* check cpu's usage precent */
 int sys_check_cpu_process (char *name, float *usage, int interval);/* check a progress take how many cpu's usage precent */
+int sys_check_cpu_sampler_start (int period);/* start sampling /proc/stat in background, period unit:microsecond */
+int sys_check_cpu_sampler_stop (void);/* stop the background sampler */
+int sys_check_cpu_sampler_set_period (int period);/* change the background sampler's period */
+int sys_check_cpu_process_batch (const char *names[], int name_num, const pid_t pids[], int pid_num,
+		proc_usage_t pid_usage[], int usage_size, name_usage_t name_usage[], int interval);/* check many processes with one shared interval */
+int sys_check_cpu_lookup_pid (const char *name, pid_t pid_list[], int list_size);/* find pids by name from the cached index */
+int sys_check_cpu_usage_percpu (cpu_usage_t usage[], int size);/* check every core's usage precent */
+cpu_ctx_t *sys_check_cpu_ctx_create (void);/* create a context owning its own baselines */
+void sys_check_cpu_ctx_destroy (cpu_ctx_t *ctx);/* free a context */
+int sys_check_cpu_ctx_sample (cpu_ctx_t *ctx);/* read /proc/stat once into the context */
+int sys_check_cpu_ctx_usage (cpu_ctx_t *ctx, cpu_usage_t *usage);/* usage between the context's last 2 samples */
+int sys_check_cpu_ctx_usage_percpu (cpu_ctx_t *ctx, cpu_usage_t usage[], int size);/* per-core usage between the context's last 2 samples */
+int sys_check_cpu_ctx_sched (cpu_ctx_t *ctx, float *load);/* sys_check_cpu_sched on a context */
+int sys_check_cpu_ctx_process (cpu_ctx_t *ctx, const char *name, float *usage, int interval);/* sys_check_cpu_process on a context */
+int sys_check_cpu_ctx_process_batch (cpu_ctx_t *ctx, const char *names[], int name_num, const pid_t pids[], int pid_num,
+		proc_usage_t pid_usage[], int usage_size, name_usage_t name_usage[], int interval);/* sys_check_cpu_process_batch on a context */
+int sys_check_cpu_ctx_top (cpu_ctx_t *ctx, proc_top_t top[], int n);/* busiest processes since the context's previous call */
+int sys_check_cpu_top (proc_top_t top[], int n, int interval);/* busiest processes during interval */
+int sys_check_cpu_ctx_threads (cpu_ctx_t *ctx, pid_t pid, thread_usage_t usage[], int size);/* per-thread usage since the context's previous call */
+int sys_check_cpu_threads (pid_t pid, thread_usage_t usage[], int size, int interval);/* per-thread usage during interval */
+int sys_check_cpu_history_enable (int capacity);/* keep the last capacity sampler ticks */
+int sys_check_cpu_history_disable (void);/* free the sample history */
+int sys_check_cpu_history_latest (cpu_sample_t *sample);/* newest sampler tick */
+int sys_check_cpu_history_stat (int field, int window_ms, history_stat_t *stat);/* min/max/mean/percentiles over a window */
+int sys_check_cpu_history_percentile (int field, int window_ms, float pct, float *value);/* any percentile over a window */
+int sys_check_cpu_ctx_load (cpu_ctx_t *ctx, proc_load_t *load);/* whole /proc/loadavg on a context */
+int sys_check_cpu_load (proc_load_t *load);/* whole /proc/loadavg from one read */
+int sys_check_cpu_usage_all (cpu_usage_t *usage);/* every usage field from one delta */
+int sys_check_cpu_ctx_set_precise (cpu_ctx_t *ctx, int enable);/* process usage from schedstat ns on a context */
+int sys_check_cpu_set_precise (int enable);/* process usage from schedstat ns */
+cgroup_mon_t *sys_check_cpu_cgroup_open (const char *dir);/* monitor a cgroup directory */
+cgroup_mon_t *sys_check_cpu_cgroup_open_pid (pid_t pid);/* monitor the cgroup a pid lives in */
+void sys_check_cpu_cgroup_close (cgroup_mon_t *mon);/* free a cgroup monitor */
+int sys_check_cpu_cgroup_stat (cgroup_mon_t *mon, cgroup_stat_t *stat);/* raw cpu.stat and cpu.max */
+int sys_check_cpu_cgroup_usage (cgroup_mon_t *mon, cgroup_usage_t *usage, int interval);/* usage against quota, throttle rate */
+int sys_check_cpu_ctx_psi (cpu_ctx_t *ctx, int resource, psi_stat_t *stat);/* /proc/pressure/<resource> on a context */
+int sys_check_cpu_psi (int resource, psi_stat_t *stat);/* /proc/pressure/<resource> */
+int sys_check_cpu_psi_trigger (int resource, int full, int stall_us, int window_us);/* pollable PSI threshold fd */
+int sys_check_cpu_psi_wait (const int fds[], int num, int timeout_ms, int fired[]);/* sleep until a PSI trigger fires */
+int sys_check_cpu_procev_start (void);/* keep name->pid lookups current from proc connector events */
+int sys_check_cpu_procev_stop (void);/* back to scanning /proc for name->pid lookups */
+int sys_check_cpu_ctx_set_backend (cpu_ctx_t *ctx, int backend);/* procfs or taskstats per-process backend of a context */
+int sys_check_cpu_set_backend (int backend);/* procfs or taskstats per-process backend */
+int sys_check_cpu_ctx_task_stat (cpu_ctx_t *ctx, pid_t pid, task_stat_t *stat);/* cpu time, delays, switches on a context */
+int sys_check_cpu_task_stat (pid_t pid, task_stat_t *stat);/* cpu time, run queue and io delay, context switches */
+int sys_check_cpu_set_proc_root (const char *root);/* read procfs mounted somewhere else than /proc */
+int sys_check_cpu_set_proc_backend (const proc_backend_t *backend);/* read procfs through a backend, NULL for the files */
+int sys_check_cpu_snapshot_record (const char *path, int threads);/* append one snapshot of procfs to a trace file */
+proc_replay_t *sys_check_cpu_replay_open (const char *path);/* load a recorded trace */
+int sys_check_cpu_replay_close (proc_replay_t *replay);/* free a loaded trace */
+const proc_backend_t *sys_check_cpu_replay_backend (proc_replay_t *replay);/* backend serving the trace's current snapshot */
+int sys_check_cpu_replay_next (proc_replay_t *replay);/* step the trace to its next snapshot */
+int sys_check_cpu_ctx_process_adaptive (cpu_ctx_t *ctx, const char *name, float tolerance, int max_interval,
+	proc_estimate_t *est);/* sys_check_cpu_process_adaptive on a context */
+int sys_check_cpu_process_adaptive (const char *name, float tolerance, int max_interval, proc_estimate_t *est);/* process usage, measured only as long as needed */
+int sys_check_cpu_ctx_proc_snapshot (cpu_ctx_t *ctx, const pid_t pids[], int num, proc_snapshot_t snap[], int interval);/* sys_check_cpu_proc_snapshot on a context */
+int sys_check_cpu_proc_snapshot (const pid_t pids[], int num, proc_snapshot_t snap[], int interval);/* usage, fault and switch rates, memory, threads of processes */
+int sys_check_cpu_alert_add (const alert_rule_t *rule, alert_cb_t cb, void *arg);/* register a threshold rule, evaluated by the sampler */
+int sys_check_cpu_alert_remove (int id);/* drop a threshold rule */
+int sys_check_cpu_alert_fd (void);/* eventfd readable while alert events are queued */
+int sys_check_cpu_alert_read (alert_event_t events[], int size);/* take the queued alert events */
+int sys_check_cpu_set_uring (int enable);/* read /proc/<pid> sweeps through pread (default) or io_uring */
+int sys_check_cpu_set_scan_workers (int workers);/* threads sharing a /proc sweep, 1 (default) keeps it serial */
+int sys_check_cpu_scan_stat (int kind, scan_stat_t *stat);/* size and wall time of the last /proc sweep */
+int sys_check_cpu_ctx_process_measure (cpu_ctx_t *ctx, const char *name, int interval, proc_measure_t *measure);/* sys_check_cpu_process_measure on a context */
+int sys_check_cpu_process_measure (const char *name, int interval, proc_measure_t *measure);/* process usage with the read times and scan time of both samples */
+int sys_check_cpu_ctx_topology (cpu_ctx_t *ctx, cpu_topo_t *topo);/* sys_check_cpu_topology on a context */
+int sys_check_cpu_topology (cpu_topo_t *topo);/* online, affinity, cpuset and available cpu counts */
 
 #endif
@@ -0,0 +1,664 @@
+/*************************************************
+File name: sys_check_cpu_bench.c
+Description: benchmark of every /proc parsing and sampling path. Sleeps are
+	compiled out (usleep is a no-op here), so only cpu cost is measured.
+	Every case reports ns/op, syscalls/op and allocs/op:
+	- syscalls are the open/openat/read/pread/close/opendir/closedir calls
+	  and raw syscall()s (io_uring_enter) made by the code under test; fopen
+	  is counted as open plus one buffer fill, the getdents batches behind
+	  readdir and the work of io_uring's kernel workers are not counted
+	- allocs are every malloc/calloc/realloc of the process, libc's own
+	  (fopen, opendir) included
+	Fixture cases parse recorded /proc text held in memory, so they do not
+	depend on the machine; -r records the live files of this machine as a
+	fixture directory and -f replays one. -t runs the /proc walking cases
+	once more on a trace of sys_check_cpu_snapshot_record, looking up -n.
+	The /proc sweeps run once with io_uring batches, once with pread and
+	once split across -w scan workers.
+	The old fopen/fgets/strtok/atof parsers are kept here as the reference.
+
+build: gcc -O2 -o sys_check_cpu_bench sys_check_cpu_bench.c -lpthread
+usage: sys_check_cpu_bench [-l loop] [-c children] [-w workers] [-f fixture_dir] [-r record_dir] [-t trace [-n name]]
+*************************************************/
+
+#define SYS_CHECK_CPU_NO_MAIN
+
+/* every header sys_check_cpu.c needs, included before the counting macros
+ * below so the macros only rename calls of the code under test */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+#include <linux/genetlink.h>
+#include <linux/taskstats.h>
+#include <linux/io_uring.h>
+
+#define BENCH_DEFAULT_LOOP 20000
+#define BENCH_DEFAULT_CHILDREN 2000 /* extra processes that make /proc "large" */
+#define BENCH_DEFAULT_WORKERS 4 /* scan workers of the parallel sweep cases */
+#define BENCH_FIXTURE_SIZE 65536
+
+static unsigned long long g_bench_syscalls = 0; /* calls that enter the kernel, see the file comment */
+static unsigned long long g_bench_allocs = 0; /* malloc/calloc/realloc of the whole process */
+static int g_bench_workers = BENCH_DEFAULT_WORKERS; /* -w */
+
+/* allocations are counted by interposing the allocator, libc's own calls included */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t num, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+	__atomic_add_fetch(&g_bench_allocs, 1, __ATOMIC_RELAXED);
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t num, size_t size)
+{
+	__atomic_add_fetch(&g_bench_allocs, 1, __ATOMIC_RELAXED);
+	return __libc_calloc(num, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	__atomic_add_fetch(&g_bench_allocs, 1, __ATOMIC_RELAXED);
+	return __libc_realloc(ptr, size);
+}
+
+static int bench_open(const char *path, int flags, ...)
+{
+	va_list ap;
+	int mode = 0;
+
+	if (flags & O_CREAT)
+	{
+		va_start(ap, flags);
+		mode = va_arg(ap, int);
+		va_end(ap);
+	}
+	__atomic_add_fetch(&g_bench_syscalls, 1, __ATOMIC_RELAXED);
+	return open(path, flags, mode);
+}
+
+static int bench_openat(int dir, const char *path, int flags, ...)
+{
+	va_list ap;
+	int mode = 0;
+
+	if (flags & O_CREAT)
+	{
+		va_start(ap, flags);
+		mode = va_arg(ap, int);
+		va_end(ap);
+	}
+	__atomic_add_fetch(&g_bench_syscalls, 1, __ATOMIC_RELAXED);
+	return openat(dir, path, flags, mode);
+}
+
+static long bench_syscall(long nr, ...)
+{
+	va_list ap;
+	long a[6];
+	int i;
+
+	va_start(ap, nr);
+	for (i = 0; i < 6; i++)
+		a[i] = va_arg(ap, long);
+	va_end(ap);
+	__atomic_add_fetch(&g_bench_syscalls, 1, __ATOMIC_RELAXED);
+	return syscall(nr, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+static ssize_t bench_read(int fd, void *buf, size_t size)
+{
+	__atomic_add_fetch(&g_bench_syscalls, 1, __ATOMIC_RELAXED);
+	return read(fd, buf, size);
+}
+
+static ssize_t bench_pread(int fd, void *buf, size_t size, off_t off)
+{
+	__atomic_add_fetch(&g_bench_syscalls, 1, __ATOMIC_RELAXED);
+	return pread(fd, buf, size, off);
+}
+
+static int bench_close(int fd)
+{
+	__atomic_add_fetch(&g_bench_syscalls, 1, __ATOMIC_RELAXED);
+	return close(fd);
+}
+
+static DIR *bench_opendir(const char *path)
+{
+	__atomic_add_fetch(&g_bench_syscalls, 1, __ATOMIC_RELAXED);
+	return opendir(path);
+}
+
+static int bench_closedir(DIR *dir)
+{
+	__atomic_add_fetch(&g_bench_syscalls, 1, __ATOMIC_RELAXED);
+	return closedir(dir);
+}
+
+static FILE *bench_fopen(const char *path, const char *mode)
+{
+	__atomic_add_fetch(&g_bench_syscalls, 2, __ATOMIC_RELAXED); /* open and the first buffer fill */
+	return fopen(path, mode);
+}
+
+static int bench_fclose(FILE *f)
+{
+	__atomic_add_fetch(&g_bench_syscalls, 1, __ATOMIC_RELAXED);
+	return fclose(f);
+}
+
+static int bench_usleep(useconds_t us)
+{
+	(void)us; /* sleeps are not part of the cost */
+	return 0;
+}
+
+#define open bench_open
+#define openat bench_openat
+#define syscall bench_syscall
+#define read bench_read
+#define pread bench_pread
+#define close bench_close
+#define opendir bench_opendir
+#define closedir bench_closedir
+#define fopen bench_fopen
+#define fclose bench_fclose
+#define usleep bench_usleep
+
+#include "sys_check_cpu.c"
+
+/* recorded /proc text, replaced by -f */
+static char g_fix_loadavg[BENCH_FIXTURE_SIZE] = "0.52 0.58 0.59 3/734 56789\n";
+static char g_fix_pidstat[BENCH_FIXTURE_SIZE] =
+	"4242 (kworker (odd) name) S 1 4242 4242 0 -1 4194560 182734 9823 12 0 150213 75122 "
+	"33 19 20 0 17 0 9876 1234567168 23456 18446744073709551615 94392135647232 "
+	"94392135701221 140724783361056 0 0 0 0 4096 17003 0 0 0 17 3 0 0 12 0 0 "
+	"94392135721808 94392135723520 94392158015488 140724783364834 140724783364855 "
+	"140724783364855 140724783366121 0\n";
+static char g_fix_stat_small[BENCH_FIXTURE_SIZE]; /* 4 cpus, built by fixture_build_stat */
+static char g_fix_stat_large[BENCH_FIXTURE_SIZE]; /* 128 cpus */
+
+typedef struct bench_mark_t
+{
+	unsigned long long ns;
+	unsigned long long syscalls;
+	unsigned long long allocs;
+} bench_mark_t;
+
+/* stdio parsers as they were before the pread rewrite */
+static int old_parse_loadavg(float cpuloadavg[CPU_LOADAVG_MAX])
+{
+	char buf[60];
+	FILE *f;
+	int i = 0;
+
+	memset(cpuloadavg, 0, sizeof(cpuloadavg[0]) * CPU_LOADAVG_MAX);
+	if (NULL == (f = fopen("/proc/loadavg","r")))
+		return -1;
+	while (fgets(buf, sizeof(buf), f) != NULL)
+	{
+		char *tmp = buf;
+		char *p;
+		while ((p = strtok(tmp, " ")) != NULL && i < CPU_LOADAVG_MAX)
+		{
+			cpuloadavg[i++] = atof(p);
+			tmp = NULL;
+		}
+	}
+	fclose(f);
+	return 0;
+}
+
+static int old_get_jiffy_counts(jiffy_counts_t *p_jif)
+{
+	char line[MAX_BUF_SIZE];
+	FILE *fp;
+	int ret;
+
+	if (NULL == (fp = fopen("/proc/stat","r")))
+		return -1;
+	if (!fgets(line, sizeof(line), fp))
+	{
+		fclose(fp);
+		return -1;
+	}
+	ret = sscanf(line, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+			&p_jif->usr, &p_jif->nic, &p_jif->sys, &p_jif->idle,
+			&p_jif->iowait, &p_jif->irq, &p_jif->softirq,
+			&p_jif->steal);
+	fclose(fp);
+	return ret >= 4 ? 0 : -1;
+}
+
+static int old_parse_pidstat(pid_t pid, unsigned long long pid_cpu_stat[PID_STAT_MAX])
+{
+	char buf[600];
+	char path[200];
+	FILE *f;
+	int i = 0;
+
+	memset(pid_cpu_stat, 0, sizeof(pid_cpu_stat[0]) * PID_STAT_MAX);
+	snprintf(path, sizeof(path), "%s%u%s","/proc/", pid, "/stat");
+	if (NULL == (f = fopen(path, "r")))
+		return -1;
+	while (fgets(buf, sizeof(buf), f) != NULL)
+	{
+		char *tmp = buf;
+		char *p;
+		while ((p = strtok(tmp, " ")) != NULL && i < PID_STAT_MAX)
+		{
+			pid_cpu_stat[i++] = atof(p);
+			tmp = NULL;
+		}
+	}
+	fclose(f);
+	return 0;
+}
+
+static unsigned long long bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void bench_begin(bench_mark_t *m)
+{
+	m->syscalls = g_bench_syscalls;
+	m->allocs = g_bench_allocs;
+	m->ns = bench_now_ns();
+}
+
+static void bench_end(const char *name, const bench_mark_t *m, int loop)
+{
+	unsigned long long ns = bench_now_ns() - m->ns;
+
+	printf("%-34s %12.0f %12.2f %10.2f\n", name, (double)ns / loop,
+		(double)(g_bench_syscalls - m->syscalls) / loop,
+		(double)(g_bench_allocs - m->allocs) / loop);
+}
+
+/*************************************************
+Function: fixture_build_stat
+Description: write a /proc/stat text with ncpu cpu lines and the usual tail
+Input:
+	int ncpu
+	int size---size of buf
+Output: char *buf
+*************************************************/
+static void fixture_build_stat(char *buf, int size, int ncpu)
+{
+	int n;
+	int i;
+
+	n = snprintf(buf, size, "cpu  %d 120 %d %d 3021 0 877 0 0 0\n",
+		ncpu * 10231, ncpu * 4021, ncpu * 912345);
+	for (i = 0; i < ncpu && n < size; i++)
+		n += snprintf(buf + n, size - n, "cpu%d 10231 1 4021 912345 %d 0 %d 0 0 0\n", i, 23 + i, 7 * i);
+	if (n < size)
+		n += snprintf(buf + n, size - n, "intr 182736412 9 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0\n"
+			"ctxt 372619283\nbtime 1439971200\nprocesses 1823746\nprocs_running 3\nprocs_blocked 0\n"
+			"softirq 91827364 0 1827364 0 82736 0 0 1 92837 0 827364\n");
+}
+
+/*************************************************
+Function: fixture_file
+Description: load or store one fixture file of a fixture directory
+Input:
+	const char *dir
+	const char *name---file name inside dir
+	int save---1 copies from src, 0 loads into buf
+	const char *src---live file to record
+	int size---size of buf
+Output: char *buf
+Return:
+	0   function run success
+	-1  function run error
+*************************************************/
+static int fixture_file(const char *dir, const char *name, int save, const char *src, char *buf, int size)
+{
+	char path[512];
+	FILE *f;
+	int n;
+
+	if (save && read_small_file(src, buf, size) < 0)
+		return -1;
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	f = fopen(path, save ? "w" : "r");
+	if (f == NULL)
+	{
+		printf("can't %s %s because:%s\n", save ? "write" : "read", path, strerror(errno));
+		return -1;
+	}
+	if (save)
+		fputs(buf, f);
+	else
+	{
+		n = fread(buf, 1, size - 1, f);
+		buf[n] = '\0';
+	}
+	fclose(f);
+	return 0;
+}
+
+/*************************************************
+Function: fixture_io
+Description: record the live /proc files into dir, or replace the built-in
+	fixtures by a recorded dir. The large /proc/stat fixture is always built.
+Input:
+	const char *dir
+	int save---1 records, 0 loads
+Return:
+	0   function run success
+	-1  function run error
+*************************************************/
+static int fixture_io(const char *dir, int save)
+{
+	if (fixture_file(dir, "loadavg", save, "/proc/loadavg", g_fix_loadavg, sizeof(g_fix_loadavg)) < 0
+		|| fixture_file(dir, "stat", save, "/proc/stat", g_fix_stat_small, sizeof(g_fix_stat_small)) < 0
+		|| fixture_file(dir, "pid_stat", save, "/proc/self/stat", g_fix_pidstat, sizeof(g_fix_pidstat)) < 0)
+		return -1;
+	return 0;
+}
+
+/*************************************************
+Function: parse_stat_text
+Description: the parsing half of get_jiffy_counts_percpu on a fixture
+Input: const char *buf---/proc/stat text
+Output: jiffy_counts_t cpu[]---room for 256 cores
+Return: cores found
+*************************************************/
+static int parse_stat_text(const char *buf, jiffy_counts_t *total, jiffy_counts_t cpu[])
+{
+	const char *p = buf;
+	int n = 0;
+
+	if (read_cpu_jiffy(&p, total) < 4)
+		return -1;
+	while (n < 256 && read_cpu_jiffy(&p, &cpu[n]) >= 4)
+		n++;
+	return n;
+}
+
+/*************************************************
+Function: bench_spawn
+Description: fork children that only wait, so /proc holds that many more pids
+Input: int num
+Output: pid_t pids[]
+Return: children started
+*************************************************/
+static int bench_spawn(pid_t pids[], int num)
+{
+	int i;
+
+	for (i = 0; i < num; i++)
+	{
+		pids[i] = fork();
+		if (pids[i] < 0)
+			break;
+		if (pids[i] == 0)
+		{
+			pause();
+			_exit(0);
+		}
+	}
+	return i;
+}
+
+static void bench_reap(pid_t pids[], int num)
+{
+	int i;
+
+	for (i = 0; i < num; i++)
+		kill(pids[i], SIGKILL);
+	for (i = 0; i < num; i++)
+		waitpid(pids[i], NULL, 0);
+}
+
+/*************************************************
+Function: bench_proc_walks
+Description: the /proc walking cases, run once on the normal /proc, once
+	more with extra children and on a replayed trace
+Input:
+	const char *tag---"small", "large" or "trace"
+	const char *self---name looked up, its pids feed the batch case
+	int heavy---loop count of the walking cases
+*************************************************/
+static void bench_proc_walks(const char *tag, const char *self, int heavy)
+{
+	char name[64];
+	pid_t pid_list[MAX_PID_NUM];
+	pid_t pids[16];
+	proc_usage_t pid_usage[16];
+	proc_top_t top[10];
+	bench_mark_t m;
+	float usage;
+	int num;
+	int i;
+	int uring;
+
+	get_pid_by_name(self, pid_list, MAX_PID_NUM); /* index current, new pids verified */
+	num = get_pid_by_name(self, pid_list, MAX_PID_NUM);
+	snprintf(name, sizeof(name), "get_pid_by_name %s warm", tag);
+	bench_begin(&m);
+	for (i = 0; i < heavy; i++)
+		get_pid_by_name(self, pid_list, MAX_PID_NUM);
+	bench_end(name, &m, heavy);
+
+	for (uring = 1; uring >= 0; uring--)
+	{
+		sys_check_cpu_set_uring(uring);
+		g_pid_index_num = 0;
+		get_pid_by_name(self, pid_list, MAX_PID_NUM); /* set the reader up before timing */
+		snprintf(name, sizeof(name), "get_pid_by_name %s cold %s", tag, uring ? "uring" : "pread");
+		bench_begin(&m);
+		for (i = 0; i < heavy; i++)
+		{
+			g_pid_index_num = 0; /* forget the index, every pid is read again */
+			get_pid_by_name(self, pid_list, MAX_PID_NUM);
+		}
+		bench_end(name, &m, heavy);
+	}
+	sys_check_cpu_set_uring(0);
+
+	snprintf(name, sizeof(name), "sys_check_cpu_process %s", tag);
+	bench_begin(&m);
+	for (i = 0; i < heavy; i++)
+		sys_check_cpu_process((char *)self, &usage, 1);
+	bench_end(name, &m, heavy);
+
+	for (i = 0; i < 16; i++)
+		pids[i] = num > 0 ? pid_list[i % num] : getpid();
+	snprintf(name, sizeof(name), "process_batch 16 pids %s", tag);
+	bench_begin(&m);
+	for (i = 0; i < heavy; i++)
+		sys_check_cpu_process_batch(NULL, 0, pids, 16, pid_usage, 16, NULL, 1);
+	bench_end(name, &m, heavy);
+
+	for (uring = 1; uring >= 0; uring--)
+	{
+		sys_check_cpu_set_uring(uring);
+		sys_check_cpu_ctx_top(&g_default_ctx, top, 10); /* files opened before timing */
+		snprintf(name, sizeof(name), "ctx_top 10 %s %s", tag, uring ? "uring" : "pread");
+		bench_begin(&m);
+		for (i = 0; i < heavy; i++)
+			sys_check_cpu_ctx_top(&g_default_ctx, top, 10);
+		bench_end(name, &m, heavy);
+	}
+	sys_check_cpu_set_uring(0);
+
+	if (sys_check_cpu_set_scan_workers(g_bench_workers) < 0)
+		return;
+	snprintf(name, sizeof(name), "get_pid_by_name %s cold %dw", tag, g_bench_workers);
+	bench_begin(&m);
+	for (i = 0; i < heavy; i++)
+	{
+		g_pid_index_num = 0;
+		get_pid_by_name(self, pid_list, MAX_PID_NUM);
+	}
+	bench_end(name, &m, heavy);
+	snprintf(name, sizeof(name), "ctx_top 10 %s %dw", tag, g_bench_workers);
+	bench_begin(&m);
+	for (i = 0; i < heavy; i++)
+		sys_check_cpu_ctx_top(&g_default_ctx, top, 10);
+	bench_end(name, &m, heavy);
+	sys_check_cpu_set_scan_workers(1);
+}
+
+int main(int argc, char *argv[])
+{
+	int loop = BENCH_DEFAULT_LOOP;
+	int children = BENCH_DEFAULT_CHILDREN;
+	const char *fixture = NULL;
+	const char *record = NULL;
+	const char *trace = NULL;
+	const char *self = get_basename(argv[0]);
+	const char *name = NULL;
+	proc_replay_t *replay;
+	int heavy;
+	int opt;
+	int i;
+	bench_mark_t m;
+	float cpuloadavg[CPU_LOADAVG_MAX];
+	jiffy_counts_t jif;
+	jiffy_counts_t *cpu;
+	unsigned long long pid_cpu_stat[PID_STAT_MAX];
+	pid_t *kids;
+	int kid_num;
+	pid_t me = getpid();
+
+	while ((opt = getopt(argc, argv, "l:c:w:f:r:t:n:h")) != -1)
+	{
+		switch (opt)
+		{
+		case 'l': loop = atoi(optarg); break;
+		case 'c': children = atoi(optarg); break;
+		case 'w': g_bench_workers = atoi(optarg); break;
+		case 'f': fixture = optarg; break;
+		case 'r': record = optarg; break;
+		case 't': trace = optarg; break;
+		case 'n': name = optarg; break;
+		default:
+			printf("usage: %s [-l loop] [-c children] [-w workers] [-f fixture_dir] [-r record_dir] [-t trace [-n name]]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (loop <= 0)
+		loop = BENCH_DEFAULT_LOOP;
+	if (children < 0)
+		children = 0;
+	heavy = loop / 200 > 10 ? loop / 200 : 10;
+
+	fixture_build_stat(g_fix_stat_small, sizeof(g_fix_stat_small), 4);
+	fixture_build_stat(g_fix_stat_large, sizeof(g_fix_stat_large), 128);
+	if (record != NULL)
+		return fixture_io(record, 1) < 0 ? 1 : 0;
+	if (fixture != NULL && fixture_io(fixture, 0) < 0)
+		return 1;
+	cpu = calloc(256, sizeof(cpu[0]));
+	kids = calloc(children ? children : 1, sizeof(kids[0]));
+	if (cpu == NULL || kids == NULL)
+		return 1;
+
+	/* open the persistent descriptors before timing */
+	parse_loadavg(&g_default_ctx, cpuloadavg);
+	get_jiffy_counts_percpu(&g_default_ctx, &jif);
+
+	printf("%-34s %12s %12s %10s\n", "case", "ns/op", "syscalls/op", "allocs/op");
+	bench_begin(&m);
+	for (i = 0; i < loop; i++)
+		parse_loadavg_buf(&g_default_ctx, g_fix_loadavg, cpuloadavg);
+	bench_end("loadavg fixture", &m, loop);
+	bench_begin(&m);
+	for (i = 0; i < loop; i++)
+		parse_stat_text(g_fix_stat_small, &jif, cpu);
+	bench_end("stat fixture 4 cpus", &m, loop);
+	bench_begin(&m);
+	for (i = 0; i < loop; i++)
+		parse_stat_text(g_fix_stat_large, &jif, cpu);
+	bench_end("stat fixture 128 cpus", &m, loop);
+	bench_begin(&m);
+	for (i = 0; i < loop; i++)
+		parse_pidstat_buf(g_fix_pidstat, pid_cpu_stat);
+	bench_end("pid stat fixture", &m, loop);
+
+	bench_begin(&m);
+	for (i = 0; i < loop; i++)
+		old_parse_loadavg(cpuloadavg);
+	bench_end("parse_loadavg old stdio", &m, loop);
+	bench_begin(&m);
+	for (i = 0; i < loop; i++)
+		parse_loadavg(&g_default_ctx, cpuloadavg);
+	bench_end("parse_loadavg", &m, loop);
+
+	bench_begin(&m);
+	for (i = 0; i < loop; i++)
+		old_get_jiffy_counts(&jif);
+	bench_end("read_cpu_jiffy old stdio", &m, loop);
+	bench_begin(&m);
+	for (i = 0; i < loop; i++)
+		get_jiffy_counts(&g_default_ctx, &jif);
+	bench_end("read_cpu_jiffy first line", &m, loop);
+	bench_begin(&m);
+	for (i = 0; i < loop; i++)
+		get_jiffy_counts_percpu(&g_default_ctx, &jif);
+	bench_end("read_cpu_jiffy all cpus", &m, loop);
+
+	bench_begin(&m);
+	for (i = 0; i < loop; i++)
+		old_parse_pidstat(me, pid_cpu_stat);
+	bench_end("parse_pidstat old stdio", &m, loop);
+	bench_begin(&m);
+	for (i = 0; i < loop; i++)
+		parse_pidstat(me, pid_cpu_stat);
+	bench_end("parse_pidstat", &m, loop);
+
+	bench_proc_walks("small", self, heavy);
+	kid_num = bench_spawn(kids, children);
+	if (kid_num > 0)
+	{
+		bench_proc_walks("large", self, heavy);
+		bench_reap(kids, kid_num);
+	}
+	printf("large /proc had %d extra processes\n", kid_num);
+	if (trace != NULL)
+	{
+		replay = sys_check_cpu_replay_open(trace);
+		if (replay == NULL || sys_check_cpu_set_proc_backend(sys_check_cpu_replay_backend(replay)) < 0)
+			return 1;
+		bench_proc_walks("trace", name != NULL ? name : self, heavy);
+		sys_check_cpu_replay_close(replay);
+	}
+	free(kids);
+	free(cpu);
+	return 0;
+}
@@ -0,0 +1,817 @@
+/*************************************************
+File name: sys_check_cpu_exporter.c
+Description: long running metrics daemon on top of sys_check_cpu. It samples
+	on its own period and renders every output once per sample into buffers
+	allocated at start, then serves them over HTTP on a Unix socket and/or
+	127.0.0.1:<port>. A scrape only copies a ready buffer to its socket, it
+	never reads /proc and never allocates.
+
+	GET /metrics      Prometheus text format 0.0.4
+	GET /metrics.bin  compact binary snapshot, all integers are LEB128 varints:
+		"SCC" version(1 byte) varint(unix time ms) varint(series count)
+		then per series: varint(metric id) varint(index) varint(zigzag(value * 1000))
+		metric ids are the EXP_* enum below; index is cpu + 1 (0 is all cpus),
+		the PSI resource or the pid
+
+build: gcc -O2 -DSYS_CHECK_CPU_NO_MAIN -o sys_check_cpu_exporter sys_check_cpu_exporter.c sys_check_cpu.c -lpthread
+usage: sys_check_cpu_exporter [-p period_us] [-l port] [-u unix_path] [-n top_n] [-b buffer_kb]
+*************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "sys_check_cpu.h"
+
+/* define area */
+#define EXP_DEFAULT_PORT 9117 /* HTTP port on 127.0.0.1, 0 turns it off */
+#define EXP_DEFAULT_TOP 10 /* busiest processes exported */
+#define EXP_DEFAULT_BUF_KB 4096 /* text buffer, about 50k series; binary gets a quarter */
+#define EXP_MAX_CLIENTS 64 /* scrapes served at the same time */
+#define EXP_REQ_SIZE 1024 /* request head kept per client */
+#define EXP_READ_TIMEOUT 5000 /* a client that sent no full request head by then is closed (unit:millisecond) */
+#define EXP_HDR_RESERVE 192 /* room in front of a body for the HTTP head and binary prefix */
+#define EXP_LABEL_SIZE 160 /* longest "name{labels}" of one series */
+
+/* enum area */
+/*  metric ids of the binary format, stable across versions */
+enum
+{
+	EXP_CPU_US = 1,
+	EXP_CPU_NI,
+	EXP_CPU_SY,
+	EXP_CPU_ID,
+	EXP_CPU_WA,
+	EXP_CPU_HI,
+	EXP_CPU_SI,
+	EXP_CPU_ST,
+	EXP_CPU_GU,
+	EXP_CPU_GN,
+	EXP_CPU_BUSY,
+	EXP_LOAD_1MIN,
+	EXP_LOAD_5MIN,
+	EXP_LOAD_15MIN,
+	EXP_PROCS_RUNNING,
+	EXP_PROCS_TOTAL,
+	EXP_PSI_SOME_AVG10,
+	EXP_PSI_SOME_AVG60,
+	EXP_PSI_SOME_AVG300,
+	EXP_PSI_SOME_TOTAL,
+	EXP_PSI_FULL_AVG10,
+	EXP_PSI_FULL_AVG60,
+	EXP_PSI_FULL_AVG300,
+	EXP_PSI_FULL_TOTAL,
+	EXP_PROC_CPU,
+	EXP_SAMPLE_SECONDS,
+	EXP_TRUNCATED
+};
+
+/*  state of one client connection */
+enum
+{
+	CLIENT_FREE = 0,
+	CLIENT_READ, /* waiting for the request head */
+	CLIENT_WRITE /* sending a response */
+};
+
+/* struct area */
+/*  one rendered output, body starts at EXP_HDR_RESERVE, the head is put right before it */
+typedef struct exp_out_t
+{
+	char *buf;
+	int size; /* allocated bytes */
+	int len; /* body bytes */
+	int start; /* first byte of the response in buf */
+	int series; /* series in the body */
+	int overflow; /* series dropped because buf is full */
+} exp_out_t;
+
+/*  one generation of every output, 2 of them are swapped */
+typedef struct exp_gen_t
+{
+	exp_out_t text;
+	exp_out_t bin;
+	int refs; /* clients still sending from this generation */
+} exp_gen_t;
+
+typedef struct exp_client_t
+{
+	int fd;
+	int state;
+	int gen; /* generation being sent, -1 for a static response */
+	const char *out;
+	int out_len;
+	int out_off;
+	int req_len;
+	unsigned long long deadline; /* CLOCK_MONOTONIC when a CLIENT_READ client is closed (unit:nanosecond) */
+	char req[EXP_REQ_SIZE];
+} exp_client_t;
+
+/* global area */
+static volatile sig_atomic_t g_exp_stop = 0; /* set by SIGINT/SIGTERM */
+static exp_gen_t g_gen[2];
+static int g_front = -1; /* generation scrapes get, -1 before the first sample */
+static exp_client_t g_client[EXP_MAX_CLIENTS];
+
+static const char g_resp_404[] = "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\n"
+	"Content-Length: 10\r\nConnection: close\r\n\r\nnot found\n";
+static const char g_resp_503[] = "HTTP/1.1 503 Service Unavailable\r\nContent-Type: text/plain\r\n"
+	"Content-Length: 12\r\nConnection: close\r\n\r\nno data yet\n";
+
+static void exp_on_signal(int sig)
+{
+	(void)sig;
+	g_exp_stop = 1;
+}
+
+static unsigned long long exp_now_ns(int clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*************************************************
+Function: out_printf
+Description: append text to an output body, nothing is written when it does not fit
+Input:
+	exp_out_t *o
+	const char *fmt---printf format
+Output:
+Return:
+	0   appended
+	-1  buffer full
+*************************************************/
+static int out_printf(exp_out_t *o, const char *fmt, ...)
+{
+	va_list ap;
+	int room = o->size - EXP_HDR_RESERVE - o->len;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(o->buf + EXP_HDR_RESERVE + o->len, room, fmt, ap);
+	va_end(ap);
+	if (n < 0 || n >= room)
+		return -1;
+	o->len += n;
+	return 0;
+}
+
+static int put_varint(unsigned char *p, unsigned long long v)
+{
+	int n = 0;
+
+	while (v >= 0x80)
+	{
+		p[n++] = (unsigned char)(v | 0x80);
+		v >>= 7;
+	}
+	p[n++] = (unsigned char)v;
+	return n;
+}
+
+/*************************************************
+Function: out_varints
+Description: append one binary series record to an output body
+Input:
+	exp_out_t *o
+	int id---EXP_* metric id
+	unsigned long long index---cpu + 1, resource or pid
+	double value---stored as zigzag(value * 1000)
+Output:
+Return:
+	0   appended
+	-1  buffer full
+*************************************************/
+static int out_varints(exp_out_t *o, int id, unsigned long long index, double value)
+{
+	unsigned char *p = (unsigned char *)o->buf + EXP_HDR_RESERVE + o->len;
+	long long milli = (long long)(value * 1000 + (value < 0 ? -0.5 : 0.5));
+	int n;
+
+	if (o->size - EXP_HDR_RESERVE - o->len < 30)
+		return -1;
+	n = put_varint(p, id);
+	n += put_varint(p + n, index);
+	n += put_varint(p + n, ((unsigned long long)milli << 1) ^ (unsigned long long)(milli >> 63));
+	o->len += n;
+	return 0;
+}
+
+/*************************************************
+Function: emit_family
+Description: write the HELP and TYPE lines of a metric family
+Input:
+	exp_gen_t *g
+	const char *name---family name
+	const char *type---gauge or counter
+	const char *help---one line description
+Output:
+*************************************************/
+static void emit_family(exp_gen_t *g, const char *name, const char *type, const char *help)
+{
+	if (out_printf(&g->text, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type) < 0)
+		g->text.overflow++;
+}
+
+/*************************************************
+Function: emit_series
+Description: write one series into both outputs of a generation
+Input:
+	exp_gen_t *g
+	int id---EXP_* metric id
+	unsigned long long index---binary index
+	const char *key---"name{labels}" of the text line
+	double value
+Output:
+*************************************************/
+static void emit_series(exp_gen_t *g, int id, unsigned long long index, const char *key, double value)
+{
+	if (out_printf(&g->text, "%s %.3f\n", key, value) < 0)
+		g->text.overflow++;
+	else
+		g->text.series++;
+	if (out_varints(&g->bin, id, index, value) < 0)
+		g->bin.overflow++;
+	else
+		g->bin.series++;
+}
+
+/*************************************************
+Function: escape_label
+Description: escape a label value for the text format (\\ \" \n)
+Input:
+	const char *s---raw value
+	int size---size of out
+Output: char *out
+*************************************************/
+static void escape_label(const char *s, char *out, int size)
+{
+	int n = 0;
+
+	for (; *s && n < size - 2; s++)
+	{
+		if (*s == '\\' || *s == '"')
+			out[n++] = '\\';
+		else if (*s == '\n')
+		{
+			out[n++] = '\\';
+			out[n++] = 'n';
+			continue;
+		}
+		out[n++] = *s;
+	}
+	out[n] = '\0';
+}
+
+/*************************************************
+Function: emit_cpu
+Description: write every mode of one cpu_usage_t
+Input:
+	exp_gen_t *g
+	const char *cpu---cpu label value, "all" for the whole system
+	unsigned index---binary index, cpu + 1 or 0
+	const cpu_usage_t *u
+Output:
+*************************************************/
+static void emit_cpu(exp_gen_t *g, const char *cpu, unsigned index, const cpu_usage_t *u)
+{
+	static const char *mode[] = { "user", "nice", "system", "idle", "iowait",
+		"irq", "softirq", "steal", "guest", "guest_nice" };
+	float val[10];
+	char key[EXP_LABEL_SIZE];
+	int i;
+
+	val[0] = u->cpu_us;
+	val[1] = u->cpu_ni;
+	val[2] = u->cpu_sy;
+	val[3] = u->cpu_id;
+	val[4] = u->cpu_wa;
+	val[5] = u->cpu_hi;
+	val[6] = u->cpu_si;
+	val[7] = u->cpu_st;
+	val[8] = u->cpu_gu;
+	val[9] = u->cpu_gn;
+	for (i = 0; i < 10; i++)
+	{
+		snprintf(key, sizeof(key), "sys_cpu_usage_percent{cpu=\"%s\",mode=\"%s\"}", cpu, mode[i]);
+		emit_series(g, EXP_CPU_US + i, index, key, val[i]);
+	}
+}
+
+/*************************************************
+Function: exp_finish
+Description: put the binary prefix and the HTTP heads in front of the bodies
+Input: exp_gen_t *g
+Output:
+*************************************************/
+static void exp_finish(exp_gen_t *g)
+{
+	char head[EXP_HDR_RESERVE];
+	unsigned char prefix[32];
+	int plen;
+	int hlen;
+
+	prefix[0] = 'S';
+	prefix[1] = 'C';
+	prefix[2] = 'C';
+	prefix[3] = 1;
+	plen = 4 + put_varint(prefix + 4, exp_now_ns(CLOCK_REALTIME) / 1000000);
+	plen += put_varint(prefix + plen, g->bin.series);
+	memcpy(g->bin.buf + EXP_HDR_RESERVE - plen, prefix, plen);
+
+	hlen = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n"
+		"Content-Length: %d\r\nConnection: close\r\n\r\n", g->bin.len + plen);
+	g->bin.start = EXP_HDR_RESERVE - plen - hlen;
+	memcpy(g->bin.buf + g->bin.start, head, hlen);
+
+	hlen = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+		"Content-Length: %d\r\nConnection: close\r\n\r\n", g->text.len);
+	g->text.start = EXP_HDR_RESERVE - hlen;
+	memcpy(g->text.buf + g->text.start, head, hlen);
+}
+
+/*************************************************
+Function: exp_render
+Description: take one sample on ctx and render it into generation g
+Calls:
+	int sys_check_cpu_ctx_sample (cpu_ctx_t *ctx)
+	int sys_check_cpu_ctx_usage (cpu_ctx_t *ctx, cpu_usage_t *usage)
+	int sys_check_cpu_ctx_usage_percpu (cpu_ctx_t *ctx, cpu_usage_t usage[], int size)
+	int sys_check_cpu_ctx_load (cpu_ctx_t *ctx, proc_load_t *load)
+	int sys_check_cpu_ctx_psi (cpu_ctx_t *ctx, int resource, psi_stat_t *stat)
+	int sys_check_cpu_ctx_top (cpu_ctx_t *ctx, proc_top_t top[], int n)
+Input:
+	cpu_ctx_t *ctx
+	exp_gen_t *g
+	cpu_usage_t percpu[]---scratch of ncpu entries
+	int ncpu
+	proc_top_t top[]---scratch of top_n entries
+	int top_n
+	int *use_psi---cleared when the kernel has no PSI
+Output:
+*************************************************/
+static void exp_render(cpu_ctx_t *ctx, exp_gen_t *g, cpu_usage_t percpu[], int ncpu,
+		proc_top_t top[], int top_n, int *use_psi)
+{
+	static const char *res_name[PSI_RESOURCE_MAX] = { "cpu", "io", "memory" };
+	unsigned long long t0 = exp_now_ns(CLOCK_MONOTONIC);
+	cpu_usage_t usage;
+	proc_load_t load;
+	psi_stat_t psi[PSI_RESOURCE_MAX];
+	char key[EXP_LABEL_SIZE];
+	char name[40];
+	int n = 0;
+	int i;
+
+	g->text.len = g->bin.len = 0;
+	g->text.series = g->bin.series = 0;
+	g->text.overflow = g->bin.overflow = 0;
+
+	if (sys_check_cpu_ctx_sample(ctx) == 0 && sys_check_cpu_ctx_usage(ctx, &usage) == 0)
+	{
+		n = sys_check_cpu_ctx_usage_percpu(ctx, percpu, ncpu);
+		if (n > ncpu)
+			n = ncpu;
+		emit_family(g, "sys_cpu_usage_percent", "gauge", "share of cpu time by mode over the last period");
+		emit_cpu(g, "all", 0, &usage);
+		for (i = 0; i < n; i++)
+		{
+			snprintf(name, sizeof(name), "%d", i);
+			emit_cpu(g, name, i + 1, &percpu[i]);
+		}
+		emit_family(g, "sys_cpu_busy_percent", "gauge", "non idle cpu time over the last period");
+		emit_series(g, EXP_CPU_BUSY, 0, "sys_cpu_busy_percent{cpu=\"all\"}", usage.cpu_total);
+		for (i = 0; i < n; i++)
+		{
+			snprintf(key, sizeof(key), "sys_cpu_busy_percent{cpu=\"%d\"}", i);
+			emit_series(g, EXP_CPU_BUSY, i + 1, key, percpu[i].cpu_total);
+		}
+	}
+
+	if (sys_check_cpu_ctx_load(ctx, &load) == 0)
+	{
+		emit_family(g, "sys_load1", "gauge", "1 minute load average");
+		emit_series(g, EXP_LOAD_1MIN, 0, "sys_load1", load.cpu_load_1min);
+		emit_family(g, "sys_load5", "gauge", "5 minute load average");
+		emit_series(g, EXP_LOAD_5MIN, 0, "sys_load5", load.cpu_load_5min);
+		emit_family(g, "sys_load15", "gauge", "15 minute load average");
+		emit_series(g, EXP_LOAD_15MIN, 0, "sys_load15", load.cpu_load_15min);
+		emit_family(g, "sys_procs_running", "gauge", "runnable tasks");
+		emit_series(g, EXP_PROCS_RUNNING, 0, "sys_procs_running", load.running);
+		emit_family(g, "sys_procs_total", "gauge", "all tasks");
+		emit_series(g, EXP_PROCS_TOTAL, 0, "sys_procs_total", load.total_tasks);
+	}
+
+	if (*use_psi)
+	{
+		for (i = 0; i < PSI_RESOURCE_MAX; i++)
+		{
+			if (sys_check_cpu_ctx_psi(ctx, i, &psi[i]) == -ENOENT)
+			{
+				*use_psi = 0;
+				break;
+			}
+		}
+	}
+	if (*use_psi)
+	{
+		emit_family(g, "sys_pressure_avg_percent", "gauge", "share of time tasks stalled on a resource");
+		for (i = 0; i < PSI_RESOURCE_MAX; i++)
+		{
+			snprintf(key, sizeof(key), "sys_pressure_avg_percent{resource=\"%s\",kind=\"some\",window=\"10s\"}", res_name[i]);
+			emit_series(g, EXP_PSI_SOME_AVG10, i, key, psi[i].some.avg10);
+			snprintf(key, sizeof(key), "sys_pressure_avg_percent{resource=\"%s\",kind=\"some\",window=\"60s\"}", res_name[i]);
+			emit_series(g, EXP_PSI_SOME_AVG60, i, key, psi[i].some.avg60);
+			snprintf(key, sizeof(key), "sys_pressure_avg_percent{resource=\"%s\",kind=\"some\",window=\"300s\"}", res_name[i]);
+			emit_series(g, EXP_PSI_SOME_AVG300, i, key, psi[i].some.avg300);
+			snprintf(key, sizeof(key), "sys_pressure_avg_percent{resource=\"%s\",kind=\"full\",window=\"10s\"}", res_name[i]);
+			emit_series(g, EXP_PSI_FULL_AVG10, i, key, psi[i].full.avg10);
+			snprintf(key, sizeof(key), "sys_pressure_avg_percent{resource=\"%s\",kind=\"full\",window=\"60s\"}", res_name[i]);
+			emit_series(g, EXP_PSI_FULL_AVG60, i, key, psi[i].full.avg60);
+			snprintf(key, sizeof(key), "sys_pressure_avg_percent{resource=\"%s\",kind=\"full\",window=\"300s\"}", res_name[i]);
+			emit_series(g, EXP_PSI_FULL_AVG300, i, key, psi[i].full.avg300);
+		}
+		emit_family(g, "sys_pressure_stall_seconds_total", "counter", "time tasks stalled on a resource since boot");
+		for (i = 0; i < PSI_RESOURCE_MAX; i++)
+		{
+			snprintf(key, sizeof(key), "sys_pressure_stall_seconds_total{resource=\"%s\",kind=\"some\"}", res_name[i]);
+			emit_series(g, EXP_PSI_SOME_TOTAL, i, key, psi[i].some.total / 1e6);
+			snprintf(key, sizeof(key), "sys_pressure_stall_seconds_total{resource=\"%s\",kind=\"full\"}", res_name[i]);
+			emit_series(g, EXP_PSI_FULL_TOTAL, i, key, psi[i].full.total / 1e6);
+		}
+	}
+
+	if (top_n > 0)
+	{
+		n = sys_check_cpu_ctx_top(ctx, top, top_n);
+		emit_family(g, "sys_process_cpu_percent", "gauge", "busiest processes, 100 is one cpu");
+		for (i = 0; i < n; i++)
+		{
+			escape_label(top[i].name, name, sizeof(name));
+			snprintf(key, sizeof(key), "sys_process_cpu_percent{pid=\"%d\",name=\"%s\"}", (int)top[i].pid, name);
+			emit_series(g, EXP_PROC_CPU, top[i].pid, key, top[i].usage);
+		}
+	}
+
+	emit_family(g, "sys_check_cpu_exporter_sample_seconds", "gauge", "time taken by the last sample and render");
+	emit_series(g, EXP_SAMPLE_SECONDS, 0, "sys_check_cpu_exporter_sample_seconds",
+		(exp_now_ns(CLOCK_MONOTONIC) - t0) / 1e9);
+	emit_family(g, "sys_check_cpu_exporter_truncated", "gauge", "series dropped because the buffer is full");
+	emit_series(g, EXP_TRUNCATED, 0, "sys_check_cpu_exporter_truncated", g->text.overflow + g->bin.overflow);
+	exp_finish(g);
+}
+
+/*************************************************
+Function: exp_listen_unix
+Description: listen on a Unix stream socket, a stale socket file is replaced
+Input: const char *path
+Output:
+Return: listening fd, -1 on error
+*************************************************/
+static int exp_listen_unix(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+	{
+		printf("unix socket path %s is too long\n", path);
+		return -1;
+	}
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, EXP_MAX_CLIENTS) < 0)
+	{
+		printf("can't listen on %s because:%s\n", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/*************************************************
+Function: exp_listen_tcp
+Description: listen on 127.0.0.1:port, the exporter is meant for a local scraper or proxy
+Input: int port
+Output:
+Return: listening fd, -1 on error
+*************************************************/
+static int exp_listen_tcp(int port)
+{
+	struct sockaddr_in addr;
+	int fd;
+	int on = 1;
+
+	fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, EXP_MAX_CLIENTS) < 0)
+	{
+		printf("can't listen on 127.0.0.1:%d because:%s\n", port, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static void client_close(exp_client_t *c)
+{
+	if (c->gen >= 0)
+		g_gen[c->gen].refs--;
+	close(c->fd);
+	c->state = CLIENT_FREE;
+	c->gen = -1;
+}
+
+static void exp_accept(int lfd)
+{
+	int fd;
+	int i;
+
+	while ((fd = accept(lfd, NULL, NULL)) >= 0)
+	{
+		fcntl(fd, F_SETFL, O_NONBLOCK);
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+		for (i = 0; i < EXP_MAX_CLIENTS && g_client[i].state != CLIENT_FREE; i++)
+			;
+		if (i == EXP_MAX_CLIENTS)
+		{
+			close(fd); /* busy, the scraper retries */
+			continue;
+		}
+		g_client[i].fd = fd;
+		g_client[i].state = CLIENT_READ;
+		g_client[i].gen = -1;
+		g_client[i].req_len = 0;
+		g_client[i].deadline = exp_now_ns(CLOCK_MONOTONIC) + (unsigned long long)EXP_READ_TIMEOUT * 1000000;
+	}
+}
+
+/*************************************************
+Function: client_route
+Description: pick the response of a complete request head, the pre-rendered
+	front generation is pinned until the client is done with it
+Input: exp_client_t *c
+Output:
+*************************************************/
+static void client_route(exp_client_t *c)
+{
+	const exp_out_t *o = NULL;
+	int found = 1;
+
+	if (strncmp(c->req, "GET /metrics.bin ", 17) == 0 || strncmp(c->req, "GET /metrics.bin?", 17) == 0)
+	{
+		if (g_front >= 0)
+			o = &g_gen[g_front].bin;
+	}
+	else if (strncmp(c->req, "GET /metrics ", 13) == 0 || strncmp(c->req, "GET /metrics?", 13) == 0
+		|| strncmp(c->req, "GET / ", 6) == 0)
+	{
+		if (g_front >= 0)
+			o = &g_gen[g_front].text;
+	}
+	else
+		found = 0;
+
+	if (!found)
+	{
+		c->out = g_resp_404;
+		c->out_len = sizeof(g_resp_404) - 1;
+	}
+	else if (o == NULL)
+	{
+		c->out = g_resp_503;
+		c->out_len = sizeof(g_resp_503) - 1;
+	}
+	else
+	{
+		c->gen = g_front;
+		g_gen[g_front].refs++;
+		c->out = o->buf + o->start;
+		c->out_len = EXP_HDR_RESERVE + o->len - o->start;
+	}
+	c->out_off = 0;
+	c->state = CLIENT_WRITE;
+}
+
+static void client_io(exp_client_t *c, short revents)
+{
+	ssize_t n;
+
+	if (revents & (POLLERR | POLLHUP | POLLNVAL) && c->state == CLIENT_READ)
+	{
+		client_close(c);
+		return;
+	}
+	if (c->state == CLIENT_READ)
+	{
+		n = recv(c->fd, c->req + c->req_len, sizeof(c->req) - 1 - c->req_len, 0);
+		if (n <= 0)
+		{
+			if (n == 0 || (errno != EAGAIN && errno != EINTR))
+				client_close(c);
+			return;
+		}
+		c->req_len += n;
+		c->req[c->req_len] = '\0';
+		if (strstr(c->req, "\r\n\r\n") != NULL || strstr(c->req, "\n\n") != NULL
+			|| c->req_len == sizeof(c->req) - 1)
+			client_route(c);
+		else
+			return;
+	}
+	while (c->out_off < c->out_len)
+	{
+		n = send(c->fd, c->out + c->out_off, c->out_len - c->out_off, MSG_NOSIGNAL);
+		if (n < 0)
+		{
+			if (errno == EAGAIN || errno == EINTR)
+				return;
+			break;
+		}
+		c->out_off += n;
+	}
+	client_close(c);
+}
+
+static int exp_usage(const char *prog)
+{
+	printf("usage: %s [-p period_us] [-l port] [-u unix_path] [-n top_n] [-b buffer_kb]\n"
+		"  -p  sample period, default %d microseconds, at least %d\n"
+		"  -l  HTTP port on 127.0.0.1, default %d, 0 turns it off\n"
+		"  -u  also serve HTTP on this Unix socket\n"
+		"  -n  busiest processes to export, default %d, 0 turns it off\n"
+		"  -b  text buffer size, default %d KB\n",
+		prog, SAMPLER_DEFAULT_PERIOD, SAMPLER_MIN_PERIOD, EXP_DEFAULT_PORT, EXP_DEFAULT_TOP, EXP_DEFAULT_BUF_KB);
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	int period = SAMPLER_DEFAULT_PERIOD;
+	int port = EXP_DEFAULT_PORT;
+	const char *unix_path = NULL;
+	int top_n = EXP_DEFAULT_TOP;
+	int buf_kb = EXP_DEFAULT_BUF_KB;
+	int use_psi = 1;
+	int lfd[2] = { -1, -1 };
+	struct pollfd pfd[2 + EXP_MAX_CLIENTS];
+	int pidx[2 + EXP_MAX_CLIENTS];
+	cpu_usage_t *percpu;
+	proc_top_t *top;
+	cpu_ctx_t *ctx;
+	unsigned long long next;
+	unsigned long long now;
+	unsigned long long wake;
+	int ncpu;
+	int opt;
+	int np;
+	int i;
+
+	while ((opt = getopt(argc, argv, "p:l:u:n:b:h")) != -1)
+	{
+		switch (opt)
+		{
+		case 'p': period = atoi(optarg); break;
+		case 'l': port = atoi(optarg); break;
+		case 'u': unix_path = optarg; break;
+		case 'n': top_n = atoi(optarg); break;
+		case 'b': buf_kb = atoi(optarg); break;
+		default: return exp_usage(argv[0]);
+		}
+	}
+	if (period < SAMPLER_MIN_PERIOD || port < 0 || port > 65535 || top_n < 0 || buf_kb < 16
+		|| (port == 0 && unix_path == NULL))
+		return exp_usage(argv[0]);
+
+	/* everything a scrape or a sample needs is allocated here, once */
+	ncpu = sysconf(_SC_NPROCESSORS_CONF);
+	if (ncpu < 1)
+		ncpu = 1;
+	ctx = sys_check_cpu_ctx_create();
+	percpu = calloc(ncpu, sizeof(percpu[0]));
+	top = calloc(top_n ? top_n : 1, sizeof(top[0]));
+	for (i = 0; i < 2; i++)
+	{
+		g_gen[i].text.size = buf_kb * 1024;
+		g_gen[i].text.buf = malloc(g_gen[i].text.size);
+		g_gen[i].bin.size = buf_kb * 256;
+		g_gen[i].bin.buf = malloc(g_gen[i].bin.size);
+		if (g_gen[i].text.buf == NULL || g_gen[i].bin.buf == NULL)
+			ctx = NULL;
+	}
+	if (ctx == NULL || percpu == NULL || top == NULL)
+	{
+		printf("out of memory\n");
+		return 1;
+	}
+
+	if (port > 0 && (lfd[0] = exp_listen_tcp(port)) < 0)
+		return 1;
+	if (unix_path != NULL && (lfd[1] = exp_listen_unix(unix_path)) < 0)
+		return 1;
+	signal(SIGINT, exp_on_signal);
+	signal(SIGTERM, exp_on_signal);
+	signal(SIGPIPE, SIG_IGN);
+
+	/* baselines, the first real sample comes one period later */
+	sys_check_cpu_ctx_sample(ctx);
+	if (top_n > 0)
+		sys_check_cpu_ctx_top(ctx, top, top_n);
+	next = exp_now_ns(CLOCK_MONOTONIC) + (unsigned long long)period * 1000;
+
+	while (!g_exp_stop)
+	{
+		now = exp_now_ns(CLOCK_MONOTONIC);
+		if (now >= next)
+		{
+			int back = g_front < 0 ? 0 : !g_front;
+
+			/* a client still on the back generation is a whole period behind */
+			for (i = 0; i < EXP_MAX_CLIENTS && g_gen[back].refs > 0; i++)
+				if (g_client[i].state != CLIENT_FREE && g_client[i].gen == back)
+					client_close(&g_client[i]);
+			exp_render(ctx, &g_gen[back], percpu, ncpu, top, top_n, &use_psi);
+			g_front = back;
+			next += (unsigned long long)period * 1000;
+			now = exp_now_ns(CLOCK_MONOTONIC);
+			if (next <= now) /* fell behind, don't sample in a burst */
+				next = now + (unsigned long long)period * 1000;
+		}
+
+		np = 0;
+		for (i = 0; i < 2; i++)
+		{
+			if (lfd[i] < 0)
+				continue;
+			pfd[np].fd = lfd[i];
+			pfd[np].events = POLLIN;
+			pidx[np++] = -1 - i;
+		}
+		wake = next;
+		for (i = 0; i < EXP_MAX_CLIENTS; i++)
+		{
+			if (g_client[i].state == CLIENT_FREE)
+				continue;
+			if (g_client[i].state == CLIENT_READ)
+			{
+				/* idle connections must not hold the slots forever */
+				if (g_client[i].deadline <= now)
+				{
+					client_close(&g_client[i]);
+					continue;
+				}
+				if (g_client[i].deadline < wake)
+					wake = g_client[i].deadline;
+			}
+			pfd[np].fd = g_client[i].fd;
+			pfd[np].events = g_client[i].state == CLIENT_READ ? POLLIN : POLLOUT;
+			pidx[np++] = i;
+		}
+		if (poll(pfd, np, (int)((wake - now) / 1000000) + 1) <= 0)
+			continue;
+		for (i = 0; i < np; i++)
+		{
+			if (pfd[i].revents == 0)
+				continue;
+			if (pidx[i] < 0)
+				exp_accept(pfd[i].fd);
+			else if (g_client[pidx[i]].state != CLIENT_FREE)
+				client_io(&g_client[pidx[i]], pfd[i].revents);
+		}
+	}
+
+	for (i = 0; i < EXP_MAX_CLIENTS; i++)
+		if (g_client[i].state != CLIENT_FREE)
+			client_close(&g_client[i]);
+	for (i = 0; i < 2; i++)
+		if (lfd[i] >= 0)
+			close(lfd[i]);
+	if (unix_path != NULL)
+		unlink(unix_path);
+	sys_check_cpu_ctx_destroy(ctx);
+	return 0;
+}